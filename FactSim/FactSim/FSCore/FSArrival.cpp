@@ -0,0 +1,207 @@
+#include "FSArrival.h"
+
+#include <QDateTime>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace
+{
+	qreal const Never{ std::numeric_limits<qreal>::infinity() };
+	// longest line read at once, the rest of a longer line is skipped
+	int const LineSize{ 256 };
+}
+
+bool FS::ArrivalModel::addSegment(qreal start, qreal rate)
+{
+	if (start < 0.0 || start >= period || rate < 0.0)
+		return false;
+
+	auto const it = std::lower_bound(segments.begin(), segments.end(), start,
+		[](Segment const & s, qreal t) { return s.start < t; });
+	if (it != segments.end() && it->start == start)
+		it->rate = rate;
+	else
+		segments.insert(it, Segment{ start, rate });
+	return true;
+}
+
+FS::TraceReader::TraceReader(QString const & fileName)
+	: mFile{ fileName }
+{
+	if (!mFile.open(QIODevice::ReadOnly))
+		return;
+
+	// dates are counted from the first time of the file
+	char line[LineSize];
+	while (mFile.readLine(line, LineSize) > 0)
+	{
+		qreal time;
+		if (parse(line, time))
+			break;
+	}
+	mFile.seek(0);
+}
+
+bool FS::TraceReader::parse(char const *line, qreal & time)
+{
+	while (*line == ' ' || *line == '\t')
+		++line;
+	char const *end = line;
+	while (*end && *end != ',' && *end != ';' && *end != '\r' && *end != '\n')
+		++end;
+	if (end == line)
+		return false;
+
+	char *parsed = nullptr;
+	qreal const seconds = std::strtod(line, &parsed);
+	if (parsed == end)
+	{
+		time = seconds;
+		return true;
+	}
+
+	QDateTime const date = QDateTime::fromString(QString::fromLatin1(line, static_cast<int>(end - line)).trimmed(), Qt::ISODate);
+	if (!date.isValid())
+		return false;
+	qint64 const ms = date.toMSecsSinceEpoch();
+	if (!mDates)
+	{
+		mDates = true;
+		mOriginMs = ms;
+	}
+	time = (ms - mOriginMs) / 1000.0;
+	return true;
+}
+
+qreal FS::TraceReader::read()
+{
+	char line[LineSize];
+	qint64 length;
+	while ((length = mFile.readLine(line, LineSize)) > 0)
+	{
+		// skip the rest of a long line
+		bool const whole = line[length - 1] == '\n' || mFile.atEnd();
+		qreal time;
+		bool const found = parse(line, time);
+		if (!whole)
+		{
+			char rest[LineSize];
+			qint64 n;
+			while ((n = mFile.readLine(rest, LineSize)) > 0 && rest[n - 1] != '\n')
+				;
+		}
+		if (found)
+			return time;
+	}
+	return Never;
+}
+
+void FS::ArrivalCursor::advance(FS::ArrivalModel const & model, FS::RandomStream const & stream, qreal speed, FS::TraceReader *trace)
+{
+	switch (model.kind)
+	{
+		case FS::ArrivalKind::Constant:
+			mNext = speed > 0.0 ? mNext + 60.0 / speed : Never;
+			break;
+		case FS::ArrivalKind::Poisson:
+		{
+			qreal gap = Never;
+			if (speed > 0.0)
+				stream.exponential(mCount, 1, speed / 60.0, &gap);
+			mNext += gap;
+			break;
+		}
+		case FS::ArrivalKind::Piecewise:
+		{
+			// the next part comes once the rate integrated from the last one reaches an Exp(1) draw
+			qreal mass;
+			stream.exponential(mCount, 1, 1.0, &mass);
+			mNext = piecewise(model, mNext, mass);
+			break;
+		}
+		case FS::ArrivalKind::Trace:
+		{
+			if (!trace || !trace->isOpen())
+			{
+				mNext = Never;
+				break;
+			}
+			if (trace->position() != mTracePosition)
+				trace->seek(mTracePosition);
+			// an order older than the previous one arrives with it
+			mNext = qMax(mNext, trace->read());
+			mTracePosition = trace->position();
+			break;
+		}
+	}
+	++mCount;
+}
+
+bool FS::ArrivalCursor::resume(FS::ArrivalModel const & model, FS::RandomStream const & stream, qreal speed, qreal time)
+{
+	bool const followsSpeed = model.kind == FS::ArrivalKind::Constant || model.kind == FS::ArrivalKind::Poisson;
+	if (!followsSpeed || mNext != Never || speed <= 0.0)
+		return false;
+	mNext = time;
+	advance(model, stream, speed, nullptr);
+	return true;
+}
+
+qreal FS::ArrivalCursor::piecewise(FS::ArrivalModel const & model, qreal from, qreal mass) const
+{
+	std::vector<FS::ArrivalModel::Segment> const & segments = model.segments;
+	std::size_t const n = segments.size();
+	qreal const period = model.period;
+	if (n == 0 || period <= 0.0 || from == Never)
+		return Never;
+
+	// the last segment runs on through the end of the period up to the first start
+	qreal perPeriod = segments[n - 1].rate * (period - segments[n - 1].start + segments[0].start);
+	for (std::size_t j = 0; j + 1 < n; ++j)
+		perPeriod += segments[j].rate * (segments[j + 1].start - segments[j].start);
+	perPeriod /= 60.0;
+	if (perPeriod <= 0.0)
+		return Never;
+
+	// whole periods at once, then segment by segment
+	qreal const periods = std::floor(mass / perPeriod);
+	mass -= periods * perPeriod;
+	qreal cycle = std::floor(from / period);
+	qreal pos = from - cycle * period;
+	cycle += periods;
+
+	auto const it = std::upper_bound(segments.begin(), segments.end(), pos,
+		[](qreal t, FS::ArrivalModel::Segment const & s) { return t < s.start; });
+	bool wrapped = it == segments.begin();
+	std::size_t j = wrapped ? n - 1 : static_cast<std::size_t>(it - segments.begin()) - 1;
+	for (;;)
+	{
+		qreal const end = wrapped ? segments[0].start : (j + 1 < n ? segments[j + 1].start : period);
+		qreal const rate = segments[j].rate / 60.0;
+		qreal const left = rate * (end - pos);
+		if (rate > 0.0 && mass <= left)
+			return cycle * period + pos + mass / rate;
+
+		mass -= left;
+		pos = end;
+		if (wrapped)
+		{
+			wrapped = false;
+			j = 0;
+		}
+		else if (j + 1 < n)
+		{
+			++j;
+		}
+		else
+		{
+			cycle += 1.0;
+			pos = 0.0;
+			wrapped = segments[0].start > 0.0;
+			j = wrapped ? n - 1 : 0;
+		}
+	}
+}
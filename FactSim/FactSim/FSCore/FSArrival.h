@@ -0,0 +1,102 @@
+#ifndef FS_ARRIVAL_H
+#define FS_ARRIVAL_H
+
+#include <QFile>
+#include <QString>
+
+#include <vector>
+
+#include "FSRandom.h"
+
+namespace FS
+{
+	enum class ArrivalKind : quint8
+	{
+		Constant,		// one part every 60 / speed seconds
+		Poisson,		// exponential times between parts, of mean 60 / speed seconds
+		Piecewise,		// Poisson of a rate following a calendar
+		Trace			// arrival times read from a file
+	};
+	int const ArrivalKindCount{ 4 };
+
+	// lower case names used by the layout files
+	inline char const * arrivalKindName(FS::ArrivalKind kind)
+	{
+		static char const * const names[ArrivalKindCount] = { "constant", "poisson", "piecewise", "trace" };
+		return names[static_cast<int>(kind)];
+	}
+
+	// How the parts of an import arrive, whether the factory takes them or not.
+	// Constant and Poisson arrivals follow the speed of the import, the time to the next part is
+	// drawn at each arrival with the speed the import has then. At speed 0 no part is due, the
+	// arrivals resume one gap after the speed is raised again.
+	struct ArrivalModel
+	{
+		// rate in parts per minute from start seconds in the period to the next segment
+		struct Segment
+		{
+			qreal start;
+			qreal rate;
+		};
+
+		FS::ArrivalKind kind{ FS::ArrivalKind::Constant };
+		// piecewise only, the segments repeat every period, the first one starts at 0
+		qreal period{ 0.0 };
+		std::vector<Segment> segments;
+		// trace only, see FS::TraceReader
+		QString trace;
+
+		// false if the segment does not start in the period or its rate is negative,
+		// a segment starting where another one does replaces it
+		bool addSegment(qreal start, qreal rate);
+	};
+
+	// Arrival times of a trace file, read one line at a time so a trace of any length is
+	// streamed from the disk. Each line starts with the time of an order, in seconds or as an
+	// ISO 8601 date, followed by other fields after a comma if any. Dates are counted from the
+	// first one of the file. Lines that hold no time, such as a header, are skipped.
+	class TraceReader
+	{
+	public:
+		explicit TraceReader(QString const & fileName);
+
+		bool isOpen() const { return mFile.isOpen(); }
+		// time of the next line with a time, infinite at the end of the file
+		qreal read();
+		// offset of the next line in the file
+		qint64 position() const { return mFile.pos(); }
+		void seek(qint64 position) { mFile.seek(position); }
+
+	private:
+		// false if the line holds no time
+		bool parse(char const *line, qreal & time);
+
+		QFile mFile;
+		bool mDates{ false };
+		qint64 mOriginMs{ 0 };
+	};
+
+	// Position of one import in its arrival process: the time of its next arrival and what is
+	// needed to draw the following one. Plain data, saved and restored by copy; a trace reader is
+	// moved back to the position of the cursor if it was read further.
+	class ArrivalCursor
+	{
+	public:
+		// time of the next arrival, 0 before the first advance()
+		qreal next() const { return mNext; }
+		// moves to the next arrival, the first one after time 0 at the first call
+		void advance(FS::ArrivalModel const & model, FS::RandomStream const & stream, qreal speed, FS::TraceReader *trace);
+		// a speed driven process stalled at speed 0 draws its next arrival from time, false if it
+		// was not stalled or the speed is still 0
+		bool resume(FS::ArrivalModel const & model, FS::RandomStream const & stream, qreal speed, qreal time);
+
+	private:
+		qreal piecewise(FS::ArrivalModel const & model, qreal from, qreal mass) const;
+
+		qreal mNext{ 0.0 };
+		quint64 mCount{ 0 };
+		qint64 mTracePosition{ 0 };
+	};
+};
+
+#endif // FS_ARRIVAL_H
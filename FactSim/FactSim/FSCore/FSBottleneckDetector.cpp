@@ -0,0 +1,126 @@
+#include "FSBottleneckDetector.h"
+
+quint32 const FS::BottleneckDetector::NoMachine;
+quint32 const FS::BottleneckDetector::NotInHeap;
+
+void FS::BottleneckDetector::add(bool candidate)
+{
+	mCandidate.push_back(candidate);
+	mStart.push_back(0);
+	mPos.push_back(NotInHeap);
+	mSole.push_back(0);
+	mShifting.push_back(0);
+}
+
+void FS::BottleneckDetector::setActive(quint32 id, bool active, quint64 step)
+{
+	if (!mCandidate[id] || active == (mPos[id] != NotInHeap))
+		return;
+
+	if (active)
+	{
+		mStart[id] = step;
+		mHeap.push_back(id);
+		place(static_cast<quint32>(mHeap.size() - 1), id);
+		siftUp(mPos[id]);
+	}
+	else
+	{
+		// move the last entry into the hole
+		quint32 const pos = mPos[id];
+		quint32 const last = mHeap.back();
+		mHeap.pop_back();
+		mPos[id] = NotInHeap;
+		if (last != id)
+		{
+			place(pos, last);
+			siftUp(pos);
+			siftDown(mPos[last]);
+		}
+	}
+	update(step);
+}
+
+void FS::BottleneckDetector::reset(std::vector<bool> const & active, quint64 step)
+{
+	if (mCurrent != NoMachine)
+		mSole[mCurrent] += step - mCurrentSince;
+	mCurrent = NoMachine;
+
+	for (quint32 id : mHeap)
+		mPos[id] = NotInHeap;
+	mHeap.clear();
+	for (quint32 id = 0; id < machineCount() && id < active.size(); ++id)
+	{
+		if (mCandidate[id] && active[id])
+		{
+			mStart[id] = step;
+			mHeap.push_back(id);
+			mPos[id] = static_cast<quint32>(mHeap.size() - 1);
+		}
+	}
+	// every start is the same, the ids are already in heap order
+	update(step);
+}
+
+quint64 FS::BottleneckDetector::soleSteps(quint32 id, quint64 step) const
+{
+	return id == mCurrent ? mSole[id] + (step - mCurrentSince) : mSole[id];
+}
+
+void FS::BottleneckDetector::siftUp(quint32 pos)
+{
+	quint32 const id = mHeap[pos];
+	while (pos > 0)
+	{
+		quint32 const parent = (pos - 1) / 2;
+		if (!before(id, mHeap[parent]))
+			break;
+		place(pos, mHeap[parent]);
+		pos = parent;
+	}
+	place(pos, id);
+}
+
+void FS::BottleneckDetector::siftDown(quint32 pos)
+{
+	quint32 const n = static_cast<quint32>(mHeap.size());
+	quint32 const id = mHeap[pos];
+	for (;;)
+	{
+		quint32 child = 2 * pos + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && before(mHeap[child + 1], mHeap[child]))
+			++child;
+		if (!before(mHeap[child], id))
+			break;
+		place(pos, mHeap[child]);
+		pos = child;
+	}
+	place(pos, id);
+}
+
+void FS::BottleneckDetector::update(quint64 step)
+{
+	// a new period never starts before the current bottleneck's, so the top only changes
+	// when the bottleneck goes inactive
+	quint32 const top = mHeap.empty() ? NoMachine : mHeap.front();
+	if (top == mCurrent)
+		return;
+
+	if (mCurrent != NoMachine)
+	{
+		mSole[mCurrent] += step - mCurrentSince;
+		if (top != NoMachine)
+		{
+			// overlap of the two periods while the previous one was the bottleneck
+			quint64 const overlap = step - qMax(mStart[top], mCurrentSince);
+			mSole[mCurrent] -= overlap;
+			mShifting[mCurrent] += overlap;
+			mShifting[top] += overlap;
+		}
+	}
+	mCurrent = top;
+	mCurrentSince = step;
+}
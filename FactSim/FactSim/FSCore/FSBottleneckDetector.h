@@ -0,0 +1,62 @@
+#ifndef FS_BOTTLENECK_DETECTOR_H
+#define FS_BOTTLENECK_DETECTOR_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+namespace FS
+{
+	// Online shifting bottleneck detection with the active period method.
+	// A machine is active while it works. At any time, the bottleneck is the machine with the
+	// longest ongoing active period. When the bottleneck's period ends, the next one takes over,
+	// and the overlap of the two periods is counted as shifting bottleneck time for both. The rest
+	// is sole bottleneck time.
+	// Fed with the activity changes only. The active machines are kept in a min heap on their
+	// period start, so each change costs O(log n) and the memory per machine is constant.
+	class BottleneckDetector
+	{
+	public:
+		static quint32 const NoMachine{ 0xFFFFFFFF };
+
+		BottleneckDetector() = default;
+		~BottleneckDetector() = default;
+
+		// new machines are inactive, non candidates are never reported (conveyors)
+		void add(bool candidate);
+		quint32 machineCount() const { return static_cast<quint32>(mStart.size()); }
+
+		void setActive(quint32 id, bool active, quint64 step);
+		// drops the ongoing periods, active machines start a new one at step
+		void reset(std::vector<bool> const & active, quint64 step);
+
+		quint32 bottleneck() const { return mCurrent; }
+		// accumulated times in steps, up to step
+		quint64 soleSteps(quint32 id, quint64 step) const;
+		quint64 shiftingSteps(quint32 id) const { return mShifting[id]; }
+
+	private:
+		static quint32 const NotInHeap{ 0xFFFFFFFF };
+
+		bool before(quint32 a, quint32 b) const { return mStart[a] < mStart[b] || (mStart[a] == mStart[b] && a < b); }
+		void siftUp(quint32 pos);
+		void siftDown(quint32 pos);
+		void place(quint32 pos, quint32 id) { mHeap[pos] = id; mPos[id] = pos; }
+		void update(quint64 step);
+
+		// per machine
+		std::vector<bool> mCandidate;
+		std::vector<quint64> mStart;
+		std::vector<quint32> mPos;
+		std::vector<quint64> mSole;
+		std::vector<quint64> mShifting;
+
+		// active candidates, oldest period on top
+		std::vector<quint32> mHeap;
+
+		quint32 mCurrent{ NoMachine };
+		quint64 mCurrentSince{ 0 };
+	};
+};
+
+#endif // FS_BOTTLENECK_DETECTOR_H
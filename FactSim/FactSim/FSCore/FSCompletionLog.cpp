@@ -0,0 +1,242 @@
+#include "FSCompletionLog.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+namespace
+{
+	char const Magic[4]{ 'F', 'S', 'C', 'L' };
+	// blocks kept for reuse, the others are freed once written
+	std::size_t const SpareBlocks{ 4 };
+	// blocks waiting for the I/O thread before the next ones are dropped: the queue grows up to
+	// this many bytes, and at least a few blocks
+	std::size_t const MaxQueuedBytes{ std::size_t{ 256 } << 20 };
+	std::size_t const MinFullBlocks{ 16 };
+	// the fastest zlib level, the I/O thread has to keep up with the step
+	int const CompressionLevel{ 1 };
+
+	void put(char *& out, quint32 value)
+	{
+		qToLittleEndian<quint32>(value, reinterpret_cast<uchar *>(out));
+		out += 4;
+	}
+
+	// times are stored as doubles whatever qreal is
+	void put(char *& out, double value)
+	{
+		quint64 bits;
+		std::memcpy(&bits, &value, sizeof bits);
+		qToLittleEndian<quint64>(bits, reinterpret_cast<uchar *>(out));
+		out += 8;
+	}
+
+	bool get(QByteArray const & in, int & pos, quint32 & value)
+	{
+		if (pos + 4 > in.size())
+			return false;
+		value = qFromLittleEndian<quint32>(reinterpret_cast<uchar const *>(in.constData() + pos));
+		pos += 4;
+		return true;
+	}
+
+	bool get(QByteArray const & in, int & pos, qreal & value)
+	{
+		if (pos + 8 > in.size())
+			return false;
+		quint64 const bits = qFromLittleEndian<quint64>(reinterpret_cast<uchar const *>(in.constData() + pos));
+		double d;
+		std::memcpy(&d, &bits, sizeof d);
+		value = d;
+		pos += 8;
+		return true;
+	}
+}
+
+quint32 const FS::CompletionLog::Version;
+
+FS::CompletionLog::CompletionLog(QString const & fileName, quint32 blockSize)
+	: mFile{ fileName }, mBlockSize{ qMax<quint32>(4096, blockSize) }
+{
+	if (!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return;
+	char header[8];
+	char *out = header;
+	std::memcpy(out, Magic, 4);
+	out += 4;
+	put(out, Version);
+	if (mFile.write(header, 8) != 8)
+	{
+		mFile.close();
+		return;
+	}
+
+	mBlock.reserve(mBlockSize);
+	mThread = std::thread(&FS::CompletionLog::ioLoop, this);
+}
+
+FS::CompletionLog::~CompletionLog()
+{
+	close();
+}
+
+bool FS::CompletionLog::close()
+{
+	if (mThread.joinable())
+	{
+		// the run is over, the last block may wait for the disk
+		handOver(false);
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mWake.notify_one();
+		mThread.join();
+		if (!mFile.flush())
+			mFailed.store(true, std::memory_order_relaxed);
+		mFile.close();
+	}
+	return !hasFailed();
+}
+
+void FS::CompletionLog::append(quint32 product, qreal created, qreal completed, Visit const *visits, quint32 count)
+{
+	if (!isOpen())
+		return;
+
+	std::size_t const start = mBlock.size();
+	mBlock.resize(start + 24 + 20 * std::size_t{ count });
+	char *out = mBlock.data() + start;
+	put(out, product);
+	put(out, created);
+	put(out, completed);
+	put(out, count);
+	for (quint32 i = 0; i < count; ++i)
+	{
+		put(out, visits[i].machine);
+		put(out, visits[i].arrival);
+		put(out, visits[i].departure);
+	}
+	++mRecords;
+	++mBlockRecords;
+
+	if (mBlock.size() >= mBlockSize)
+		flush();
+}
+
+void FS::CompletionLog::flush()
+{
+	handOver(true);
+}
+
+void FS::CompletionLog::handOver(bool bounded)
+{
+	if (mBlock.empty())
+		return;
+
+	std::vector<char> next;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		// after a failed write nothing more reaches the file, and the step does not wait for a
+		// disk that fell behind rather than hold every record in memory
+		if (mFailed.load(std::memory_order_relaxed) || (bounded && mFull.size() >= qMax(MinFullBlocks, MaxQueuedBytes / mBlockSize)))
+		{
+			mDropped.fetch_add(mBlockRecords, std::memory_order_relaxed);
+			mBlockRecords = 0;
+			mBlock.clear();
+			return;
+		}
+		mFull.push_back(std::move(mBlock));
+		if (!mSpare.empty())
+		{
+			next = std::move(mSpare.back());
+			mSpare.pop_back();
+		}
+	}
+	mWake.notify_one();
+
+	mBlockRecords = 0;
+	mBlock = std::move(next);
+	mBlock.clear();
+	mBlock.reserve(mBlockSize);
+}
+
+void FS::CompletionLog::ioLoop()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	for (;;)
+	{
+		mWake.wait(lock, [this]() { return mStop || !mFull.empty(); });
+		if (mFull.empty())
+			return;
+		std::vector<char> block = std::move(mFull.front());
+		mFull.pop_front();
+		lock.unlock();
+
+		// compressed off the engine thread, the blocks after a failed write are dropped
+		if (!mFailed.load(std::memory_order_relaxed))
+		{
+			QByteArray const packed = qCompress(reinterpret_cast<uchar const *>(block.data()), static_cast<int>(block.size()), CompressionLevel);
+			uchar size[4];
+			qToLittleEndian<quint32>(static_cast<quint32>(packed.size()), size);
+			if (mFile.write(reinterpret_cast<char const *>(size), 4) == 4 && mFile.write(packed) == packed.size())
+			{
+				mWritten.fetch_add(4 + packed.size(), std::memory_order_relaxed);
+			}
+			else
+			{
+				lock.lock();
+				mFailed.store(true, std::memory_order_relaxed);
+				lock.unlock();
+			}
+		}
+		block.clear();
+
+		lock.lock();
+		if (mSpare.size() < SpareBlocks)
+			mSpare.push_back(std::move(block));
+	}
+}
+
+FS::CompletionLogReader::CompletionLogReader(QString const & fileName)
+	: mFile{ fileName }
+{
+	if (!mFile.open(QIODevice::ReadOnly))
+		return;
+	QByteArray const header = mFile.read(8);
+	mValid = header.size() == 8 && std::memcmp(header.constData(), Magic, 4) == 0
+		&& qFromLittleEndian<quint32>(reinterpret_cast<uchar const *>(header.constData() + 4)) == FS::CompletionLog::Version;
+}
+
+bool FS::CompletionLogReader::next(FS::CompletionLog::Record & record)
+{
+	if (!mValid)
+		return false;
+
+	while (mPos >= mBlock.size())
+	{
+		QByteArray const size = mFile.read(4);
+		if (size.size() != 4)
+			return false;
+		quint32 const packed = qFromLittleEndian<quint32>(reinterpret_cast<uchar const *>(size.constData()));
+		mBlock = qUncompress(mFile.read(packed));
+		mPos = 0;
+		if (mBlock.isEmpty())
+			return false;
+	}
+
+	quint32 count = 0;
+	if (!get(mBlock, mPos, record.product) || !get(mBlock, mPos, record.created)
+		|| !get(mBlock, mPos, record.completed) || !get(mBlock, mPos, count))
+		return false;
+	// a damaged count must not allocate more visits than the block holds
+	if (count > static_cast<quint32>(mBlock.size() - mPos) / 20)
+		return false;
+	record.visits.resize(count);
+	for (FS::CompletionLog::Visit &v : record.visits)
+	{
+		if (!get(mBlock, mPos, v.machine) || !get(mBlock, mPos, v.arrival) || !get(mBlock, mPos, v.departure))
+			return false;
+	}
+	return true;
+}
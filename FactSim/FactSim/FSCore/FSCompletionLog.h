@@ -0,0 +1,116 @@
+#ifndef FS_COMPLETION_LOG_H
+#define FS_COMPLETION_LOG_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FS
+{
+	// Genealogy of the parts that left the factory, appended to a binary file.
+	// The engine serialises each record into an in-memory block; full blocks are handed to an I/O
+	// thread that compresses and writes them, so the step never waits for the disk. The queue of
+	// blocks grows while the disk falls behind; past 256 MB the next blocks are dropped until it
+	// catches up.
+	// After a failed write the records are dropped too; hasFailed() tells so and droppedCount()
+	// counts the records lost.
+	//
+	// File: "FSCL", format version (quint32), then blocks of a compressed size (quint32) followed
+	// by the qCompress'd records. Records: product (quint32), creation and completion times
+	// (double), visit count (quint32), then per visit the machine id (quint32), arrival and
+	// departure times (double). Every value is little endian. An existing file is replaced.
+	class CompletionLog
+	{
+	public:
+		struct Visit
+		{
+			quint32 machine;
+			qreal arrival;
+			qreal departure;
+		};
+
+		struct Record
+		{
+			quint32 product;
+			qreal created;
+			qreal completed;
+			std::vector<Visit> visits;
+		};
+
+		static quint32 const Version{ 1 };
+
+		explicit CompletionLog(QString const & fileName, quint32 blockSize = 1 << 20);
+		// close()
+		~CompletionLog();
+
+		CompletionLog(CompletionLog const &) = delete;
+		CompletionLog& operator=(CompletionLog const &) = delete;
+
+		bool isOpen() const { return mFile.isOpen(); }
+
+		// engine thread
+		void append(quint32 product, qreal created, qreal completed, Visit const *visits, quint32 count);
+		// hands the records appended so far to the I/O thread, or drops them if it is behind
+		void flush();
+		quint64 recordCount() const { return mRecords; }
+		// waits for the records left to be written, then stops the I/O thread and closes the file
+		// false if any record was dropped or could not be written
+		bool close();
+
+		// any thread, bytes written to the file so far
+		quint64 bytesWritten() const { return mWritten.load(std::memory_order_relaxed); }
+		// a write failed or records were dropped
+		bool hasFailed() const { return mFailed.load(std::memory_order_relaxed) || droppedCount() > 0; }
+		// records that never reached the I/O thread
+		quint64 droppedCount() const { return mDropped.load(std::memory_order_relaxed); }
+
+	private:
+		// bounded: drops the block when the I/O thread is behind
+		void handOver(bool bounded);
+		void ioLoop();
+
+		QFile mFile;
+		quint32 mBlockSize;
+		quint64 mRecords{ 0 };
+		std::vector<char> mBlock;
+		quint64 mBlockRecords{ 0 };
+
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		std::deque<std::vector<char>> mFull;
+		std::vector<std::vector<char>> mSpare;
+		bool mStop{ false };
+		std::atomic<quint64> mWritten{ 0 };
+		std::atomic<bool> mFailed{ false };
+		std::atomic<quint64> mDropped{ 0 };
+		std::thread mThread;
+	};
+
+	// Reads a completion log back, one record at a time.
+	class CompletionLogReader
+	{
+	public:
+		explicit CompletionLogReader(QString const & fileName);
+
+		// false if the file is not a completion log
+		bool isValid() const { return mValid; }
+		// false at the end of the file or on a damaged block
+		bool next(FS::CompletionLog::Record & record);
+
+	private:
+		QFile mFile;
+		bool mValid{ false };
+		QByteArray mBlock;
+		int mPos{ 0 };
+	};
+};
+
+#endif // FS_COMPLETION_LOG_H
@@ -1 +0,0 @@
-#include "FSConveyor.h"
\ No newline at end of file
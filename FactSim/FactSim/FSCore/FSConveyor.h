@@ -1,21 +0,0 @@
-#ifndef FS_CONVEYOR_H
-#define FS_CONVEYOR_H
-
-#include "FSTransporter.h"
-
-// #include "FSPath.h"
-
-namespace FS
-{
-	class Conveyor : public FS::Transporter
-	{
-	public:
-		Conveyor() = default;
-		~Conveyor() = default;
-
-	private:
-
-	};
-};
-
-#endif // FS_CONVEYOR_H
@@ -0,0 +1,469 @@
+#include "FSDispatcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "FSReservationTable.h"
+#include "FSRouter.h"
+
+namespace
+{
+	// cost of an unreachable pickup, such pairs are never kept
+	qreal const Unreachable{ 1e12 };
+	quint32 const NoColumn{ 0xFFFFFFFF };
+}
+
+quint32 const FS::Dispatcher::NoVehicle;
+quint32 const FS::Dispatcher::NoJob;
+
+FS::Dispatcher::Dispatcher(FS::Router & router)
+	: mRouter(router)
+{
+}
+
+quint32 FS::Dispatcher::addVehicle(quint32 node, qreal speed)
+{
+	mNode.push_back(node);
+	mSpeed.push_back(speed);
+	mX.push_back(mRouter.x(node));
+	mY.push_back(mRouter.y(node));
+	mJob.push_back(NoJob);
+	mRoute.emplace_back();
+	mLeg.push_back(0);
+	mPickupLeg.push_back(0);
+	mProgress.push_back(0.0);
+	mBusyTime.push_back(0.0);
+	mHeld.push_back(FS::Router::NoEdge);
+	mHeldUntil.push_back(0.0);
+	return static_cast<quint32>(mNode.size() - 1);
+}
+
+quint32 FS::Dispatcher::request(quint32 pickup, quint32 dropoff, qreal time)
+{
+	if (pickup >= mRouter.nodeCount() || dropoff >= mRouter.nodeCount())
+		return NoJob;
+
+	Job job;
+	job.pickup = pickup;
+	job.dropoff = dropoff;
+	job.requested = time;
+	if (mFreeJobs.empty())
+	{
+		mJobs.push_back(job);
+		mPending.push_back(static_cast<quint32>(mJobs.size() - 1));
+	}
+	else
+	{
+		mJobs[mFreeJobs.back()] = job;
+		mPending.push_back(mFreeJobs.back());
+		mFreeJobs.pop_back();
+	}
+	return mPending.back();
+}
+
+quint32 FS::Dispatcher::dispatch(qreal time)
+{
+	if (mPending.empty() || time - mJobs[mPending.front()].requested < mWindow)
+		return 0;
+
+	// idle vehicles, busy ones get an empty box
+	quint32 const n = vehicleCount();
+	mBoxes.assign(n, FS::Box());
+	quint32 idle = 0;
+	FS::Box bounds;
+	for (quint32 v = 0; v < n; ++v)
+	{
+		if (mJob[v] != NoJob)
+			continue;
+		FS::Box & b = mBoxes[v];
+		b.x0 = b.x1 = mX[v];
+		b.y0 = b.y1 = mY[v];
+		if (idle++ == 0)
+		{
+			bounds = b;
+		}
+		else
+		{
+			bounds.x0 = qMin(bounds.x0, b.x0); bounds.y0 = qMin(bounds.y0, b.y0);
+			bounds.x1 = qMax(bounds.x1, b.x1); bounds.y1 = qMax(bounds.y1, b.y1);
+		}
+	}
+	if (idle == 0)
+		return 0;
+	mIdleGrid.build(mBoxes);
+
+	// oldest jobs first, at most one per idle vehicle, the ones no idle vehicle can serve wait
+	// without holding a row
+	mRows.clear();
+	for (std::size_t i = 0; i < mPending.size() && mRows.size() < idle; ++i)
+	{
+		if (servable(mJobs[mPending[i]]))
+			mRows.push_back(static_cast<quint32>(i));
+	}
+	if (mRows.empty())
+		return 0;
+	quint32 const rows = static_cast<quint32>(mRows.size());
+
+	// candidate vehicles: the nearest idle ones of every job, found by growing squares
+	qreal const spacing = std::sqrt(qMax<qreal>(1.0, (bounds.x1 - bounds.x0) * (bounds.y1 - bounds.y0)) / idle);
+	mColumns.clear();
+	mColumnOf.assign(n, NoColumn);
+	for (quint32 i = 0; i < rows; ++i)
+	{
+		Job const & job = mJobs[mPending[mRows[i]]];
+		qreal const px = mRouter.x(job.pickup);
+		qreal const py = mRouter.y(job.pickup);
+		qreal r = spacing * std::sqrt(static_cast<qreal>(mCandidates));
+		for (;;)
+		{
+			FS::Box area;
+			area.x0 = px - r; area.y0 = py - r;
+			area.x1 = px + r; area.y1 = py + r;
+			quint32 found = 0;
+			mIdleGrid.query(area, [&found](quint32) { ++found; });
+			bool const all = area.x0 <= bounds.x0 && area.y0 <= bounds.y0 && area.x1 >= bounds.x1 && area.y1 >= bounds.y1;
+			if (found >= mCandidates || all)
+			{
+				mIdleGrid.query(area, [this](quint32 v) {
+					if (mColumnOf[v] == NoColumn)
+					{
+						mColumnOf[v] = static_cast<quint32>(mColumns.size());
+						mColumns.push_back(v);
+					}
+				});
+				break;
+			}
+			r *= 2.0;
+		}
+	}
+	// every job needs a column
+	for (quint32 v = 0; v < n && mColumns.size() < rows; ++v)
+	{
+		if (mJob[v] == NoJob && mColumnOf[v] == NoColumn)
+		{
+			mColumnOf[v] = static_cast<quint32>(mColumns.size());
+			mColumns.push_back(v);
+		}
+	}
+
+	// empty travel to the pickup
+	quint32 const columns = static_cast<quint32>(mColumns.size());
+	mCost.resize(static_cast<std::size_t>(rows) * columns);
+	for (quint32 i = 0; i < rows; ++i)
+	{
+		quint32 const pickup = mJobs[mPending[mRows[i]]].pickup;
+		for (quint32 j = 0; j < columns; ++j)
+		{
+			qreal const d = mRouter.distance(mNode[mColumns[j]], pickup);
+			mCost[i * columns + j] = std::isinf(d) ? Unreachable : d;
+		}
+	}
+	solve(rows, columns);
+
+	// unreachable pairs stay pending, in their order
+	quint32 assigned = 0;
+	mTaken.assign(mPending.size(), false);
+	for (quint32 i = 0; i < rows; ++i)
+	{
+		if (mCost[i * columns + mAssigned[i]] < Unreachable && assign(mColumns[mAssigned[i]], mPending[mRows[i]], time))
+		{
+			mTaken[mRows[i]] = true;
+			++assigned;
+		}
+	}
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < mPending.size(); ++i)
+	{
+		if (!mTaken[i])
+			mPending[kept++] = mPending[i];
+	}
+	mPending.resize(kept);
+	return assigned;
+}
+
+bool FS::Dispatcher::servable(Job const & job)
+{
+	if (std::isinf(mRouter.distance(job.pickup, job.dropoff)))
+		return false;
+	for (quint32 v = 0; v < vehicleCount(); ++v)
+	{
+		if (mJob[v] == NoJob && !std::isinf(mRouter.distance(mNode[v], job.pickup)))
+			return true;
+	}
+	return false;
+}
+
+void FS::Dispatcher::solve(quint32 rows, quint32 columns)
+{
+	// Hungarian method with potentials, O(rows² · columns), 1 based with a virtual column 0
+	qreal const inf = std::numeric_limits<qreal>::infinity();
+	mU.assign(rows + 1, 0.0);
+	mV.assign(columns + 1, 0.0);
+	mP.assign(columns + 1, 0);
+	mWay.assign(columns + 1, 0);
+	for (quint32 i = 1; i <= rows; ++i)
+	{
+		mP[0] = i;
+		quint32 j0 = 0;
+		mMinV.assign(columns + 1, inf);
+		mUsed.assign(columns + 1, false);
+		do
+		{
+			mUsed[j0] = true;
+			quint32 const i0 = mP[j0];
+			qreal delta = inf;
+			quint32 j1 = 0;
+			for (quint32 j = 1; j <= columns; ++j)
+			{
+				if (mUsed[j])
+					continue;
+				qreal const cur = mCost[(i0 - 1) * columns + (j - 1)] - mU[i0] - mV[j];
+				if (cur < mMinV[j])
+				{
+					mMinV[j] = cur;
+					mWay[j] = j0;
+				}
+				if (mMinV[j] < delta)
+				{
+					delta = mMinV[j];
+					j1 = j;
+				}
+			}
+			for (quint32 j = 0; j <= columns; ++j)
+			{
+				if (mUsed[j])
+				{
+					mU[mP[j]] += delta;
+					mV[j] -= delta;
+				}
+				else
+				{
+					mMinV[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (mP[j0] != 0);
+		do
+		{
+			quint32 const j1 = mWay[j0];
+			mP[j0] = mP[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+
+	mAssigned.assign(rows, 0);
+	for (quint32 j = 1; j <= columns; ++j)
+	{
+		if (mP[j] != 0)
+			mAssigned[mP[j] - 1] = j - 1;
+	}
+}
+
+bool FS::Dispatcher::assign(quint32 vehicle, quint32 job, qreal time)
+{
+	// the vehicle stays idle if either leg cannot be driven
+	Job & j = mJobs[job];
+	std::vector<quint32> & route = mRoute[vehicle];
+	if (!mRouter.route(j.pickup, j.dropoff, mEdges) || !mRouter.route(mNode[vehicle], j.pickup, route))
+	{
+		route.clear();
+		return false;
+	}
+	mPickupLeg[vehicle] = static_cast<quint32>(route.size());
+	if (route.empty())
+		j.picked = time; // already there
+	route.insert(route.end(), mEdges.begin(), mEdges.end());
+
+	mJob[vehicle] = job;
+	mLeg[vehicle] = 0;
+	mProgress[vehicle] = 0.0;
+	return true;
+}
+
+void FS::Dispatcher::setReservations(FS::ReservationTable *table)
+{
+	mTable = table;
+	if (table && table->resourceCount() < mRouter.edgeCount())
+		table->resize(mRouter.edgeCount());
+}
+
+bool FS::Dispatcher::enter(quint32 vehicle, quint32 edge, qreal time)
+{
+	if (!mTable || mHeld[vehicle] == edge)
+		return true;
+
+	// the edge for the traversal, plus one slot so the hold never lapses before the next tick,
+	// the horizon grows for the longest traversals
+	qreal const until = time + mRouter.length(edge) / mSpeed[vehicle] + mTable->slotDuration();
+	quint64 const slots = mTable->slotCount(time, until);
+	if (slots > mTable->horizon())
+		mTable->setHorizon(static_cast<quint32>(qMin<quint64>(slots * 2, 0xFFFFFFFF)));
+	quint32 const blocker = mTable->reserve(edge, time, until, vehicle);
+	mTable->setWaiting(vehicle, blocker);
+	if (blocker != FS::ReservationTable::NoVehicle)
+	{
+		// keep the edge the vehicle waits at the end of, a lapsed hold taken by another vehicle
+		// is dropped (release would not touch its slots anyway)
+		if (mHeld[vehicle] != FS::Router::NoEdge)
+		{
+			qreal const holdUntil = qMax(mHeldUntil[vehicle], time + 2.0 * mTable->slotDuration());
+			if (mTable->reserve(mHeld[vehicle], time, holdUntil, vehicle) == FS::ReservationTable::NoVehicle)
+				mHeldUntil[vehicle] = holdUntil;
+			else
+				mHeld[vehicle] = FS::Router::NoEdge;
+		}
+		return false;
+	}
+
+	leave(vehicle, time);
+	mHeld[vehicle] = edge;
+	mHeldUntil[vehicle] = until;
+	return true;
+}
+
+void FS::Dispatcher::leave(quint32 vehicle, qreal time)
+{
+	if (!mTable || mHeld[vehicle] == FS::Router::NoEdge)
+		return;
+	mTable->release(mHeld[vehicle], time, mHeldUntil[vehicle], vehicle);
+	mHeld[vehicle] = FS::Router::NoEdge;
+}
+
+void FS::Dispatcher::advance(qreal time, qreal dt)
+{
+	quint32 const n = vehicleCount();
+	mFleetTime += dt * n;
+	for (quint32 v = 0; v < n; ++v)
+	{
+		if (mJob[v] == NoJob)
+			continue;
+		mBusyTime[v] += dt;
+
+		std::vector<quint32> const & route = mRoute[v];
+		qreal remaining = mSpeed[v] * dt;
+		while (remaining > 0.0 && mLeg[v] < route.size())
+		{
+			quint32 const edge = route[mLeg[v]];
+			if (!enter(v, edge, time))
+				break;
+			qreal const step = qMin(remaining, mRouter.length(edge) - mProgress[v]);
+			mProgress[v] += step;
+			remaining -= step;
+			if (mProgress[v] >= mRouter.length(edge))
+			{
+				mNode[v] = mRouter.to(edge);
+				mProgress[v] = 0.0;
+				if (++mLeg[v] == mPickupLeg[v])
+					mJobs[mJob[v]].picked = time;
+			}
+		}
+		place(v);
+		if (mLeg[v] == route.size())
+			finish(v, time);
+	}
+
+	// break every deadlock by moving one of its vehicles aside
+	if (mTable && mTable->findDeadlocks(mDeadlocks) > 0)
+	{
+		for (std::vector<quint32> const & cycle : mDeadlocks)
+		{
+			++mDeadlockCount;
+			for (quint32 v : cycle)
+			{
+				if (giveWay(v, time))
+					break;
+			}
+		}
+	}
+}
+
+bool FS::Dispatcher::giveWay(quint32 vehicle, qreal time)
+{
+	// another free edge out of the node the vehicle waits at, the route resumes from its end
+	if (mJob[vehicle] == NoJob)
+		return false;
+	std::vector<quint32> & route = mRoute[vehicle];
+	Job const & job = mJobs[mJob[vehicle]];
+	bool const picked = job.picked >= 0.0;
+	quint32 const target = picked ? job.dropoff : job.pickup;
+	quint32 const wanted = route[mLeg[vehicle]];
+	if (!picked && std::isinf(mRouter.distance(job.pickup, job.dropoff)))
+		return false;
+
+	quint32 best = FS::Router::NoEdge;
+	qreal bestCost = 0.0;
+	for (quint32 edge : mRouter.outEdges(mNode[vehicle]))
+	{
+		if (edge == wanted || mRouter.isBlocked(edge))
+			continue;
+		qreal const cost = mRouter.length(edge) + mRouter.distance(mRouter.to(edge), target);
+		if (std::isinf(cost) || (best != FS::Router::NoEdge && cost >= bestCost))
+			continue;
+		qreal const until = time + mRouter.length(edge) / mSpeed[vehicle] + mTable->slotDuration();
+		if (!mTable->isFree(edge, time, until, vehicle))
+			continue;
+		best = edge;
+		bestCost = cost;
+	}
+	if (best == FS::Router::NoEdge || !enter(vehicle, best, time))
+		return false;
+
+	// new route: the detour, then on to the target (and the dropoff if not picked yet)
+	route.assign(1, best);
+	mRouter.route(mRouter.to(best), target, mEdges);
+	route.insert(route.end(), mEdges.begin(), mEdges.end());
+	if (picked)
+	{
+		mPickupLeg[vehicle] = 0; // never reached again
+	}
+	else
+	{
+		mPickupLeg[vehicle] = static_cast<quint32>(route.size());
+		mRouter.route(job.pickup, job.dropoff, mEdges);
+		route.insert(route.end(), mEdges.begin(), mEdges.end());
+	}
+	mLeg[vehicle] = 0;
+	mProgress[vehicle] = 0.0;
+	return true;
+}
+
+void FS::Dispatcher::place(quint32 vehicle)
+{
+	std::vector<quint32> const & route = mRoute[vehicle];
+	if (mLeg[vehicle] >= route.size())
+	{
+		mX[vehicle] = mRouter.x(mNode[vehicle]);
+		mY[vehicle] = mRouter.y(mNode[vehicle]);
+		return;
+	}
+	quint32 const edge = route[mLeg[vehicle]];
+	quint32 const a = mRouter.from(edge);
+	quint32 const b = mRouter.to(edge);
+	qreal const t = mRouter.length(edge) > 0.0 ? mProgress[vehicle] / mRouter.length(edge) : 1.0;
+	mX[vehicle] = mRouter.x(a) + (mRouter.x(b) - mRouter.x(a)) * t;
+	mY[vehicle] = mRouter.y(a) + (mRouter.y(b) - mRouter.y(a)) * t;
+}
+
+void FS::Dispatcher::finish(quint32 vehicle, qreal time)
+{
+	// parked off the aisle
+	leave(vehicle, time);
+	Job const & job = mJobs[mJob[vehicle]];
+	mTotalWait += job.picked - job.requested;
+	++mCompleted;
+	mFreeJobs.push_back(mJob[vehicle]);
+	mJob[vehicle] = NoJob;
+	mRoute[vehicle].clear();
+	mLeg[vehicle] = 0;
+}
+
+qreal FS::Dispatcher::utilisation() const
+{
+	if (mFleetTime <= 0.0)
+		return 0.0;
+	qreal busy = 0.0;
+	for (qreal t : mBusyTime)
+		busy += t;
+	return busy / mFleetTime;
+}
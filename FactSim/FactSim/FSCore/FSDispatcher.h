@@ -0,0 +1,136 @@
+#ifndef FS_DISPATCHER_H
+#define FS_DISPATCHER_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+#include "FSSpatialGrid.h"
+
+namespace FS
+{
+	class ReservationTable;
+	class Router;
+
+	// Fleet of transport vehicles (AGV, forklifts) moving parts over the router's graph.
+	// Transport requests are collected over a short window, then the idle vehicles are assigned
+	// to the waiting jobs in one batch, minimising the total empty travel with the Hungarian
+	// method. The idle vehicles are indexed in a spatial grid and each job only considers its
+	// nearest candidates, so a batch costs O(jobs² · candidates) whatever the fleet size.
+	// Empty travel distances come from the router's cached trees, without search.
+	class Dispatcher
+	{
+	public:
+		static quint32 const NoVehicle{ 0xFFFFFFFF };
+		static quint32 const NoJob{ 0xFFFFFFFF };
+
+		// the router must outlive the dispatcher, its trees should be precomputed
+		explicit Dispatcher(FS::Router & router);
+		~Dispatcher() = default;
+
+		Dispatcher(Dispatcher const &) = delete;
+		Dispatcher& operator=(Dispatcher const &) = delete;
+
+		// speed in length units per second
+		quint32 addVehicle(quint32 node, qreal speed);
+		quint32 vehicleCount() const { return static_cast<quint32>(mNode.size()); }
+		qreal x(quint32 vehicle) const { return mX[vehicle]; }
+		qreal y(quint32 vehicle) const { return mY[vehicle]; }
+		quint32 job(quint32 vehicle) const { return mJob[vehicle]; }
+
+		// requests are assigned once the oldest waited window seconds (0: at the next dispatch)
+		void setBatchWindow(qreal window) { mWindow = window; }
+		// nearest idle vehicles considered per job
+		void setCandidates(quint32 count) { mCandidates = qMax<quint32>(1, count); }
+		// with a table, a vehicle enters an edge (resource = edge id) only once it reserved it for
+		// its traversal, and holds it while waiting at its end, nullptr lets vehicles overlap
+		void setReservations(FS::ReservationTable *table);
+
+		// NoJob if a node does not exist, the id of a finished job is given to a later request
+		quint32 request(quint32 pickup, quint32 dropoff, qreal time);
+		quint32 pendingCount() const { return static_cast<quint32>(mPending.size()); }
+
+		// assigns the waiting jobs if the window elapsed, returns the number assigned
+		// jobs whose pickup or dropoff cannot be reached stay pending until they can
+		quint32 dispatch(qreal time);
+		// moves the busy vehicles, finished jobs free their vehicle
+		void advance(qreal time, qreal dt);
+
+		// statistics
+		quint64 completedCount() const { return mCompleted; }
+		// mean time from the request to the pickup, in seconds
+		qreal meanWait() const { return mCompleted ? mTotalWait / mCompleted : 0.0; }
+		// share of the vehicle time spent on a job, empty travel included
+		qreal utilisation() const;
+		// wait-for cycles found by the last advance, one vehicle of each gave way
+		std::vector<std::vector<quint32>> const & deadlocks() const { return mDeadlocks; }
+		quint64 deadlockCount() const { return mDeadlockCount; }
+
+	private:
+		struct Job
+		{
+			quint32 pickup;
+			quint32 dropoff;
+			qreal requested;
+			qreal picked{ -1.0 };
+		};
+
+		// an idle vehicle can reach the pickup, and the dropoff can be reached from it
+		bool servable(Job const & job);
+		bool assign(quint32 vehicle, quint32 job, qreal time);
+		void finish(quint32 vehicle, qreal time);
+		void place(quint32 vehicle);
+		bool enter(quint32 vehicle, quint32 edge, qreal time);
+		void leave(quint32 vehicle, qreal time);
+		bool giveWay(quint32 vehicle, qreal time);
+		// minimal cost assignment of rows to distinct columns, rows <= columns
+		void solve(quint32 rows, quint32 columns);
+
+		FS::Router & mRouter;
+		qreal mWindow{ 1.0 };
+		quint32 mCandidates{ 8 };
+
+		// vehicles
+		std::vector<quint32> mNode;			// last node reached
+		std::vector<qreal> mSpeed;
+		std::vector<qreal> mX;
+		std::vector<qreal> mY;
+		std::vector<quint32> mJob;
+		std::vector<std::vector<quint32>> mRoute;
+		std::vector<quint32> mLeg;			// edge of the route in progress
+		std::vector<quint32> mPickupLeg;	// first edge after the pickup
+		std::vector<qreal> mProgress;		// along the edge in progress
+		std::vector<qreal> mBusyTime;
+		qreal mFleetTime{ 0.0 };
+
+		// reservations, edge held by each vehicle and until when
+		FS::ReservationTable *mTable{ nullptr };
+		std::vector<quint32> mHeld;
+		std::vector<qreal> mHeldUntil;
+		std::vector<std::vector<quint32>> mDeadlocks;
+		quint64 mDeadlockCount{ 0 };
+
+		// jobs
+		std::vector<Job> mJobs;
+		std::vector<quint32> mFreeJobs;		// slots of the finished jobs
+		std::vector<quint32> mPending;
+		quint64 mCompleted{ 0 };
+		qreal mTotalWait{ 0.0 };
+
+		// batch scratch
+		std::vector<quint32> mRows;			// index in mPending of each row
+		std::vector<bool> mTaken;
+		FS::SpatialGrid mIdleGrid;
+		std::vector<FS::Box> mBoxes;
+		std::vector<quint32> mColumns;
+		std::vector<quint32> mColumnOf;
+		std::vector<qreal> mCost;
+		std::vector<quint32> mAssigned;
+		std::vector<qreal> mU, mV, mMinV;
+		std::vector<quint32> mP, mWay;
+		std::vector<bool> mUsed;
+		std::vector<quint32> mEdges;
+	};
+};
+
+#endif // FS_DISPATCHER_H
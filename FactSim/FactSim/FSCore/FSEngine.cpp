@@ -0,0 +1,1174 @@
+#include "FSEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "FSCompletionLog.h"
+#include "FSMetricStore.h"
+#include "FSScheduler.h"
+
+namespace
+{
+	qreal const DefaultConveyorLength{ 100.0 };
+	quint32 const NoLane{ 0xFFFFFFFF };
+	// machines per task of the parallel copies, below it the hand over costs more than the copy
+	std::size_t const ParallelGrain{ 16384 };
+	// lane belts per partition of the conveyor step
+	quint32 const BeltGrain{ 4096 };
+	// operation time factors drawn at once by a varied station
+	quint32 const DrawBatch{ 16 };
+	quint64 const NoBlock{ ~0ull };
+	// the breakdowns have their own key, independent of the operation time draws
+	quint64 const OutageKey{ 0x9E3779B97F4A7C15ull };
+	quint64 const ArrivalKey{ 0xC2B2AE3D27D4EB4Full };
+}
+
+quint32 const FS::Engine::NoMachine;
+
+FS::Engine::Engine(qreal timeStep)
+	: mTimeStep{ timeStep > 0.0 ? timeStep : 0.01 }, mSnapshot{ std::make_shared<Snapshot>() }
+{
+
+}
+
+quint32 FS::Engine::addMachine(FS::MachineKind kind, qreal speed, quint32 capacity)
+{
+	quint32 const id = machineCount();
+	Bucket &b = bucket(kind);
+
+	mKind.push_back(kind);
+	mSlot.push_back(static_cast<quint32>(b.id.size()));
+	mRoute.push_back(0);
+	mTopologyDirty = true;
+	mQueue.push_back(0);
+	mCapacity.push_back(qMax<quint32>(1, capacity));
+	mState.push_back(FS::MachineState::Idle);
+	mCompleted.push_back(0);
+	mVersion.push_back(0);
+	mPartBegin.push_back(static_cast<quint32>(mParts.size()));
+	mHead.push_back(0);
+	mParts.resize(mParts.size() + mCapacity.back(), 0);
+	mHeld.push_back(0);
+	mOutputs.push_back(0);
+	mImportProduct.push_back(0);
+	mVaried.push_back(NoMachine);
+	mOutage.push_back(NoMachine);
+	mArrival.push_back(NoMachine);
+	mDetector.add(kind != FS::MachineKind::Conveyor && kind != FS::MachineKind::Transporter);
+
+	// the recorded history does not describe the new layout
+	if (mCheckpointInterval)
+		clearHistory();
+
+	b.id.push_back(id);
+	b.speed.push_back(speed > 0.0 ? speed : 0.0);
+	b.progress.push_back(0.0);
+	b.pace.push_back(1.0);
+
+	if (kind == FS::MachineKind::Conveyor)
+	{
+		mBelts.length.push_back(DefaultConveyorLength);
+		mBelts.ringBegin.push_back(static_cast<quint32>(mBelts.exitTime.size()));
+		mBelts.exitTime.resize(mBelts.exitTime.size() + mCapacity.back(), 0.0);
+	}
+	else if (kind == FS::MachineKind::Junction)
+	{
+		mJunctions.merge.push_back(FS::MergeRule::Zipper);
+		mJunctions.divert.push_back(FS::DivertRule::RoundRobin);
+		mJunctions.nextLane.push_back(0);
+		mJunctions.lanes.emplace_back();
+		mJunctions.capacity.push_back(0);
+	}
+
+	return id;
+}
+
+void FS::Engine::connect(quint32 from, quint32 to)
+{
+	if (from < machineCount() && to < machineCount() && from != to)
+	{
+		mLinks.emplace_back(from, to);
+		mTopologyDirty = true;
+		if (mKind[to] == FS::MachineKind::Junction)
+		{
+			mJunctions.lanes[mSlot[to]].push_back(static_cast<quint32>(mLanes.size()));
+			mLanes.emplace_back(mCapacity[to]);
+			mJunctions.capacity[mSlot[to]] += mCapacity[to];
+			mLaneFeeder.push_back(from);
+		}
+		if (mCheckpointInterval)
+			clearHistory();
+	}
+}
+
+void FS::Engine::updateTopology()
+{
+	if (!mTopologyDirty)
+		return;
+
+	// counting sort of the links by source
+	mOutBegin.assign(mKind.size() + 1, 0);
+	for (auto const & l : mLinks)
+		++mOutBegin[l.first + 1];
+	for (std::size_t i = 0; i < mKind.size(); ++i)
+		mOutBegin[i + 1] += mOutBegin[i];
+
+	mOut.resize(mLinks.size());
+	std::vector<quint32> cursor(mOutBegin.begin(), mOutBegin.end() - 1);
+	for (auto const & l : mLinks)
+		mOut[cursor[l.first]++] = l.second;
+
+	// belts handing their parts to junctions only
+	std::vector<quint32> const & belts = bucket(FS::MachineKind::Conveyor).id;
+	std::vector<quint32> others;
+	mBeltOrder.clear();
+	for (quint32 s = 0; s < belts.size(); ++s)
+	{
+		quint32 const id = belts[s];
+		bool lanesOnly = mOutBegin[id + 1] > mOutBegin[id];
+		for (quint32 k = mOutBegin[id]; k < mOutBegin[id + 1] && lanesOnly; ++k)
+			lanesOnly = mKind[mOut[k]] == FS::MachineKind::Junction;
+		if (lanesOnly)
+			mBeltOrder.push_back(s);
+		else
+			others.push_back(s);
+	}
+	mLaneBelts = static_cast<quint32>(mBeltOrder.size());
+	mBeltOrder.insert(mBeltOrder.end(), others.begin(), others.end());
+
+	mTopologyDirty = false;
+}
+
+void FS::Engine::setConveyorLength(quint32 id, qreal length)
+{
+	if (id < machineCount() && mKind[id] == FS::MachineKind::Conveyor && length > 0.0)
+	{
+		mBelts.length[mSlot[id]] = length;
+		if (mCheckpointInterval)
+			clearHistory();
+	}
+}
+
+void FS::Engine::setJunctionRules(quint32 id, FS::MergeRule merge, FS::DivertRule divert)
+{
+	if (id < machineCount() && mKind[id] == FS::MachineKind::Junction)
+	{
+		mJunctions.merge[mSlot[id]] = merge;
+		mJunctions.divert[mSlot[id]] = divert;
+	}
+}
+
+void FS::Engine::setRecipes(FS::RecipeTable const & recipes)
+{
+	mRecipes = recipes;
+	quint32 const products = mRecipes.productCount();
+	auto known = [products](quint32 &product) {
+		if (product >= products)
+			product = 0;
+	};
+	std::for_each(mImportProduct.begin(), mImportProduct.end(), known);
+	if (mLog)
+	{
+		// the queues hold handles of tracked parts, their products are in mPartProduct
+		std::for_each(mPartProduct.begin(), mPartProduct.end(), known);
+	}
+	else
+	{
+		std::for_each(mParts.begin(), mParts.end(), known);
+		std::for_each(mHeld.begin(), mHeld.end(), known);
+		for (FS::SpscQueue<quint32> &lane : mLanes)
+		{
+			std::vector<quint32> parts;
+			lane.forEach([&parts](quint32 product) { parts.push_back(product); });
+			lane.clear();
+			for (quint32 product : parts)
+				lane.push(product < products ? product : 0);
+		}
+	}
+	if (mCheckpointInterval)
+		clearHistory();
+}
+
+void FS::Engine::setImportProduct(quint32 id, quint32 product)
+{
+	if (id < machineCount() && mKind[id] == FS::MachineKind::Import && product < mRecipes.productCount())
+	{
+		mImportProduct[id] = product;
+		if (mCheckpointInterval)
+			clearHistory();
+	}
+}
+
+void FS::Engine::setSeed(quint64 seed)
+{
+	mSeed = seed;
+	// the factors drawn with the former seed are stale
+	mFactorBlock.assign(mFactorBlock.size(), NoBlock);
+	// and so are the outage timelines, redone from the start at the next step
+	mTimelines.assign(mTimelines.size(), FS::OutageTimeline());
+	rebuildOutageEvents();
+	for (quint32 id = 0; id < machineCount(); ++id)
+	{
+		if (mArrival[id] != NoMachine)
+		{
+			mArrivalCursor[mArrival[id]] = FS::ArrivalCursor();
+			mArrivalCursor[mArrival[id]].advance(mArrivalModel[mArrival[id]], FS::RandomStream(mSeed ^ ArrivalKey, id), speed(id), mTraces[mArrival[id]].get());
+		}
+	}
+	rebuildArrivalEvents();
+	if (mCheckpointInterval)
+		clearHistory();
+}
+
+void FS::Engine::setVariation(quint32 id, FS::Variation const & variation)
+{
+	if (id >= machineCount() || mKind[id] == FS::MachineKind::Conveyor || mKind[id] == FS::MachineKind::Transporter
+		|| mKind[id] == FS::MachineKind::Junction)
+		return;
+
+	if (mVaried[id] == NoMachine)
+	{
+		mVaried[id] = static_cast<quint32>(mVariation.size());
+		mVariation.push_back(variation);
+		mDraws.push_back(0);
+		mFactorBlock.push_back(NoBlock);
+		mFactors.resize(mFactors.size() + DrawBatch);
+	}
+	else
+	{
+		mVariation[mVaried[id]] = variation;
+		mFactorBlock[mVaried[id]] = NoBlock;
+	}
+	if (mCheckpointInterval)
+		clearHistory();
+}
+
+void FS::Engine::setOutages(quint32 id, FS::OutageModel const & model)
+{
+	if (id >= machineCount() || mKind[id] == FS::MachineKind::Conveyor || mKind[id] == FS::MachineKind::Transporter
+		|| mKind[id] == FS::MachineKind::Junction)
+		return;
+	if (mOutage[id] == NoMachine && !model.isEnabled())
+		return;
+
+	if (mOutage[id] == NoMachine)
+	{
+		mOutage[id] = static_cast<quint32>(mOutageModel.size());
+		mOutageModel.push_back(model);
+		mTimelines.emplace_back();
+		mResumeState.push_back(FS::MachineState::Idle);
+	}
+	else
+	{
+		// a station down under the former model comes back up at the next step if it has to
+		mOutageModel[mOutage[id]] = model;
+		mTimelines[mOutage[id]] = FS::OutageTimeline();
+	}
+	rebuildOutageEvents();
+	if (mCheckpointInterval)
+		clearHistory();
+}
+
+void FS::Engine::setArrivals(quint32 id, FS::ArrivalModel const & model)
+{
+	if (id >= machineCount() || mKind[id] != FS::MachineKind::Import)
+		return;
+
+	if (mArrival[id] == NoMachine)
+	{
+		mArrival[id] = static_cast<quint32>(mArrivalModel.size());
+		mArrivalModel.emplace_back();
+		mArrivalCursor.emplace_back();
+		mTraces.emplace_back();
+	}
+	quint32 const a = mArrival[id];
+	mArrivalModel[a] = model;
+	mTraces[a].reset(model.kind == FS::ArrivalKind::Trace ? new FS::TraceReader(model.trace) : nullptr);
+	// the first arrival is counted from time 0
+	mArrivalCursor[a] = FS::ArrivalCursor();
+	mArrivalCursor[a].advance(model, FS::RandomStream(mSeed ^ ArrivalKey, id), speed(id), mTraces[a].get());
+	rebuildArrivalEvents();
+	if (mCheckpointInterval)
+		clearHistory();
+}
+
+void FS::Engine::setSpeed(quint32 id, qreal speed)
+{
+	std::lock_guard<std::mutex> lock(mPendingMutex);
+	mPendingSpeed.emplace_back(id, qMax<qreal>(0.0, speed));
+	mHasPending.store(true, std::memory_order_release);
+}
+
+void FS::Engine::setSpeedSince(quint32 id, qreal speed, qreal changeTime)
+{
+	speed = qMax<qreal>(0.0, speed);
+	std::lock_guard<std::mutex> lock(mPendingMutex);
+	// a slider drag sends many edits of the same machine, only the last one is replayed
+	for (RetroactiveEdit &e : mPendingRetroactive)
+	{
+		if (e.id == id)
+		{
+			e.speed = speed;
+			e.since = changeTime;
+			mHasPending.store(true, std::memory_order_release);
+			return;
+		}
+	}
+	mPendingRetroactive.push_back(RetroactiveEdit{ id, speed, changeTime });
+	mHasPending.store(true, std::memory_order_release);
+}
+
+void FS::Engine::applySpeed(quint32 id, qreal speed)
+{
+	if (mKind[id] == FS::MachineKind::Conveyor)
+		retimeBelt(id, bucket(FS::MachineKind::Conveyor).speed[mSlot[id]], speed);
+	bucket(mKind[id]).speed[mSlot[id]] = speed;
+	touch(id);
+	// arrivals stopped by a zero speed start again from now
+	quint32 const a = mArrival[id];
+	if (a != NoMachine && mArrivalCursor[a].resume(mArrivalModel[a], FS::RandomStream(mSeed ^ ArrivalKey, id), speed, mSimTime))
+		rebuildArrivalEvents();
+	if (mCheckpointInterval)
+		mEdits.push_back(SpeedEdit{ mSteps, id, speed });
+}
+
+void FS::Engine::retimeBelt(quint32 id, qreal from, qreal to)
+{
+	if (from == to)
+		return;
+	// the parts on the belt keep the length they have left, at the new speed
+	qreal *ring = &mBelts.exitTime[mBelts.ringBegin[mSlot[id]]];
+	for (quint32 i = 0; i < mQueue[id]; ++i)
+	{
+		qreal &t = ring[(mHead[id] + i) % mCapacity[id]];
+		qreal const left = from > 0.0 ? std::max<qreal>(0.0, t - mSimTime) * from : t;
+		t = to > 0.0 ? mSimTime + left / to : left;
+	}
+}
+
+void FS::Engine::applyPending()
+{
+	// the edits are taken out first, a replay can take a while
+	std::vector<std::pair<quint32, qreal>> speeds;
+	std::vector<RetroactiveEdit> retroactive;
+	{
+		std::lock_guard<std::mutex> lock(mPendingMutex);
+		speeds.swap(mPendingSpeed);
+		retroactive.swap(mPendingRetroactive);
+		mHasPending.store(false, std::memory_order_relaxed);
+	}
+
+	for (auto const & p : speeds)
+	{
+		if (p.first < machineCount() && p.second >= 0.0)
+			applySpeed(p.first, p.second);
+	}
+	for (RetroactiveEdit const & e : retroactive)
+	{
+		if (e.id < machineCount() && e.speed >= 0.0)
+			resimulate(e.id, e.speed, e.since);
+	}
+}
+
+void FS::Engine::step()
+{
+	if (mHasPending.load(std::memory_order_acquire))
+		applyPending();
+	updateTopology();
+	advance();
+}
+
+void FS::Engine::advance()
+{
+	if (mCheckpointInterval && mCheckpoints.empty())
+		saveCheckpoint();
+	if (mMetrics && !mReplaying && mSteps == mNextSample)
+		sampleMetrics();
+	if (!mOutageEvents.empty() && mOutageEvents.front().first <= mSimTime)
+		updateOutages();
+	if (!mArrivalEvents.empty() && mArrivalEvents.front().first <= mSimTime)
+		updateArrivals();
+
+	// sinks first so the downstream room is freed before the upstream pushes
+	stepStations<FS::MachineKind::Export>();
+	stepConveyors();
+	stepJunctions();
+	stepStations<FS::MachineKind::Transform>();
+	stepStations<FS::MachineKind::Workspace>();
+	stepStations<FS::MachineKind::Import>();
+	// transporters have no behaviour yet
+
+	++mSteps;
+	mSimTime = mSteps * mTimeStep;
+
+	if (mCheckpointInterval && mSteps % mCheckpointInterval == 0)
+		saveCheckpoint();
+	else if (mCheckpointInterval && !mReplaying && mTransfers.size() + mBlockings.size() > mMaxLogEntries)
+		trimHistory();
+}
+
+template <FS::MachineKind K>
+void FS::Engine::stepStations()
+{
+	// the kind is a template parameter, every test on K is resolved at compile time
+	quint32 const n = static_cast<quint32>(bucket(K).id.size());
+	for (quint32 s = 0; s < n; ++s)
+		stepStation<K>(s);
+}
+
+template <FS::MachineKind K>
+void FS::Engine::stepStation(quint32 slot)
+{
+	Bucket &b = bucket(K);
+	quint32 const id = b.id[slot];
+	FS::MachineState &state = mState[id];
+
+	if (state == FS::MachineState::Down)
+		return;
+	if (K == FS::MachineKind::Import && mArrival[id] != NoMachine)
+	{
+		releaseArrivals(id);
+		return;
+	}
+
+	if (state == FS::MachineState::Blocked)
+	{
+		if (!handOver(id))
+			return;
+		state = FS::MachineState::Idle;
+		logBlocking(id, false);
+		touch(id);
+	}
+
+	if (state == FS::MachineState::Idle)
+	{
+		quint32 product = mImportProduct[id];
+		quint32 part = product;
+		if (K != FS::MachineKind::Import)
+		{
+			if (mQueue[id] == 0)
+				return;
+			part = takePart(id);
+			product = productOf(part);
+		}
+		else if (mLog)
+		{
+			part = createPart(product, id);
+		}
+		FS::RecipeTable::Entry const & recipe = mRecipes.entry(K, product);
+		mHeld[id] = recipe.output;
+		if (mLog)
+		{
+			// the tracked part carries its new product
+			mPartProduct[part] = recipe.output;
+			mHeld[id] = part;
+		}
+		mOutputs[id] = recipe.outputCount;
+		b.pace[slot] = recipe.pace;
+		if (mVaried[id] != NoMachine)
+			b.pace[slot] /= drawFactor(id);
+		state = FS::MachineState::Working;
+		setActive(id, true);
+		touch(id);
+	}
+
+	b.progress[slot] += b.speed[slot] * b.pace[slot] * (mTimeStep / 60.0);
+	if (b.progress[slot] < 1.0)
+		return;
+
+	b.progress[slot] = 0.0;
+	// parts put out by the operation, an export takes its part out of the factory
+	mCompleted[id] += K == FS::MachineKind::Export ? 1 : mOutputs[id];
+	if (K == FS::MachineKind::Export)
+	{
+		mOutputs[id] = 0;
+		if (mLog)
+			completePart(mHeld[id]);
+	}
+	if (K == FS::MachineKind::Export || handOver(id))
+	{
+		state = FS::MachineState::Idle;
+		// the active period goes on if the next part starts right away
+		if (K != FS::MachineKind::Import && mQueue[id] == 0)
+			setActive(id, false);
+	}
+	else
+	{
+		state = FS::MachineState::Blocked;
+		logBlocking(id, true);
+		setActive(id, false);
+	}
+	touch(id);
+}
+
+void FS::Engine::stepConveyors()
+{
+	// the lane belts by partition, each logging its own history, which is then appended in
+	// partition order so the history does not depend on the threads
+	quint32 const partitions = (mLaneBelts + BeltGrain - 1) / BeltGrain;
+	if (mScheduler && partitions > 1)
+	{
+		mPartitionTransfers.resize(partitions);
+		mPartitionBlockings.resize(partitions);
+		mScheduler->parallelFor(0, partitions, 1, [this](std::size_t first, std::size_t last) {
+			for (std::size_t p = first; p < last; ++p)
+			{
+				quint32 const end = std::min<quint32>(mLaneBelts, static_cast<quint32>(p + 1) * BeltGrain);
+				for (quint32 i = static_cast<quint32>(p) * BeltGrain; i < end; ++i)
+					stepConveyor(mBeltOrder[i], mPartitionTransfers[p], mPartitionBlockings[p]);
+			}
+		});
+		for (quint32 p = 0; p < partitions; ++p)
+		{
+			mTransfers.insert(mTransfers.end(), mPartitionTransfers[p].begin(), mPartitionTransfers[p].end());
+			mBlockings.insert(mBlockings.end(), mPartitionBlockings[p].begin(), mPartitionBlockings[p].end());
+			mPartitionTransfers[p].clear();
+			mPartitionBlockings[p].clear();
+		}
+	}
+	else
+	{
+		for (quint32 i = 0; i < mLaneBelts; ++i)
+			stepConveyor(mBeltOrder[i]);
+	}
+
+	for (quint32 i = mLaneBelts; i < mBeltOrder.size(); ++i)
+		stepConveyor(mBeltOrder[i]);
+}
+
+void FS::Engine::stepConveyor(quint32 slot, std::vector<Transfer> & transfers, std::vector<Blocking> & blockings)
+{
+	quint32 const id = bucket(FS::MachineKind::Conveyor).id[slot];
+	quint32 const capacity = mCapacity[id];
+	qreal const *ring = &mBelts.exitTime[mBelts.ringBegin[slot]];
+	quint32 const *parts = &mParts[mPartBegin[id]];
+	quint32 &head = mHead[id];
+	// a stopped belt holds lengths, nothing leaves it
+	bool const moving = bucket(FS::MachineKind::Conveyor).speed[slot] > 0.0;
+
+	bool blocked = false;
+	while (moving && mQueue[id] > 0 && ring[head] <= mSimTime)
+	{
+		if (!forward(id, parts[head], transfers))
+		{
+			blocked = true;
+			break;
+		}
+		head = (head + 1) % capacity;
+		--mQueue[id];
+		++mCompleted[id];
+		touch(id);
+	}
+
+	if (blocked)
+		setState(id, FS::MachineState::Blocked, blockings);
+	else
+		setState(id, mQueue[id] > 0 ? FS::MachineState::Working : FS::MachineState::Idle, blockings);
+}
+
+void FS::Engine::stepJunctions()
+{
+	quint32 const n = static_cast<quint32>(bucket(FS::MachineKind::Junction).id.size());
+	for (quint32 s = 0; s < n; ++s)
+		stepJunction(s);
+}
+
+void FS::Engine::stepJunction(quint32 slot)
+{
+	// a station whose queue is split in lanes, only the consumer side of the lanes is used
+	Bucket &b = bucket(FS::MachineKind::Junction);
+	quint32 const id = b.id[slot];
+	FS::MachineState &state = mState[id];
+
+	if (state == FS::MachineState::Blocked)
+	{
+		if (mJunctions.divert[slot] == FS::DivertRule::FirstFree)
+			mRoute[id] = 0;
+		if (!handOver(id))
+			return;
+		state = FS::MachineState::Idle;
+		logBlocking(id, false);
+		touch(id);
+	}
+
+	if (state == FS::MachineState::Idle)
+	{
+		std::vector<quint32> const & lanes = mJunctions.lanes[slot];
+		quint32 const n = static_cast<quint32>(lanes.size());
+		quint32 const first = mJunctions.merge[slot] == FS::MergeRule::Zipper ? mJunctions.nextLane[slot] : 0;
+		quint32 part = NoMachine;
+		for (quint32 k = 0; k < n && part == NoMachine; ++k)
+		{
+			quint32 const l = first + k < n ? first + k : first + k - n;
+			if (mLanes[lanes[l]].pop(part))
+				mJunctions.nextLane[slot] = l + 1 < n ? l + 1 : 0;
+		}
+		if (part == NoMachine)
+		{
+			countLanes(id);
+			return;
+		}
+		mHeld[id] = part;
+		mOutputs[id] = 1;
+		state = FS::MachineState::Working;
+		setActive(id, true);
+		touch(id);
+	}
+
+	b.progress[slot] += b.speed[slot] * (mTimeStep / 60.0);
+	if (b.progress[slot] < 1.0)
+	{
+		countLanes(id);
+		return;
+	}
+
+	b.progress[slot] = 0.0;
+	++mCompleted[id];
+	if (mJunctions.divert[slot] == FS::DivertRule::FirstFree)
+		mRoute[id] = 0;
+	countLanes(id);
+	if (handOver(id))
+	{
+		state = FS::MachineState::Idle;
+		if (mQueue[id] == 0)
+			setActive(id, false);
+	}
+	else
+	{
+		state = FS::MachineState::Blocked;
+		logBlocking(id, true);
+		setActive(id, false);
+	}
+	touch(id);
+}
+
+void FS::Engine::countLanes(quint32 id)
+{
+	quint32 queue = 0;
+	for (quint32 l : mJunctions.lanes[mSlot[id]])
+		queue += mLanes[l].size();
+	if (queue != mQueue[id])
+	{
+		mQueue[id] = queue;
+		touch(id);
+	}
+}
+
+quint32 FS::Engine::lane(quint32 from, quint32 to) const
+{
+	for (quint32 l : mJunctions.lanes[mSlot[to]])
+	{
+		if (mLaneFeeder[l] == from)
+			return l;
+	}
+	return NoLane;
+}
+
+bool FS::Engine::hasRoom(quint32 from, quint32 to) const
+{
+	if (mKind[to] == FS::MachineKind::Junction)
+	{
+		quint32 const l = lane(from, to);
+		return l != NoLane && !mLanes[l].isFull();
+	}
+	return mQueue[to] < mCapacity[to];
+}
+
+void FS::Engine::stepSlot(FS::MachineKind kind, quint32 slot)
+{
+	switch (kind)
+	{
+		case FS::MachineKind::Export:
+			stepStation<FS::MachineKind::Export>(slot);
+			break;
+		case FS::MachineKind::Conveyor:
+			stepConveyor(slot);
+			break;
+		case FS::MachineKind::Junction:
+			stepJunction(slot);
+			break;
+		case FS::MachineKind::Transform:
+			stepStation<FS::MachineKind::Transform>(slot);
+			break;
+		case FS::MachineKind::Workspace:
+			stepStation<FS::MachineKind::Workspace>(slot);
+			break;
+		case FS::MachineKind::Import:
+			stepStation<FS::MachineKind::Import>(slot);
+			break;
+		default:
+			break;
+	}
+}
+
+bool FS::Engine::handOver(quint32 id)
+{
+	for (; mOutputs[id] > 0; --mOutputs[id])
+	{
+		// tracked outputs but the last are copies of the part
+		quint32 const part = mLog && mOutputs[id] > 1 ? clonePart(mHeld[id]) : mHeld[id];
+		if (!forward(id, part))
+		{
+			if (part != mHeld[id])
+				releasePart(part);
+			return false;
+		}
+	}
+	return true;
+}
+
+qreal FS::Engine::drawFactor(quint32 id)
+{
+	quint32 const v = mVaried[id];
+	FS::Variation const & variation = mVariation[v];
+	if (variation.isFixed())
+		return 1.0;
+
+	// the factors are cached by block of draws, a restored draw index finds them again
+	quint64 const draw = mDraws[v]++;
+	qreal *factors = &mFactors[static_cast<std::size_t>(v) * DrawBatch];
+	if (mFactorBlock[v] != draw / DrawBatch)
+	{
+		mFactorBlock[v] = draw / DrawBatch;
+		variation.sample(FS::RandomStream(mSeed, id), mFactorBlock[v] * DrawBatch, DrawBatch, factors);
+	}
+	return factors[draw % DrawBatch];
+}
+
+void FS::Engine::updateOutages()
+{
+	auto const later = std::greater<std::pair<qreal, quint32>>();
+	while (!mOutageEvents.empty() && mOutageEvents.front().first <= mSimTime)
+	{
+		std::pop_heap(mOutageEvents.begin(), mOutageEvents.end(), later);
+		quint32 const id = mOutageEvents.back().second;
+		updateOutage(id);
+		mOutageEvents.back().first = mTimelines[mOutage[id]].next();
+		std::push_heap(mOutageEvents.begin(), mOutageEvents.end(), later);
+	}
+}
+
+void FS::Engine::updateOutage(quint32 id)
+{
+	quint32 const o = mOutage[id];
+	bool const down = mTimelines[o].advance(mOutageModel[o], FS::RandomStream(mSeed ^ OutageKey, id), mSimTime);
+	FS::MachineState &state = mState[id];
+	if (down == (state == FS::MachineState::Down))
+		return;
+
+	if (down)
+	{
+		// a down station is not blocked, its feeders may tell it apart in the logs
+		mResumeState[o] = state;
+		if (state == FS::MachineState::Blocked)
+			logBlocking(id, false);
+		setActive(id, false);
+		state = FS::MachineState::Down;
+	}
+	else
+	{
+		state = mResumeState[o];
+		if (state == FS::MachineState::Blocked)
+			logBlocking(id, true);
+		else if (state == FS::MachineState::Working)
+			setActive(id, true);
+	}
+	touch(id);
+}
+
+void FS::Engine::rebuildOutageEvents()
+{
+	mOutageEvents.clear();
+	for (quint32 id = 0; id < machineCount(); ++id)
+	{
+		if (mOutage[id] != NoMachine)
+			mOutageEvents.emplace_back(mTimelines[mOutage[id]].next(), id);
+	}
+	std::make_heap(mOutageEvents.begin(), mOutageEvents.end(), std::greater<std::pair<qreal, quint32>>());
+}
+
+void FS::Engine::updateArrivals()
+{
+	auto const later = std::greater<std::pair<qreal, quint32>>();
+	while (!mArrivalEvents.empty() && mArrivalEvents.front().first <= mSimTime)
+	{
+		std::pop_heap(mArrivalEvents.begin(), mArrivalEvents.end(), later);
+		quint32 const id = mArrivalEvents.back().second;
+		arrive(id);
+		mArrivalEvents.back().first = mArrivalCursor[mArrival[id]].next();
+		std::push_heap(mArrivalEvents.begin(), mArrivalEvents.end(), later);
+	}
+}
+
+void FS::Engine::arrive(quint32 id)
+{
+	quint32 const a = mArrival[id];
+	if (mQueue[id] < mCapacity[id])
+	{
+		mParts[mPartBegin[id] + (mHead[id] + mQueue[id]) % mCapacity[id]] = mLog ? createPart(mImportProduct[id], id) : mImportProduct[id];
+		++mQueue[id];
+		touch(id);
+	}
+	mArrivalCursor[a].advance(mArrivalModel[a], FS::RandomStream(mSeed ^ ArrivalKey, id), speed(id), mTraces[a].get());
+}
+
+void FS::Engine::rebuildArrivalEvents()
+{
+	mArrivalEvents.clear();
+	for (quint32 id = 0; id < machineCount(); ++id)
+	{
+		if (mArrival[id] != NoMachine)
+			mArrivalEvents.emplace_back(mArrivalCursor[mArrival[id]].next(), id);
+	}
+	std::make_heap(mArrivalEvents.begin(), mArrivalEvents.end(), std::greater<std::pair<qreal, quint32>>());
+}
+
+void FS::Engine::releaseArrivals(quint32 id)
+{
+	// the arrived parts go as fast as the successors take them
+	quint32 const capacity = mCapacity[id];
+	quint32 const *parts = &mParts[mPartBegin[id]];
+	quint32 &head = mHead[id];
+
+	bool blocked = false;
+	while (mQueue[id] > 0)
+	{
+		if (!forward(id, parts[head]))
+		{
+			blocked = true;
+			break;
+		}
+		head = (head + 1) % capacity;
+		--mQueue[id];
+		++mCompleted[id];
+		touch(id);
+	}
+	setState(id, blocked ? FS::MachineState::Blocked : FS::MachineState::Idle);
+}
+
+void FS::Engine::setCompletionLog(FS::CompletionLog *log)
+{
+	if ((mLog != nullptr) != (log != nullptr))
+		convertParts(log != nullptr);
+	mLog = log;
+	// the history holds the other kind of parts
+	if (mCheckpointInterval)
+		clearHistory();
+}
+
+quint32 FS::Engine::createPart(quint32 product, quint32 at)
+{
+	quint32 part;
+	if (mFreeParts.empty())
+	{
+		part = static_cast<quint32>(mPartProduct.size());
+		mPartProduct.push_back(product);
+		mPartCreated.push_back(mSimTime);
+		mPartVisits.emplace_back();
+	}
+	else
+	{
+		part = mFreeParts.back();
+		mFreeParts.pop_back();
+		mPartProduct[part] = product;
+		mPartCreated[part] = mSimTime;
+	}
+	mPartVisits[part].push_back(FS::CompletionLog::Visit{ at, mSimTime, mSimTime });
+	return part;
+}
+
+quint32 FS::Engine::clonePart(quint32 part)
+{
+	quint32 const copy = createPart(mPartProduct[part], 0);
+	mPartCreated[copy] = mPartCreated[part];
+	mPartVisits[copy].assign(mPartVisits[part].begin(), mPartVisits[part].end());
+	return copy;
+}
+
+void FS::Engine::releasePart(quint32 part)
+{
+	mPartVisits[part].clear();
+	mFreeParts.push_back(part);
+}
+
+void FS::Engine::completePart(quint32 part)
+{
+	std::vector<FS::CompletionLog::Visit> &visits = mPartVisits[part];
+	visits.back().departure = mSimTime;
+	mLog->append(mPartProduct[part], mPartCreated[part], mSimTime, visits.data(), static_cast<quint32>(visits.size()));
+	releasePart(part);
+}
+
+void FS::Engine::convertParts(bool track)
+{
+	// waiting parts are tracked from where they wait, tracked parts fall back to their product
+	auto const convert = [this, track](quint32 value, quint32 at) {
+		return track ? createPart(value, at) : mPartProduct[value];
+	};
+	for (quint32 id = 0; id < machineCount(); ++id)
+	{
+		for (quint32 k = 0; k < mQueue[id] && mKind[id] != FS::MachineKind::Junction; ++k)
+		{
+			quint32 &part = mParts[mPartBegin[id] + (mHead[id] + k) % mCapacity[id]];
+			part = convert(part, id);
+		}
+		if (mOutputs[id] > 0)
+			mHeld[id] = convert(mHeld[id], id);
+	}
+	Bucket const & junctions = bucket(FS::MachineKind::Junction);
+	for (quint32 s = 0; s < junctions.id.size(); ++s)
+	{
+		for (quint32 l : mJunctions.lanes[s])
+		{
+			std::vector<quint32> parts;
+			quint32 part;
+			while (mLanes[l].pop(part))
+				parts.push_back(convert(part, junctions.id[s]));
+			for (quint32 p : parts)
+				mLanes[l].push(p);
+		}
+	}
+
+	if (!track)
+	{
+		mPartProduct.clear();
+		mPartCreated.clear();
+		mPartVisits.clear();
+		mFreeParts.clear();
+	}
+}
+
+quint32 FS::Engine::takePart(quint32 id)
+{
+	quint32 const product = mParts[mPartBegin[id] + mHead[id]];
+	mHead[id] = mHead[id] + 1 < mCapacity[id] ? mHead[id] + 1 : 0;
+	--mQueue[id];
+	return product;
+}
+
+bool FS::Engine::forward(quint32 from, quint32 product, std::vector<Transfer> & transfers)
+{
+	// parts leaving a machine without successor leave the factory
+	quint32 const begin = mOutBegin[from];
+	quint32 const degree = mOutBegin[from + 1] - begin;
+	if (degree == 0)
+	{
+		if (mLog)
+			completePart(product);
+		return true;
+	}
+
+	for (quint32 k = 0; k < degree; ++k)
+	{
+		quint32 r = mRoute[from] + k;
+		if (r >= degree)
+			r -= degree;
+		if (accept(from, mOut[begin + r], product))
+		{
+			mRoute[from] = r + 1 < degree ? r + 1 : 0;
+			if (mCheckpointInterval)
+				transfers.push_back(Transfer{ mSteps, from, mOut[begin + r], product });
+			if (mLog)
+			{
+				std::vector<FS::CompletionLog::Visit> &visits = mPartVisits[product];
+				visits.back().departure = mSimTime;
+				visits.push_back(FS::CompletionLog::Visit{ mOut[begin + r], mSimTime, mSimTime });
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FS::Engine::accept(quint32 from, quint32 to, quint32 product)
+{
+	// the feeder only pushes in its lane, the junction counts its queue itself
+	if (mKind[to] == FS::MachineKind::Junction)
+	{
+		quint32 const l = lane(from, to);
+		return l != NoLane && mLanes[l].push(product);
+	}
+
+	if (mQueue[to] >= mCapacity[to])
+		return false;
+
+	quint32 const tail = (mHead[to] + mQueue[to]) % mCapacity[to];
+	mParts[mPartBegin[to] + tail] = product;
+	if (mKind[to] == FS::MachineKind::Conveyor)
+	{
+		quint32 const s = mSlot[to];
+		qreal const speed = mBuckets[static_cast<int>(FS::MachineKind::Conveyor)].speed[s];
+		mBelts.exitTime[mBelts.ringBegin[s] + tail] = speed > 0.0 ? mSimTime + mBelts.length[s] / speed : mBelts.length[s];
+	}
+	++mQueue[to];
+	touch(to);
+	return true;
+}
+
+void FS::Engine::setMetrics(FS::MetricStore *store)
+{
+	mMetrics = store;
+	if (!store)
+		return;
+	mMetricInterval = std::max<quint64>(1, static_cast<quint64>(std::round(store->interval() / mTimeStep)));
+	mNextSample = mSteps;
+	mSampledCompleted = mCompleted;
+	store->clear(mSimTime);
+}
+
+quint32 FS::Engine::chunkCount() const
+{
+	return static_cast<quint32>((mKind.size() + ParallelGrain - 1) / ParallelGrain);
+}
+
+template <typename F>
+void FS::Engine::forMachines(F const & f) const
+{
+	std::size_t const n = mKind.size();
+	auto run = [&f, n](std::size_t first, std::size_t last) {
+		for (std::size_t c = first; c < last; ++c)
+			f(static_cast<quint32>(c), c * ParallelGrain, std::min(n, (c + 1) * ParallelGrain));
+	};
+	if (mScheduler)
+		mScheduler->parallelFor(0, chunkCount(), 1, run);
+	else
+		run(0, chunkCount());
+}
+
+void FS::Engine::sampleMetrics()
+{
+	std::size_t const n = mKind.size();
+	mSampleValues.resize(n);
+	mSampledCompleted.resize(n, 0);
+	mChunkCounts.resize(2 * chunkCount());
+	mChunkSums.resize(chunkCount());
+
+	// work in progress of the factory
+	forMachines([this](quint32 c, std::size_t begin, std::size_t end) {
+		quint64 wip = 0;
+		for (std::size_t id = begin; id < end; ++id)
+		{
+			mSampleValues[id] = static_cast<float>(mQueue[id]);
+			wip += mQueue[id];
+		}
+		mChunkCounts[c] = wip;
+	});
+	quint64 wip = 0;
+	for (quint32 c = 0; c < chunkCount(); ++c)
+		wip += mChunkCounts[c];
+	mMetrics->append(FS::Metric::Queue, mSampleValues, static_cast<float>(wip));
+
+	// parts per minute since the previous sample, a retroactive edit may have lowered the counts
+	// the factory throughput is what left through the exports
+	float const perMinute = static_cast<float>(60.0 / (mMetricInterval * mTimeStep));
+	forMachines([this, perMinute](quint32 c, std::size_t begin, std::size_t end) {
+		float out = 0.0f;
+		for (std::size_t id = begin; id < end; ++id)
+		{
+			quint64 const done = mCompleted[id] > mSampledCompleted[id] ? mCompleted[id] - mSampledCompleted[id] : 0;
+			mSampleValues[id] = done * perMinute;
+			mSampledCompleted[id] = mCompleted[id];
+			if (mKind[id] == FS::MachineKind::Export)
+				out += mSampleValues[id];
+		}
+		mChunkSums[c] = out;
+	});
+	float out = 0.0f;
+	for (quint32 c = 0; c < chunkCount(); ++c)
+		out += mChunkSums[c];
+	mMetrics->append(FS::Metric::Throughput, mSampleValues, out);
+
+	// the factory utilisation is the share of processing stations working
+	forMachines([this](quint32 c, std::size_t begin, std::size_t end) {
+		quint64 stations = 0;
+		quint64 working = 0;
+		for (std::size_t id = begin; id < end; ++id)
+		{
+			bool const busy = mState[id] == FS::MachineState::Working;
+			mSampleValues[id] = busy ? 1.0f : 0.0f;
+			if (mKind[id] == FS::MachineKind::Workspace || mKind[id] == FS::MachineKind::Transform)
+			{
+				++stations;
+				working += busy;
+			}
+		}
+		mChunkCounts[2 * c] = stations;
+		mChunkCounts[2 * c + 1] = working;
+	});
+	quint64 stations = 0;
+	quint64 working = 0;
+	for (quint32 c = 0; c < chunkCount(); ++c)
+	{
+		stations += mChunkCounts[2 * c];
+		working += mChunkCounts[2 * c + 1];
+	}
+	mMetrics->append(FS::Metric::Utilisation, mSampleValues, stations ? static_cast<float>(working) / stations : 0.0f);
+
+	mNextSample += mMetricInterval;
+}
+
+void FS::Engine::resetActivity()
+{
+	// a station about to start its next part is still active
+	std::vector<bool> active(mKind.size());
+	for (quint32 id = 0; id < machineCount(); ++id)
+	{
+		active[id] = mState[id] == FS::MachineState::Working
+			|| (mState[id] == FS::MachineState::Idle && (mKind[id] == FS::MachineKind::Import || mQueue[id] > 0));
+	}
+	mDetector.reset(active, mSteps);
+}
+
+void FS::Engine::setState(quint32 id, FS::MachineState state, std::vector<Blocking> & blockings)
+{
+	if (mState[id] == state)
+		return;
+	if ((mState[id] == FS::MachineState::Blocked) != (state == FS::MachineState::Blocked))
+		logBlocking(id, state == FS::MachineState::Blocked, blockings);
+	mState[id] = state;
+	touch(id);
+}
+
+void FS::Engine::publish()
+{
+	// reuse the previous buffers when nobody holds them anymore
+	std::shared_ptr<Snapshot> snap;
+	if (mSpareSnapshot && mSpareSnapshot.use_count() == 1)
+		snap = std::move(mSpareSnapshot);
+	else
+		snap = std::make_shared<Snapshot>();
+
+	snap->simTime = mSimTime;
+	snap->steps = mSteps;
+	snap->bottleneck = mDetector.bottleneck();
+	std::size_t const n = mKind.size();
+	snap->version.resize(n);
+	snap->state.resize(n);
+	snap->queue.resize(n);
+	snap->completed.resize(n);
+	snap->soleBottleneck.resize(n);
+	snap->shiftingBottleneck.resize(n);
+	Snapshot &copy = *snap;
+	forMachines([this, &copy](quint32, std::size_t begin, std::size_t end) {
+		std::copy(mVersion.begin() + begin, mVersion.begin() + end, copy.version.begin() + begin);
+		std::copy(mState.begin() + begin, mState.begin() + end, copy.state.begin() + begin);
+		std::copy(mQueue.begin() + begin, mQueue.begin() + end, copy.queue.begin() + begin);
+		std::copy(mCompleted.begin() + begin, mCompleted.begin() + end, copy.completed.begin() + begin);
+		for (std::size_t id = begin; id < end; ++id)
+		{
+			copy.soleBottleneck[id] = mDetector.soleSteps(static_cast<quint32>(id), mSteps);
+			copy.shiftingBottleneck[id] = mDetector.shiftingSteps(static_cast<quint32>(id));
+		}
+	});
+
+	std::lock_guard<std::mutex> lock(mSnapshotMutex);
+	mSnapshot.swap(snap);
+	mSpareSnapshot = std::move(snap);
+}
+
+std::shared_ptr<const FS::Engine::Snapshot> FS::Engine::snapshot() const
+{
+	std::lock_guard<std::mutex> lock(mSnapshotMutex);
+	return mSnapshot;
+}
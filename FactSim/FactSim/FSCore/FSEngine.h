@@ -0,0 +1,478 @@
+#ifndef FS_ENGINE_H
+#define FS_ENGINE_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "FSBottleneckDetector.h"
+#include "FSCompletionLog.h"
+#include "FSArrival.h"
+#include "FSMachineKind.h"
+#include "FSOutage.h"
+#include "FSRandom.h"
+#include "FSRecipeBook.h"
+#include "FSSpscQueue.h"
+
+namespace FS
+{
+	class MetricStore;
+	class Scheduler;
+};
+
+namespace FS
+{
+	// Headless simulation engine.
+	// The engine advances the factory by fixed time steps and owns the simulation state.
+	// It never touches the graphics items, so it can be stepped from any thread.
+	//
+	// Machines are identified by a dense id. State shared by every kind is stored by id,
+	// kind specific data lives in one structure of arrays bucket per kind, indexed by slot.
+	// A step runs one tight loop per kind, without RTTI nor virtual calls.
+	//
+	// Every part carries a product id. What a station does with a part comes from the recipe
+	// table, one lookup by (kind, product) when the station starts the part.
+	//
+	// Operation times may be stochastic: a station with a variation multiplies the recipe time of
+	// each operation by a factor of mean 1. The factors come from the stream of the machine in the
+	// run seed and are drawn in batches, the draw index of each varied station is part of its state.
+	//
+	// Stations may go down, broken or in a planned window of their calendar. The time of the next
+	// change of each outage timeline is kept in a min-heap, a step only updates the timelines whose
+	// change is due. A down station does nothing but its queue still fills, the operation it was
+	// doing resumes where it stopped.
+	//
+	// Imports push a part whenever they can by default. With an arrival process their parts arrive
+	// at given times whether the factory takes them or not, wait in the queue of the import and go
+	// as fast as the successors take them; the queue full, the next arrivals are turned away.
+	// The next arrival of each import is kept in a min-heap like the outages.
+	//
+	// Junctions merge and divert parts between belts. They work like stations whose speed is the
+	// merge rate, but their queue is split in one lane per input link. A lane is a single producer
+	// single consumer queue: the feeder only pushes, the junction only pops and counts its queue.
+	// The belts feeding only junctions are stepped first, in partitions run by the workers of the
+	// scheduler when one is set; they hand their parts to the junctions, stepped afterwards on the
+	// engine thread, through the lanes alone.
+	class Engine
+	{
+	public:
+		static quint32 const NoMachine{ 0xFFFFFFFF };
+
+		// Read-only copy of the engine state handed to the GUI.
+		struct Snapshot
+		{
+			qreal simTime{ 0.0 };
+			quint64 steps{ 0 };
+
+			// per machine values, indexed by machine id
+			// the version of a machine changes each time one of its values changes
+			std::vector<quint32> version;
+			std::vector<FS::MachineState> state;
+			std::vector<quint32> queue;
+			std::vector<quint64> completed;
+
+			// shifting bottleneck detection, times in steps
+			quint32 bottleneck{ NoMachine };
+			std::vector<quint64> soleBottleneck;
+			std::vector<quint64> shiftingBottleneck;
+		};
+
+		Engine(qreal timeStep = 0.01);
+		~Engine() = default;
+
+		Engine(Engine const &) = delete;
+		Engine& operator=(Engine const &) = delete;
+
+		// structural edits, only while the engine is not stepping
+		// station speed is in parts per minute, conveyor speed in length units per second
+		quint32 addMachine(FS::MachineKind kind, qreal speed, quint32 capacity = 8);
+		// a machine may feed several successors, parts are dispatched round robin
+		// to the first one with room
+		void connect(quint32 from, quint32 to);
+		// compresses the links, done lazily by step() after structural edits,
+		// call it before reading the successors of an engine that has not stepped since
+		void updateTopology();
+		void setConveyorLength(quint32 id, qreal length);
+		// junctions only, the capacity of a junction is the capacity of each of its lanes
+		void setJunctionRules(quint32 id, FS::MergeRule merge, FS::DivertRule divert);
+		// recipes of every station, parts of products the table does not know become product 0
+		void setRecipes(FS::RecipeTable const & recipes);
+		// imports only, product of the parts they generate (0 by default)
+		void setImportProduct(quint32 id, quint32 product);
+		quint32 importProduct(quint32 id) const { return mImportProduct[id]; }
+		FS::RecipeTable const & recipes() const { return mRecipes; }
+		// seed of the random streams of the machines, 0 by default
+		void setSeed(quint64 seed);
+		quint64 seed() const { return mSeed; }
+		// stations only (imports, exports, transforms and workspaces), fixed by default
+		void setVariation(quint32 id, FS::Variation const & variation);
+		// stations only, breakdowns and calendar, none by default
+		void setOutages(quint32 id, FS::OutageModel const & model);
+		// imports only, the import pushes its parts as fast as it can by default
+		void setArrivals(quint32 id, FS::ArrivalModel const & model);
+
+		quint32 machineCount() const { return static_cast<quint32>(mKind.size()); }
+		FS::MachineKind kind(quint32 id) const { return mKind[id]; }
+		FS::MachineState state(quint32 id) const { return mState[id]; }
+		// links as of the last updateTopology(), plain reads so the GUI may call them while the engine steps
+		quint32 outDegree(quint32 id) const { return id + 1 < mOutBegin.size() ? mOutBegin[id + 1] - mOutBegin[id] : 0; }
+		quint32 successor(quint32 id, quint32 k) const { return mOut[mOutBegin[id] + k]; }
+		quint32 linkCount() const { return static_cast<quint32>(mLinks.size()); }
+		quint32 queue(quint32 id) const { return mQueue[id]; }
+		// parts the machine can hold, all the lanes of a junction together
+		quint32 capacity(quint32 id) const { return mKind[id] == FS::MachineKind::Junction ? mJunctions.capacity[mSlot[id]] : mCapacity[id]; }
+		// last applied speed, edits still pending are not reflected
+		qreal speed(quint32 id) const { return mBuckets[static_cast<int>(mKind[id])].speed[mSlot[id]]; }
+		qreal conveyorLength(quint32 id) const { return mKind[id] == FS::MachineKind::Conveyor ? mBelts.length[mSlot[id]] : 0.0; }
+		// parts put out so far, every output of a recipe counts, one per part for an export
+		quint64 completed(quint32 id) const { return mCompleted[id]; }
+		quint32 version(quint32 id) const { return mVersion[id]; }
+
+		// station with the longest ongoing active period (NoMachine if none works),
+		// and the time each machine spent as the sole or shifting bottleneck, in steps
+		quint32 bottleneck() const { return mDetector.bottleneck(); }
+		quint64 soleBottleneckSteps(quint32 id) const { return mDetector.soleSteps(id, mSteps); }
+		quint64 shiftingBottleneckSteps(quint32 id) const { return mDetector.shiftingSteps(id); }
+
+		// parameter edits, safe from any thread (applied before the next step)
+		// speeds are >= 0 everywhere, a negative speed is taken as 0
+		void setSpeed(quint32 id, qreal speed);
+		// retroactive edit: the speed applies from changeTime and the run is re-simulated up
+		// to the current time, from the last checkpoint before changeTime (or the oldest one
+		// if the history does not go back that far). Without checkpoint it is a plain setSpeed.
+		void setSpeedSince(quint32 id, qreal speed, qreal changeTime);
+
+		// Checkpoints for the retroactive edits.
+		// Every intervalSteps the dynamic state is saved, the last maxCheckpoints are kept along
+		// with a log of the part transfers, blocking changes and speed edits since the oldest one.
+		// A retroactive edit only replays the machines downstream of the edited one, upstream
+		// machines are fed back from the log. If the replay would change what an upstream
+		// machine did (backpressure), the whole factory is replayed from the checkpoint instead.
+		// The log holds at most maxLogEntries transfers and blocking changes, past it the oldest
+		// checkpoints are dropped early, so a busy factory keeps a shorter history.
+		// 0 disables checkpoints and logs (default).
+		void setCheckpointing(quint64 intervalSteps, quint32 maxCheckpoints = 16, quint64 maxLogEntries = 1 << 22);
+		quint32 checkpointCount() const { return static_cast<quint32>(mCheckpoints.size()); }
+		// machines replayed by the last retroactive edit, machineCount() if it was a full replay
+		quint32 lastReplayCount() const { return mLastReplayCount; }
+		// false replays the whole factory on every retroactive edit, to check the downstream
+		// replay against it (true by default)
+		void setDownstreamReplay(bool enabled) { mDownstreamReplay = enabled; }
+
+		// Samples the queue, throughput and working state of every machine and of the whole factory
+		// into the store, at the store interval rounded to whole steps, starting now.
+		// The store must outlive the engine or be detached with nullptr.
+		// Retroactive edits do not rewrite the samples already taken.
+		void setMetrics(FS::MetricStore *store);
+
+		// Large factories copy their snapshots and samples in parallel on the scheduler
+		// (nullptr, the default, keeps everything on the stepping thread).
+		// The scheduler must outlive the engine or be detached with nullptr.
+		void setScheduler(FS::Scheduler *scheduler) { mScheduler = scheduler; }
+
+		// Writes the genealogy of every part leaving the factory (through an export or a machine
+		// without successor) to the log: creation time and each machine visited with its arrival
+		// and departure times. Parts are then tracked one by one, the parts waiting when the log is
+		// attached are tracked from then on. Only while the engine is not stepping, nullptr detaches
+		// the log (default). While a log is attached, retroactive edits apply from the current time,
+		// the log cannot take back what it wrote.
+		// The log must outlive the engine or be detached.
+		void setCompletionLog(FS::CompletionLog *log);
+
+		void step();
+		qreal timeStep() const { return mTimeStep; }
+		qreal simTime() const { return mSimTime; }
+		quint64 steps() const { return mSteps; }
+
+		void publish();
+		std::shared_ptr<const Snapshot> snapshot() const;
+
+	private:
+		struct Bucket
+		{
+			std::vector<quint32> id;
+			std::vector<qreal> speed;
+			std::vector<qreal> progress;
+			// pace of the recipe of the ongoing operation
+			std::vector<qreal> pace;
+		};
+
+		// conveyor only data, indexed by conveyor slot
+		struct Belts
+		{
+			std::vector<qreal> length;
+			std::vector<quint32> ringBegin;
+			// exit time of each part on the belts, one ring of capacity entries per conveyor,
+			// in step with the part ring of the conveyor; while a belt is stopped its ring holds
+			// the length left to each part instead
+			std::vector<qreal> exitTime;
+		};
+
+		// junction only data, indexed by junction slot
+		struct Junctions
+		{
+			std::vector<FS::MergeRule> merge;
+			std::vector<FS::DivertRule> divert;
+			// next lane tried by the zipper
+			std::vector<quint32> nextLane;
+			// lanes of each junction, in link order
+			std::vector<std::vector<quint32>> lanes;
+			// sum of the lane capacities, mCapacity holds the capacity of one lane
+			std::vector<quint32> capacity;
+		};
+
+		// history entries, stamped with the step they happened in
+		struct Transfer
+		{
+			quint64 step;
+			quint32 from;
+			quint32 to;
+			quint32 product;
+		};
+		struct Blocking
+		{
+			quint64 step;
+			quint32 id;
+			bool blocked;
+		};
+		struct SpeedEdit
+		{
+			quint64 step;
+			quint32 id;
+			qreal speed;
+		};
+
+		// dynamic state at the start of a step, plus the log positions at that step
+		struct Checkpoint
+		{
+			quint64 steps{ 0 };
+			std::size_t transfers{ 0 };
+			std::size_t blockings{ 0 };
+			std::size_t edits{ 0 };
+
+			std::vector<quint32> queue;
+			std::vector<FS::MachineState> state;
+			std::vector<quint64> completed;
+			std::vector<quint32> route;
+			std::vector<qreal> speed[FS::MachineKindCount];
+			std::vector<qreal> progress[FS::MachineKindCount];
+			std::vector<qreal> pace[FS::MachineKindCount];
+			std::vector<quint32> head;
+			std::vector<quint32> parts;
+			std::vector<quint32> held;
+			std::vector<quint32> outputs;
+			// next draw of each varied station
+			std::vector<quint64> draws;
+			// outage timeline of each station with outages, and its state before it went down
+			std::vector<FS::OutageTimeline> timelines;
+			std::vector<FS::MachineState> resume;
+			// arrival process position of each import with arrivals
+			std::vector<FS::ArrivalCursor> arrivals;
+			std::vector<qreal> exitTime;
+			std::vector<quint32> nextLane;
+			// products of the parts waiting in each lane
+			std::vector<std::vector<quint32>> lanes;
+		};
+
+		Bucket & bucket(FS::MachineKind kind) { return mBuckets[static_cast<int>(kind)]; }
+
+		void advance();
+		template <FS::MachineKind K>
+		void stepStations();
+		template <FS::MachineKind K>
+		void stepStation(quint32 slot);
+		void stepConveyors();
+		void stepConveyor(quint32 slot) { stepConveyor(slot, mTransfers, mBlockings); }
+		// logging into the given history, a partition of belts has its own
+		void stepConveyor(quint32 slot, std::vector<Transfer> & transfers, std::vector<Blocking> & blockings);
+		void stepJunctions();
+		void stepJunction(quint32 slot);
+		void stepSlot(FS::MachineKind kind, quint32 slot);
+		// hands over the outputs left of the operation, false if blocked before the last one
+		bool handOver(quint32 id);
+		bool forward(quint32 from, quint32 product) { return forward(from, product, mTransfers); }
+		bool forward(quint32 from, quint32 product, std::vector<Transfer> & transfers);
+		bool accept(quint32 from, quint32 to, quint32 product);
+		// factor of the next operation time of a varied station
+		qreal drawFactor(quint32 id);
+		// brings the stations whose outage timeline changes by now down or up
+		void updateOutages();
+		void updateOutage(quint32 id);
+		void rebuildOutageEvents();
+		// queues the parts arrived by now at the imports with arrivals
+		void updateArrivals();
+		void arrive(quint32 id);
+		void rebuildArrivalEvents();
+		void releaseArrivals(quint32 id);
+		// part tracking, with a completion log only: the rings, lanes and held parts hold
+		// handles of tracked parts instead of products
+		quint32 productOf(quint32 part) const { return mLog ? mPartProduct[part] : part; }
+		quint32 createPart(quint32 product, quint32 at);
+		quint32 clonePart(quint32 part);
+		void releasePart(quint32 part);
+		// logs the part as it leaves the factory and releases it
+		void completePart(quint32 part);
+		void convertParts(bool track);
+		// takes the first waiting part of a machine
+		quint32 takePart(quint32 id);
+		bool hasRoom(quint32 from, quint32 to) const;
+		// lane of the link from -> to at junction to
+		quint32 lane(quint32 from, quint32 to) const;
+		void countLanes(quint32 id);
+		void setState(quint32 id, FS::MachineState state) { setState(id, state, mBlockings); }
+		void setState(quint32 id, FS::MachineState state, std::vector<Blocking> & blockings);
+		void touch(quint32 id) { ++mVersion[id]; }
+		void logBlocking(quint32 id, bool blocked) { logBlocking(id, blocked, mBlockings); }
+		void logBlocking(quint32 id, bool blocked, std::vector<Blocking> & blockings) { if (mCheckpointInterval) blockings.push_back(Blocking{ mSteps, id, blocked }); }
+		void setActive(quint32 id, bool active) { if (!mReplaying) mDetector.setActive(id, active, mSteps); }
+		void resetActivity();
+		void applySpeed(quint32 id, qreal speed);
+		void retimeBelt(quint32 id, qreal from, qreal to);
+		void applyPending();
+		void sampleMetrics();
+		// calls f(chunk, begin, end) over consecutive ranges of machine ids, one chunk per
+		// ParallelGrain machines, in parallel when a scheduler is set
+		template <typename F>
+		void forMachines(F const & f) const;
+		quint32 chunkCount() const;
+
+		// checkpoints, in FSEngineCheckpoint.cpp
+		void clearHistory();
+		void saveCheckpoint();
+		void dropOldestCheckpoint(Checkpoint & spare);
+		void trimHistory();
+		void restore(Checkpoint const & cp, quint32 id);
+		void saveLane(Checkpoint & cp, quint32 lane) const;
+		void resimulate(quint32 id, qreal speed, qreal changeTime);
+		bool replayDownstream(std::size_t cpIndex, quint32 id, qreal speed, quint64 changeStep);
+		void replayAll(std::size_t cpIndex, quint32 id, qreal speed, quint64 changeStep);
+
+		qreal mTimeStep;
+		qreal mSimTime{ 0.0 };
+		quint64 mSteps{ 0 };
+
+		// state shared by every kind, indexed by machine id
+		std::vector<FS::MachineKind> mKind;
+		std::vector<quint32> mSlot;
+		std::vector<quint32> mQueue;
+		std::vector<quint32> mCapacity;
+		std::vector<FS::MachineState> mState;
+		std::vector<quint64> mCompleted;
+		std::vector<quint32> mVersion;
+
+		// products of the waiting parts, one ring of capacity entries per machine from its
+		// first waiting part (junctions keep theirs in the lanes)
+		std::vector<quint32> mPartBegin;
+		std::vector<quint32> mHead;
+		std::vector<quint32> mParts;
+		// product of the part being worked or held, and how many of them are still to hand over
+		std::vector<quint32> mHeld;
+		std::vector<quint32> mOutputs;
+		std::vector<quint32> mImportProduct;
+		FS::RecipeTable mRecipes;
+
+		// varied stations, indexed by mVaried[id] (NoMachine for fixed machines): variation, next draw,
+		// and DrawBatch factors drawn from draw mFactorBlock * DrawBatch
+		quint64 mSeed{ 0 };
+		std::vector<quint32> mVaried;
+		std::vector<FS::Variation> mVariation;
+		std::vector<quint64> mDraws;
+		std::vector<quint64> mFactorBlock;
+		std::vector<qreal> mFactors;
+
+		// stations with outages, indexed by mOutage[id] (NoMachine without outage), and the
+		// min-heap of the next change of their timeline, by time then id
+		std::vector<quint32> mOutage;
+		std::vector<FS::OutageModel> mOutageModel;
+		std::vector<FS::OutageTimeline> mTimelines;
+		std::vector<FS::MachineState> mResumeState;
+		std::vector<std::pair<qreal, quint32>> mOutageEvents;
+
+		// imports with arrivals, indexed by mArrival[id] (NoMachine without), with their trace reader
+		// if any, and the min-heap of their next arrival, by time then id
+		std::vector<quint32> mArrival;
+		std::vector<FS::ArrivalModel> mArrivalModel;
+		std::vector<FS::ArrivalCursor> mArrivalCursor;
+		std::vector<std::unique_ptr<FS::TraceReader>> mTraces;
+		std::vector<std::pair<qreal, quint32>> mArrivalEvents;
+
+		// links as added, and their compressed form (successors of id in mOut[mOutBegin[id]..mOutBegin[id + 1]])
+		std::vector<std::pair<quint32, quint32>> mLinks;
+		bool mTopologyDirty{ false };
+		std::vector<quint32> mOutBegin{ 0 };
+		std::vector<quint32> mOut;
+		// next successor tried by each machine
+		std::vector<quint32> mRoute;
+
+		// kind specific state, indexed by slot
+		Bucket mBuckets[FS::MachineKindCount];
+		Belts mBelts;
+		Junctions mJunctions;
+		// parts waiting at the junctions by lane, each holding its product
+		std::deque<FS::SpscQueue<quint32>> mLanes;
+		std::vector<quint32> mLaneFeeder;
+		// conveyor slots in step order: the belts whose successors are all junctions first
+		// (mLaneBelts of them), they only write their own state and lanes, then the others
+		std::vector<quint32> mBeltOrder;
+		quint32 mLaneBelts{ 0 };
+		// history of each partition of lane belts, appended in order after the partitions ran
+		std::vector<std::vector<Transfer>> mPartitionTransfers;
+		std::vector<std::vector<Blocking>> mPartitionBlockings;
+
+		// activity changes are not reported while a replay rewinds the time
+		FS::BottleneckDetector mDetector;
+		bool mReplaying{ false };
+
+		std::mutex mPendingMutex;
+		std::atomic<bool> mHasPending{ false };
+		std::vector<std::pair<quint32, qreal>> mPendingSpeed;
+		// retroactive edits: id, speed and change time
+		struct RetroactiveEdit
+		{
+			quint32 id;
+			qreal speed;
+			qreal since;
+		};
+		std::vector<RetroactiveEdit> mPendingRetroactive;
+
+		quint64 mCheckpointInterval{ 0 };
+		quint32 mMaxCheckpoints{ 16 };
+		quint64 mMaxLogEntries{ 1 << 22 };
+		std::deque<Checkpoint> mCheckpoints;
+		std::vector<Transfer> mTransfers;
+		std::vector<Blocking> mBlockings;
+		std::vector<SpeedEdit> mEdits;
+		quint32 mLastReplayCount{ 0 };
+		bool mDownstreamReplay{ true };
+
+		FS::MetricStore *mMetrics{ nullptr };
+		quint64 mMetricInterval{ 1 };
+		quint64 mNextSample{ 0 };
+		std::vector<quint64> mSampledCompleted;
+		std::vector<float> mSampleValues;
+		// per chunk partial sums of the samples
+		std::vector<quint64> mChunkCounts;
+		std::vector<float> mChunkSums;
+
+		FS::Scheduler *mScheduler{ nullptr };
+
+		// tracked parts by handle, released handles are reused with their visit buffers
+		FS::CompletionLog *mLog{ nullptr };
+		std::vector<quint32> mPartProduct;
+		std::vector<qreal> mPartCreated;
+		std::vector<std::vector<FS::CompletionLog::Visit>> mPartVisits;
+		std::vector<quint32> mFreeParts;
+
+		mutable std::mutex mSnapshotMutex;
+		std::shared_ptr<Snapshot> mSnapshot;
+		// previous snapshot, recycled once the GUI released it
+		std::shared_ptr<Snapshot> mSpareSnapshot;
+	};
+};
+
+#endif // FS_ENGINE_H
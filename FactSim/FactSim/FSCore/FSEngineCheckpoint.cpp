@@ -0,0 +1,531 @@
+#include "FSEngine.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Checkpoints and retroactive edits of FS::Engine.
+
+namespace
+{
+	FS::MachineKind const StepOrder[] = { FS::MachineKind::Export, FS::MachineKind::Conveyor,
+		FS::MachineKind::Junction, FS::MachineKind::Transform, FS::MachineKind::Workspace, FS::MachineKind::Import };
+
+	template <typename T>
+	bool beforeStep(T const & entry, quint64 step) { return entry.step < step; }
+
+	template <typename T>
+	bool byStep(T const & a, T const & b) { return a.step < b.step; }
+}
+
+void FS::Engine::setCheckpointing(quint64 intervalSteps, quint32 maxCheckpoints, quint64 maxLogEntries)
+{
+	mCheckpointInterval = intervalSteps;
+	mMaxCheckpoints = qMax<quint32>(1, maxCheckpoints);
+	mMaxLogEntries = qMax<quint64>(1, maxLogEntries);
+	clearHistory();
+}
+
+void FS::Engine::clearHistory()
+{
+	mCheckpoints.clear();
+	mTransfers.clear();
+	mBlockings.clear();
+	mEdits.clear();
+}
+
+void FS::Engine::dropOldestCheckpoint(Checkpoint & spare)
+{
+	spare = std::move(mCheckpoints.front());
+	mCheckpoints.pop_front();
+
+	std::size_t const t = mCheckpoints.empty() ? mTransfers.size() : mCheckpoints.front().transfers;
+	std::size_t const b = mCheckpoints.empty() ? mBlockings.size() : mCheckpoints.front().blockings;
+	std::size_t const e = mCheckpoints.empty() ? mEdits.size() : mCheckpoints.front().edits;
+	mTransfers.erase(mTransfers.begin(), mTransfers.begin() + t);
+	mBlockings.erase(mBlockings.begin(), mBlockings.begin() + b);
+	mEdits.erase(mEdits.begin(), mEdits.begin() + e);
+	for (Checkpoint &c : mCheckpoints)
+	{
+		c.transfers -= t;
+		c.blockings -= b;
+		c.edits -= e;
+	}
+}
+
+void FS::Engine::trimHistory()
+{
+	// the oldest checkpoints go first, edits then reach less far back
+	Checkpoint spare;
+	while (mCheckpoints.size() > 1 && mTransfers.size() + mBlockings.size() > mMaxLogEntries)
+		dropOldestCheckpoint(spare);
+	if (mTransfers.size() + mBlockings.size() <= mMaxLogEntries)
+		return;
+
+	// a single interval logs more than the cap, the history restarts now
+	clearHistory();
+	saveCheckpoint();
+}
+
+void FS::Engine::saveCheckpoint()
+{
+	if (!mCheckpoints.empty() && mCheckpoints.back().steps == mSteps)
+		return;
+
+	// the oldest checkpoint is dropped with the history only it needed, its buffers are reused
+	Checkpoint cp;
+	if (mCheckpoints.size() >= mMaxCheckpoints)
+		dropOldestCheckpoint(cp);
+
+	cp.steps = mSteps;
+	cp.transfers = mTransfers.size();
+	cp.blockings = mBlockings.size();
+	cp.edits = mEdits.size();
+	cp.queue.assign(mQueue.begin(), mQueue.end());
+	cp.state.assign(mState.begin(), mState.end());
+	cp.completed.assign(mCompleted.begin(), mCompleted.end());
+	cp.route.assign(mRoute.begin(), mRoute.end());
+	for (int k = 0; k < FS::MachineKindCount; ++k)
+	{
+		cp.speed[k].assign(mBuckets[k].speed.begin(), mBuckets[k].speed.end());
+		cp.progress[k].assign(mBuckets[k].progress.begin(), mBuckets[k].progress.end());
+		cp.pace[k].assign(mBuckets[k].pace.begin(), mBuckets[k].pace.end());
+	}
+	cp.head.assign(mHead.begin(), mHead.end());
+	cp.parts.assign(mParts.begin(), mParts.end());
+	cp.held.assign(mHeld.begin(), mHeld.end());
+	cp.outputs.assign(mOutputs.begin(), mOutputs.end());
+	cp.draws.assign(mDraws.begin(), mDraws.end());
+	cp.timelines.assign(mTimelines.begin(), mTimelines.end());
+	cp.resume.assign(mResumeState.begin(), mResumeState.end());
+	cp.arrivals.assign(mArrivalCursor.begin(), mArrivalCursor.end());
+	cp.exitTime.assign(mBelts.exitTime.begin(), mBelts.exitTime.end());
+	cp.nextLane.assign(mJunctions.nextLane.begin(), mJunctions.nextLane.end());
+	cp.lanes.resize(mLanes.size());
+	for (std::size_t l = 0; l < mLanes.size(); ++l)
+		saveLane(cp, static_cast<quint32>(l));
+	mCheckpoints.push_back(std::move(cp));
+}
+
+void FS::Engine::restore(Checkpoint const & cp, quint32 id)
+{
+	int const k = static_cast<int>(mKind[id]);
+	quint32 const s = mSlot[id];
+
+	mQueue[id] = cp.queue[id];
+	mState[id] = cp.state[id];
+	mCompleted[id] = cp.completed[id];
+	mRoute[id] = cp.route[id];
+	mBuckets[k].speed[s] = cp.speed[k][s];
+	mBuckets[k].progress[s] = cp.progress[k][s];
+	mBuckets[k].pace[s] = cp.pace[k][s];
+	mHead[id] = cp.head[id];
+	mHeld[id] = cp.held[id];
+	mOutputs[id] = cp.outputs[id];
+	if (mVaried[id] != NoMachine)
+		mDraws[mVaried[id]] = cp.draws[mVaried[id]];
+	if (mOutage[id] != NoMachine)
+	{
+		mTimelines[mOutage[id]] = cp.timelines[mOutage[id]];
+		mResumeState[mOutage[id]] = cp.resume[mOutage[id]];
+	}
+	if (mArrival[id] != NoMachine)
+		mArrivalCursor[mArrival[id]] = cp.arrivals[mArrival[id]];
+	std::copy(cp.parts.begin() + mPartBegin[id], cp.parts.begin() + mPartBegin[id] + mCapacity[id], mParts.begin() + mPartBegin[id]);
+	if (mKind[id] == FS::MachineKind::Conveyor)
+	{
+		quint32 const begin = mBelts.ringBegin[s];
+		std::copy(cp.exitTime.begin() + begin, cp.exitTime.begin() + begin + mCapacity[id], mBelts.exitTime.begin() + begin);
+	}
+	else if (mKind[id] == FS::MachineKind::Junction)
+	{
+		mJunctions.nextLane[s] = cp.nextLane[s];
+		for (quint32 l : mJunctions.lanes[s])
+		{
+			mLanes[l].clear();
+			for (quint32 part : cp.lanes[l])
+				mLanes[l].push(part);
+		}
+	}
+	touch(id);
+}
+
+void FS::Engine::saveLane(Checkpoint & cp, quint32 lane) const
+{
+	std::vector<quint32> & parts = cp.lanes[lane];
+	parts.clear();
+	mLanes[lane].forEach([&parts](quint32 part) { parts.push_back(part); });
+}
+
+void FS::Engine::resimulate(quint32 id, qreal speed, qreal changeTime)
+{
+	if (mCheckpoints.empty() || mLog)
+	{
+		applySpeed(id, speed);
+		mLastReplayCount = 0;
+		return;
+	}
+
+	// the edit applies at the start of changeStep
+	quint64 changeStep = changeTime > 0.0 ? static_cast<quint64>(std::ceil(changeTime / mTimeStep - 1e-9)) : 0;
+	changeStep = qBound(mCheckpoints.front().steps, changeStep, mSteps);
+
+	std::size_t cp = mCheckpoints.size() - 1;
+	while (mCheckpoints[cp].steps > changeStep)
+		--cp;
+
+	mReplaying = true;
+	if (!mDownstreamReplay || !replayDownstream(cp, id, speed, changeStep))
+		replayAll(cp, id, speed, changeStep);
+	mReplaying = false;
+	// the ongoing active periods are not in the checkpoints, they restart now
+	resetActivity();
+}
+
+bool FS::Engine::replayDownstream(std::size_t cpIndex, quint32 id, qreal speed, quint64 changeStep)
+{
+	quint32 const n = machineCount();
+	quint64 const now = mSteps;
+	Checkpoint const & cp = mCheckpoints[cpIndex];
+
+	// predecessors
+	std::vector<quint32> inBegin(n + 1, 0);
+	for (quint32 to : mOut)
+		++inBegin[to + 1];
+	for (quint32 i = 0; i < n; ++i)
+		inBegin[i + 1] += inBegin[i];
+	std::vector<quint32> in(mOut.size());
+	{
+		std::vector<quint32> cursor(inBegin.begin(), inBegin.end() - 1);
+		for (quint32 from = 0; from < n; ++from)
+		{
+			for (quint32 i = mOutBegin[from]; i < mOutBegin[from + 1]; ++i)
+				in[cursor[mOut[i]]++] = from;
+		}
+	}
+
+	// Affected machines: downstream of the edited one. A machine routing parts to an affected
+	// and to an unaffected successor is affected too, its round robin depends on both.
+	std::vector<char> affected(n, 0);
+	std::vector<quint32> work{ id };
+	affected[id] = 1;
+	quint32 count = 1;
+	while (!work.empty())
+	{
+		quint32 const x = work.back();
+		work.pop_back();
+		for (quint32 i = mOutBegin[x]; i < mOutBegin[x + 1]; ++i)
+		{
+			if (!affected[mOut[i]])
+			{
+				affected[mOut[i]] = 1;
+				work.push_back(mOut[i]);
+				++count;
+			}
+		}
+		for (quint32 i = inBegin[x]; i < inBegin[x + 1]; ++i)
+		{
+			quint32 const p = in[i];
+			if (!affected[p] && mOutBegin[p + 1] - mOutBegin[p] > 1)
+			{
+				affected[p] = 1;
+				work.push_back(p);
+				++count;
+			}
+		}
+	}
+	if (count == n)
+		return false;
+
+	// Boundary: unaffected machines feeding an affected one (through their only link).
+	// They are not simulated, their logged transfers are replayed instead.
+	struct Feeder
+	{
+		quint32 to;
+		std::vector<Transfer> transfers;
+		std::vector<Blocking> blockings;
+		std::size_t nextTransfer;
+		std::size_t nextBlocking;
+		bool blocked;
+	};
+	std::vector<quint32> feederIndex(n, NoMachine);
+	std::vector<Feeder> feeders;
+	for (quint32 x = 0; x < n; ++x)
+	{
+		if (!affected[x])
+			continue;
+		for (quint32 i = inBegin[x]; i < inBegin[x + 1]; ++i)
+		{
+			quint32 const p = in[i];
+			if (affected[p] || feederIndex[p] != NoMachine)
+				continue;
+			feederIndex[p] = static_cast<quint32>(feeders.size());
+			feeders.push_back(Feeder{ x, {}, {}, 0, 0, cp.state[p] == FS::MachineState::Blocked });
+		}
+	}
+	for (std::size_t i = cp.transfers; i < mTransfers.size(); ++i)
+	{
+		quint32 const f = feederIndex[mTransfers[i].from];
+		if (f != NoMachine)
+			feeders[f].transfers.push_back(mTransfers[i]);
+	}
+	for (std::size_t i = cp.blockings; i < mBlockings.size(); ++i)
+	{
+		quint32 const f = feederIndex[mBlockings[i].id];
+		if (f != NoMachine)
+			feeders[f].blockings.push_back(mBlockings[i]);
+	}
+
+	// edits to replay on the affected machines, the edited machine keeps its new speed from changeStep
+	std::vector<SpeedEdit> edits;
+	for (std::size_t i = cp.edits; i < mEdits.size(); ++i)
+	{
+		SpeedEdit const & e = mEdits[i];
+		if (affected[e.id] && !(e.id == id && e.step >= changeStep))
+			edits.push_back(e);
+	}
+	edits.insert(std::upper_bound(edits.begin(), edits.end(), SpeedEdit{ changeStep, id, speed }, byStep<SpeedEdit>),
+		SpeedEdit{ changeStep, id, speed });
+
+	// simulated and fed machines of each kind, in the order of a full step: slot order, the lane
+	// belts first for the conveyors
+	std::vector<quint32> order[FS::MachineKindCount];
+	for (int k = 0; k < FS::MachineKindCount; ++k)
+	{
+		std::vector<quint32> const & ids = mBuckets[k].id;
+		for (quint32 i = 0; i < ids.size(); ++i)
+		{
+			quint32 const x = ids[k == static_cast<int>(FS::MachineKind::Conveyor) ? mBeltOrder[i] : i];
+			if (affected[x] || feederIndex[x] != NoMachine)
+				order[k].push_back(x);
+		}
+	}
+
+	// affected stations with outages or arrivals, updated without the event heaps
+	std::vector<quint32> outaged;
+	std::vector<quint32> arriving;
+	for (quint32 x = 0; x < n; ++x)
+	{
+		if (affected[x] && mOutage[x] != NoMachine)
+			outaged.push_back(x);
+		if (affected[x] && mArrival[x] != NoMachine)
+			arriving.push_back(x);
+	}
+
+	// the history is rebuilt: before the checkpoint, unaffected entries, then the replayed ones
+	std::vector<Transfer> transfers;
+	std::vector<Blocking> blockings;
+	std::vector<SpeedEdit> loggedEdits;
+	transfers.swap(mTransfers);
+	blockings.swap(mBlockings);
+	loggedEdits.swap(mEdits);
+	mTransfers.assign(transfers.begin(), transfers.begin() + cp.transfers);
+	mBlockings.assign(blockings.begin(), blockings.begin() + cp.blockings);
+	mEdits.assign(loggedEdits.begin(), loggedEdits.begin() + cp.edits);
+
+	auto giveUp = [&]() {
+		mTransfers.swap(transfers);
+		mBlockings.swap(blockings);
+		mEdits.swap(loggedEdits);
+		mSteps = now;
+		mSimTime = now * mTimeStep;
+		return false;
+	};
+
+	for (quint32 x = 0; x < n; ++x)
+	{
+		if (affected[x])
+			restore(cp, x);
+	}
+
+	std::size_t nextEdit = 0;
+	std::size_t nextCheckpoint = cpIndex + 1;
+	for (quint64 s = cp.steps; s < now; ++s)
+	{
+		mSteps = s;
+		mSimTime = s * mTimeStep;
+		for (; nextEdit < edits.size() && edits[nextEdit].step == s; ++nextEdit)
+			applySpeed(edits[nextEdit].id, edits[nextEdit].speed);
+		for (quint32 x : outaged)
+		{
+			if (mTimelines[mOutage[x]].next() <= mSimTime)
+				updateOutage(x);
+		}
+		for (quint32 x : arriving)
+		{
+			while (mArrivalCursor[mArrival[x]].next() <= mSimTime)
+				arrive(x);
+		}
+
+		for (FS::MachineKind kind : StepOrder)
+		{
+			for (quint32 x : order[static_cast<int>(kind)])
+			{
+				if (affected[x])
+				{
+					stepSlot(kind, mSlot[x]);
+					continue;
+				}
+
+				// a feeder must do exactly what it did: hand over its logged parts, and stay
+				// blocked only if its successor is still full
+				Feeder &f = feeders[feederIndex[x]];
+				for (; f.nextTransfer < f.transfers.size() && f.transfers[f.nextTransfer].step == s; ++f.nextTransfer)
+				{
+					if (!accept(x, f.to, f.transfers[f.nextTransfer].product))
+						return giveUp();
+				}
+				for (; f.nextBlocking < f.blockings.size() && f.blockings[f.nextBlocking].step <= s; ++f.nextBlocking)
+					f.blocked = f.blockings[f.nextBlocking].blocked;
+				if (f.blocked && hasRoom(x, f.to))
+					return giveUp();
+			}
+		}
+
+		// later checkpoints get the replayed state of the affected machines
+		if (nextCheckpoint < mCheckpoints.size() && mCheckpoints[nextCheckpoint].steps == s + 1)
+		{
+			Checkpoint &later = mCheckpoints[nextCheckpoint++];
+			for (quint32 x = 0; x < n; ++x)
+			{
+				if (!affected[x])
+					continue;
+				int const k = static_cast<int>(mKind[x]);
+				quint32 const slot = mSlot[x];
+				later.queue[x] = mQueue[x];
+				later.state[x] = mState[x];
+				later.completed[x] = mCompleted[x];
+				later.route[x] = mRoute[x];
+				later.speed[k][slot] = mBuckets[k].speed[slot];
+				later.progress[k][slot] = mBuckets[k].progress[slot];
+				later.pace[k][slot] = mBuckets[k].pace[slot];
+				later.head[x] = mHead[x];
+				later.held[x] = mHeld[x];
+				later.outputs[x] = mOutputs[x];
+				if (mVaried[x] != NoMachine)
+					later.draws[mVaried[x]] = mDraws[mVaried[x]];
+				if (mOutage[x] != NoMachine)
+				{
+					later.timelines[mOutage[x]] = mTimelines[mOutage[x]];
+					later.resume[mOutage[x]] = mResumeState[mOutage[x]];
+				}
+				if (mArrival[x] != NoMachine)
+					later.arrivals[mArrival[x]] = mArrivalCursor[mArrival[x]];
+				std::copy(mParts.begin() + mPartBegin[x], mParts.begin() + mPartBegin[x] + mCapacity[x], later.parts.begin() + mPartBegin[x]);
+				if (mKind[x] == FS::MachineKind::Conveyor)
+				{
+					quint32 const begin = mBelts.ringBegin[slot];
+					std::copy(mBelts.exitTime.begin() + begin, mBelts.exitTime.begin() + begin + mCapacity[x], later.exitTime.begin() + begin);
+				}
+				else if (mKind[x] == FS::MachineKind::Junction)
+				{
+					later.nextLane[slot] = mJunctions.nextLane[slot];
+					for (quint32 l : mJunctions.lanes[slot])
+						saveLane(later, l);
+				}
+			}
+		}
+	}
+	mSteps = now;
+	mSimTime = now * mTimeStep;
+	for (; nextEdit < edits.size(); ++nextEdit)
+		applySpeed(edits[nextEdit].id, edits[nextEdit].speed);
+
+	// merge back the unaffected history
+	std::size_t const t0 = cp.transfers, b0 = cp.blockings, e0 = cp.edits;
+	for (std::size_t i = t0; i < transfers.size(); ++i)
+	{
+		if (!affected[transfers[i].from])
+			mTransfers.push_back(transfers[i]);
+	}
+	for (std::size_t i = b0; i < blockings.size(); ++i)
+	{
+		if (!affected[blockings[i].id])
+			mBlockings.push_back(blockings[i]);
+	}
+	for (std::size_t i = e0; i < loggedEdits.size(); ++i)
+	{
+		if (!affected[loggedEdits[i].id])
+			mEdits.push_back(loggedEdits[i]);
+	}
+	std::stable_sort(mTransfers.begin() + t0, mTransfers.end(), byStep<Transfer>);
+	std::stable_sort(mBlockings.begin() + b0, mBlockings.end(), byStep<Blocking>);
+	std::stable_sort(mEdits.begin() + e0, mEdits.end(), byStep<SpeedEdit>);
+	for (std::size_t c = cpIndex + 1; c < mCheckpoints.size(); ++c)
+	{
+		Checkpoint &later = mCheckpoints[c];
+		later.transfers = std::lower_bound(mTransfers.begin(), mTransfers.end(), later.steps, beforeStep<Transfer>) - mTransfers.begin();
+		later.blockings = std::lower_bound(mBlockings.begin(), mBlockings.end(), later.steps, beforeStep<Blocking>) - mBlockings.begin();
+		later.edits = std::lower_bound(mEdits.begin(), mEdits.end(), later.steps, beforeStep<SpeedEdit>) - mEdits.begin();
+	}
+
+	rebuildOutageEvents();
+	rebuildArrivalEvents();
+	mLastReplayCount = count;
+	return true;
+}
+
+void FS::Engine::replayAll(std::size_t cpIndex, quint32 id, qreal speed, quint64 changeStep)
+{
+	quint64 const now = mSteps;
+	mCheckpoints.erase(mCheckpoints.begin() + cpIndex + 1, mCheckpoints.end());
+	Checkpoint const & cp = mCheckpoints.back();
+
+	std::vector<SpeedEdit> edits;
+	for (std::size_t i = cp.edits; i < mEdits.size(); ++i)
+	{
+		if (!(mEdits[i].id == id && mEdits[i].step >= changeStep))
+			edits.push_back(mEdits[i]);
+	}
+	edits.insert(std::upper_bound(edits.begin(), edits.end(), SpeedEdit{ changeStep, id, speed }, byStep<SpeedEdit>),
+		SpeedEdit{ changeStep, id, speed });
+
+	mTransfers.resize(cp.transfers);
+	mBlockings.resize(cp.blockings);
+	mEdits.resize(cp.edits);
+
+	mQueue.assign(cp.queue.begin(), cp.queue.end());
+	mState.assign(cp.state.begin(), cp.state.end());
+	mCompleted.assign(cp.completed.begin(), cp.completed.end());
+	mRoute.assign(cp.route.begin(), cp.route.end());
+	for (int k = 0; k < FS::MachineKindCount; ++k)
+	{
+		mBuckets[k].speed.assign(cp.speed[k].begin(), cp.speed[k].end());
+		mBuckets[k].progress.assign(cp.progress[k].begin(), cp.progress[k].end());
+		mBuckets[k].pace.assign(cp.pace[k].begin(), cp.pace[k].end());
+	}
+	mHead.assign(cp.head.begin(), cp.head.end());
+	mParts.assign(cp.parts.begin(), cp.parts.end());
+	mHeld.assign(cp.held.begin(), cp.held.end());
+	mOutputs.assign(cp.outputs.begin(), cp.outputs.end());
+	mDraws.assign(cp.draws.begin(), cp.draws.end());
+	mTimelines.assign(cp.timelines.begin(), cp.timelines.end());
+	mResumeState.assign(cp.resume.begin(), cp.resume.end());
+	mArrivalCursor.assign(cp.arrivals.begin(), cp.arrivals.end());
+	rebuildOutageEvents();
+	rebuildArrivalEvents();
+	mBelts.exitTime.assign(cp.exitTime.begin(), cp.exitTime.end());
+	mJunctions.nextLane.assign(cp.nextLane.begin(), cp.nextLane.end());
+	for (std::size_t l = 0; l < mLanes.size(); ++l)
+	{
+		mLanes[l].clear();
+		for (quint32 part : cp.lanes[l])
+			mLanes[l].push(part);
+	}
+	mSteps = cp.steps;
+	mSimTime = mSteps * mTimeStep;
+
+	// advance() saves the checkpoints again on the way, cp may be dropped meanwhile
+	std::size_t nextEdit = 0;
+	while (mSteps < now)
+	{
+		for (; nextEdit < edits.size() && edits[nextEdit].step == mSteps; ++nextEdit)
+			applySpeed(edits[nextEdit].id, edits[nextEdit].speed);
+		advance();
+	}
+	for (; nextEdit < edits.size(); ++nextEdit)
+		applySpeed(edits[nextEdit].id, edits[nextEdit].speed);
+
+	for (quint32 x = 0; x < machineCount(); ++x)
+		touch(x);
+	mLastReplayCount = machineCount();
+}
@@ -0,0 +1,75 @@
+#ifndef FS_ID_SET_H
+#define FS_ID_SET_H
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <vector>
+
+namespace FS
+{
+	// Set of dense ids stored as a bitset.
+	// One bit per id, so a selection over 100k machines fits in 12.5 kB.
+	class IdSet
+	{
+	public:
+		IdSet() = default;
+		explicit IdSet(quint32 size) { resize(size); }
+		~IdSet() = default;
+
+		quint32 size() const { return mSize; }
+		void resize(quint32 size)
+		{
+			mSize = size;
+			mWords.resize((size + 63) / 64, 0);
+			// ids dropped by a shrink must not come back if the set grows again
+			if (size & 63)
+				mWords.back() &= (quint64(1) << (size & 63)) - 1;
+		}
+
+		bool test(quint32 id) const { return id < mSize && (mWords[id >> 6] >> (id & 63)) & 1; }
+		void set(quint32 id) { if (id < mSize) mWords[id >> 6] |= quint64(1) << (id & 63); }
+		void reset(quint32 id) { if (id < mSize) mWords[id >> 6] &= ~(quint64(1) << (id & 63)); }
+		void toggle(quint32 id) { if (id < mSize) mWords[id >> 6] ^= quint64(1) << (id & 63); }
+		void clear() { std::fill(mWords.begin(), mWords.end(), 0); }
+
+		bool isEmpty() const
+		{
+			for (quint64 w : mWords)
+				if (w)
+					return false;
+			return true;
+		}
+
+		quint32 count() const
+		{
+			quint32 n = 0;
+			for (quint64 w : mWords)
+				for (; w; w &= w - 1)
+					++n;
+			return n;
+		}
+
+		// calls f(id) for every id of the set, in increasing order
+		template <typename F>
+		void forEach(F f) const
+		{
+			for (std::size_t i = 0; i < mWords.size(); ++i)
+			{
+				for (quint64 w = mWords[i]; w; w &= w - 1)
+				{
+					quint32 bit = 0;
+					while (!((w >> bit) & 1))
+						++bit;
+					f(static_cast<quint32>(i * 64 + bit));
+				}
+			}
+		}
+
+	private:
+		quint32 mSize{ 0 };
+		std::vector<quint64> mWords;
+	};
+};
+
+#endif // FS_ID_SET_H
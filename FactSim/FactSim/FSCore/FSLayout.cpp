@@ -0,0 +1,329 @@
+#include "FSLayout.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+
+#include "FSEngine.h"
+
+namespace
+{
+	bool kindFromName(QString const & name, FS::MachineKind & kind)
+	{
+		for (int k = 0; k < FS::MachineKindCount; ++k)
+		{
+			if (name == QLatin1String(FS::machineKindName(static_cast<FS::MachineKind>(k))))
+			{
+				kind = static_cast<FS::MachineKind>(k);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template <typename Rule>
+	bool ruleFromName(QString const & name, Rule & rule, int count, char const *(*ruleName)(Rule))
+	{
+		// missing rule keeps the default
+		if (name.isEmpty())
+			return true;
+		for (int r = 0; r < count; ++r)
+		{
+			if (name == QLatin1String(ruleName(static_cast<Rule>(r))))
+			{
+				rule = static_cast<Rule>(r);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// an index in the string table of the file, or a plain string
+	bool stringFromValue(QJsonValue const & value, std::vector<quint32> const & strings, quint32 & handle)
+	{
+		if (value.isUndefined() || value.isNull())
+			handle = FS::StringPool::Empty;
+		else if (value.isString())
+			handle = FS::StringPool::instance().intern(value.toString());
+		else if (value.isDouble() && value.toInt(-1) >= 0 && static_cast<std::size_t>(value.toInt(-1)) < strings.size())
+			handle = strings[value.toInt()];
+		else
+			return false;
+		return true;
+	}
+
+	// index of the handle in the string table being written
+	int stringIndex(quint32 handle, QHash<quint32, int> & indices, QJsonArray & strings)
+	{
+		auto const it = indices.constFind(handle);
+		if (it != indices.constEnd())
+			return it.value();
+		int const index = strings.size();
+		strings.append(FS::StringPool::instance().string(handle));
+		indices.insert(handle, index);
+		return index;
+	}
+
+	bool fail(QString *error, QString const & message)
+	{
+		if (error)
+			*error = message;
+		return false;
+	}
+}
+
+bool FS::Layout::load(QString const & fileName, QString *error)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return fail(error, QString("cannot open %1").arg(fileName));
+
+	QJsonParseError parseError;
+	QJsonDocument const doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+	if (doc.isNull())
+		return fail(error, QString("%1: %2").arg(fileName, parseError.errorString()));
+
+	QJsonObject const root = doc.object();
+	QJsonArray const jsonMachines = root["machines"].toArray();
+	QJsonArray const jsonLinks = root["links"].toArray();
+
+	std::vector<quint32> strings;
+	for (QJsonValue const & string : root["strings"].toArray())
+		strings.push_back(FS::StringPool::instance().intern(string.toString()));
+
+	FS::RecipeBook book;
+	for (QJsonValue const & product : root["products"].toArray())
+		book.addProduct(product.toString());
+	QJsonArray const jsonRecipes = root["recipes"].toArray();
+	for (int i = 0; i < jsonRecipes.size(); ++i)
+	{
+		QJsonObject const r = jsonRecipes[i].toObject();
+		FS::Recipe recipe;
+		recipe.input = book.product(r["input"].toString());
+		recipe.output = book.product(r["output"].toString());
+		recipe.outputCount = static_cast<quint32>(qMax(0, r["count"].toInt(1)));
+		recipe.time = r["time"].toDouble(1.0);
+		if (!kindFromName(r["kind"].toString(), recipe.kind) || !stringFromValue(r["label"], strings, recipe.label)
+			|| !book.addRecipe(recipe))
+			return fail(error, QString("%1: recipe %2 is invalid").arg(fileName).arg(i));
+	}
+
+	std::vector<FS::MachineSpec> specs(jsonMachines.size());
+	for (int i = 0; i < jsonMachines.size(); ++i)
+	{
+		QJsonObject const m = jsonMachines[i].toObject();
+		FS::MachineSpec &spec = specs[i];
+		if (!kindFromName(m["kind"].toString(), spec.kind))
+			return fail(error, QString("%1: machine %2 has an unknown kind").arg(fileName).arg(i));
+		spec.x = m["x"].toInt();
+		spec.y = m["y"].toInt();
+		spec.speed = m["speed"].toDouble();
+		spec.capacity = static_cast<quint32>(qMax(1, m["capacity"].toInt(8)));
+		spec.length = m["length"].toDouble();
+		if (!ruleFromName(m["merge"].toString(), spec.merge, FS::MergeRuleCount, FS::mergeRuleName)
+			|| !ruleFromName(m["divert"].toString(), spec.divert, FS::DivertRuleCount, FS::divertRuleName))
+			return fail(error, QString("%1: machine %2 has an unknown junction rule").arg(fileName).arg(i));
+		if (m.contains("product"))
+		{
+			spec.product = book.product(m["product"].toString());
+			if (spec.product == FS::RecipeBook::NoProduct)
+				return fail(error, QString("%1: machine %2 has an unknown product").arg(fileName).arg(i));
+		}
+		QJsonObject const v = m["variation"].toObject();
+		if (!ruleFromName(v["distribution"].toString(), spec.variation.distribution, FS::DistributionCount, FS::distributionName)
+			|| v["shape"].toInt(1) < 1 || v["cv"].toDouble() < 0.0)
+			return fail(error, QString("%1: machine %2 has an invalid variation").arg(fileName).arg(i));
+		spec.variation.shape = static_cast<quint32>(v["shape"].toInt(1));
+		spec.variation.cv = v["cv"].toDouble();
+		QJsonObject const o = m["outages"].toObject();
+		spec.outages.mtbf = o["mtbf"].toDouble();
+		spec.outages.mttr = o["mttr"].toDouble();
+		spec.outages.calendar.period = o["period"].toDouble();
+		bool outagesValid = spec.outages.mtbf >= 0.0 && spec.outages.mttr >= 0.0;
+		for (QJsonValue const & w : o["windows"].toArray())
+			outagesValid = outagesValid && spec.outages.calendar.addWindow(w.toArray()[0].toDouble(), w.toArray()[1].toDouble());
+		if (!outagesValid)
+			return fail(error, QString("%1: machine %2 has invalid outages").arg(fileName).arg(i));
+		if (m.contains("arrivals"))
+		{
+			QJsonObject const a = m["arrivals"].toObject();
+			FS::ArrivalModel &arrivals = spec.arrivals;
+			bool arrivalsValid = ruleFromName(a["kind"].toString(), arrivals.kind, FS::ArrivalKindCount, FS::arrivalKindName);
+			arrivals.period = a["period"].toDouble();
+			for (QJsonValue const & r : a["rates"].toArray())
+				arrivalsValid = arrivalsValid && arrivals.addSegment(r.toArray()[0].toDouble(), r.toArray()[1].toDouble());
+			if (arrivals.kind == FS::ArrivalKind::Piecewise)
+				arrivalsValid = arrivalsValid && arrivals.period > 0.0 && !arrivals.segments.empty();
+			if (arrivals.kind == FS::ArrivalKind::Trace)
+			{
+				arrivalsValid = arrivalsValid && !a["file"].toString().isEmpty();
+				arrivals.trace = QFileInfo(fileName).absoluteDir().absoluteFilePath(a["file"].toString());
+				// the engine would silently never get a part from a missing trace
+				QFile trace(arrivals.trace);
+				arrivalsValid = arrivalsValid && trace.open(QIODevice::ReadOnly);
+			}
+			if (!arrivalsValid)
+				return fail(error, QString("%1: machine %2 has invalid arrivals").arg(fileName).arg(i));
+			spec.hasArrivals = true;
+		}
+		if (!stringFromValue(m["name"], strings, spec.name) || !stringFromValue(m["description"], strings, spec.description))
+			return fail(error, QString("%1: machine %2 has an invalid string").arg(fileName).arg(i));
+	}
+
+	std::vector<std::pair<quint32, quint32>> pairs;
+	pairs.reserve(jsonLinks.size());
+	for (int i = 0; i < jsonLinks.size(); ++i)
+	{
+		QJsonArray const l = jsonLinks[i].toArray();
+		int const from = l.size() == 2 ? l[0].toInt(-1) : -1;
+		int const to = l.size() == 2 ? l[1].toInt(-1) : -1;
+		if (from < 0 || to < 0 || from >= jsonMachines.size() || to >= jsonMachines.size())
+			return fail(error, QString("%1: link %2 is invalid").arg(fileName).arg(i));
+		pairs.emplace_back(static_cast<quint32>(from), static_cast<quint32>(to));
+	}
+
+	machines.swap(specs);
+	links.swap(pairs);
+	recipes = book;
+	return true;
+}
+
+bool FS::Layout::save(QString const & fileName) const
+{
+	// each distinct string once, the empty one first
+	QJsonArray jsonStrings;
+	QHash<quint32, int> stringIndices;
+	stringIndex(FS::StringPool::Empty, stringIndices, jsonStrings);
+
+	QJsonArray jsonMachines;
+	for (FS::MachineSpec const & spec : machines)
+	{
+		QJsonObject m;
+		m["kind"] = QString(FS::machineKindName(spec.kind));
+		m["x"] = spec.x;
+		m["y"] = spec.y;
+		m["speed"] = spec.speed;
+		m["capacity"] = static_cast<int>(spec.capacity);
+		if (spec.length > 0.0)
+			m["length"] = spec.length;
+		if (spec.kind == FS::MachineKind::Junction)
+		{
+			m["merge"] = QString(FS::mergeRuleName(spec.merge));
+			m["divert"] = QString(FS::divertRuleName(spec.divert));
+		}
+		if (spec.kind == FS::MachineKind::Import && spec.product < recipes.productCount())
+			m["product"] = recipes.productName(spec.product);
+		if (!spec.variation.isFixed())
+		{
+			QJsonObject v;
+			v["distribution"] = QString(FS::distributionName(spec.variation.distribution));
+			if (spec.variation.distribution == FS::Distribution::Erlang)
+				v["shape"] = static_cast<int>(spec.variation.shape);
+			if (spec.variation.distribution == FS::Distribution::Lognormal)
+				v["cv"] = spec.variation.cv;
+			m["variation"] = v;
+		}
+		if (spec.outages.isEnabled())
+		{
+			QJsonObject o;
+			if (spec.outages.mtbf > 0.0)
+			{
+				o["mtbf"] = spec.outages.mtbf;
+				o["mttr"] = spec.outages.mttr;
+			}
+			if (!spec.outages.calendar.isEmpty())
+			{
+				QJsonArray windows;
+				for (FS::Calendar::Window const & w : spec.outages.calendar.windows)
+					windows.append(QJsonArray{ w.start, w.duration });
+				o["period"] = spec.outages.calendar.period;
+				o["windows"] = windows;
+			}
+			m["outages"] = o;
+		}
+		if (spec.kind == FS::MachineKind::Import && spec.hasArrivals)
+		{
+			QJsonObject a;
+			a["kind"] = QString(FS::arrivalKindName(spec.arrivals.kind));
+			if (spec.arrivals.kind == FS::ArrivalKind::Piecewise)
+			{
+				QJsonArray rates;
+				for (FS::ArrivalModel::Segment const & r : spec.arrivals.segments)
+					rates.append(QJsonArray{ r.start, r.rate });
+				a["period"] = spec.arrivals.period;
+				a["rates"] = rates;
+			}
+			if (spec.arrivals.kind == FS::ArrivalKind::Trace)
+				a["file"] = QFileInfo(fileName).absoluteDir().relativeFilePath(spec.arrivals.trace);
+			m["arrivals"] = a;
+		}
+		m["name"] = stringIndex(spec.name, stringIndices, jsonStrings);
+		m["description"] = stringIndex(spec.description, stringIndices, jsonStrings);
+		jsonMachines.append(m);
+	}
+
+	QJsonArray jsonLinks;
+	for (auto const & l : links)
+		jsonLinks.append(QJsonArray{ static_cast<int>(l.first), static_cast<int>(l.second) });
+
+	QJsonObject root;
+	root["machines"] = jsonMachines;
+	root["links"] = jsonLinks;
+	if (recipes.productCount() > 0)
+	{
+		QJsonArray jsonProducts;
+		for (quint32 p = 0; p < recipes.productCount(); ++p)
+			jsonProducts.append(recipes.productName(p));
+		QJsonArray jsonRecipes;
+		for (FS::Recipe const & recipe : recipes.recipes())
+		{
+			QJsonObject r;
+			r["kind"] = QString(FS::machineKindName(recipe.kind));
+			r["input"] = recipes.productName(recipe.input);
+			r["output"] = recipes.productName(recipe.output);
+			r["count"] = static_cast<int>(recipe.outputCount);
+			r["time"] = recipe.time;
+			if (recipe.label != FS::StringPool::Empty)
+				r["label"] = stringIndex(recipe.label, stringIndices, jsonStrings);
+			jsonRecipes.append(r);
+		}
+		root["products"] = jsonProducts;
+		root["recipes"] = jsonRecipes;
+	}
+	root["strings"] = jsonStrings;
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+	return file.write(QJsonDocument(root).toJson()) >= 0;
+}
+
+quint32 FS::Layout::instantiate(FS::Engine & engine) const
+{
+	quint32 const first = engine.machineCount();
+	engine.setRecipes(recipes.compile());
+	for (FS::MachineSpec const & spec : machines)
+	{
+		quint32 const id = engine.addMachine(spec.kind, spec.speed, spec.capacity);
+		if (spec.length > 0.0)
+			engine.setConveyorLength(id, spec.length);
+		if (spec.kind == FS::MachineKind::Junction)
+			engine.setJunctionRules(id, spec.merge, spec.divert);
+		if (spec.kind == FS::MachineKind::Import)
+			engine.setImportProduct(id, spec.product);
+		if (spec.kind == FS::MachineKind::Import && spec.hasArrivals)
+			engine.setArrivals(id, spec.arrivals);
+		if (!spec.variation.isFixed())
+			engine.setVariation(id, spec.variation);
+		if (spec.outages.isEnabled())
+			engine.setOutages(id, spec.outages);
+	}
+	for (auto const & l : links)
+		engine.connect(first + l.first, first + l.second);
+	return first;
+}
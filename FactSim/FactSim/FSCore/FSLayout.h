@@ -0,0 +1,87 @@
+#ifndef FS_LAYOUT_H
+#define FS_LAYOUT_H
+
+#include <QString>
+
+#include <utility>
+#include <vector>
+
+#include "FSArrival.h"
+#include "FSMachineKind.h"
+#include "FSOutage.h"
+#include "FSRandom.h"
+#include "FSRecipeBook.h"
+#include "FSStringPool.h"
+
+namespace FS
+{
+	class Engine;
+
+	// Plain description of one machine of a layout.
+	// Specs carry no graphics nor engine state, so they can be built and copied on any thread.
+	struct MachineSpec
+	{
+		FS::MachineKind kind{ FS::MachineKind::Workspace };
+		int x{ 0 };
+		int y{ 0 };
+		qreal speed{ 0.0 };
+		quint32 capacity{ 8 };
+		// conveyors only, 0 keeps the engine default
+		qreal length{ 0.0 };
+		// junctions only
+		FS::MergeRule merge{ FS::MergeRule::Zipper };
+		FS::DivertRule divert{ FS::DivertRule::RoundRobin };
+		// imports only, product id in the recipe book of the layout
+		quint32 product{ 0 };
+		// imports only, the import pushes parts as fast as it can without arrival process
+		bool hasArrivals{ false };
+		FS::ArrivalModel arrivals;
+		// stations only, spread of the operation times
+		FS::Variation variation;
+		// stations only, breakdowns and planned downtime
+		FS::OutageModel outages;
+		// handles in FS::StringPool::instance()
+		quint32 name{ FS::StringPool::Empty };
+		quint32 description{ FS::StringPool::Empty };
+	};
+
+	// Machines and links of a factory, independent of the graphics items.
+	// Stored as JSON:
+	//   { "machines": [ { "kind": "import", "x": 0, "y": 0, "speed": 60, "capacity": 8, "length": 100,
+	//                     "merge": "zipper", "divert": "round_robin", "product": "ore",
+	//                     "variation": { "distribution": "erlang", "shape": 4, "cv": 0.5 },
+	//                     "outages": { "mtbf": 7200, "mttr": 600, "period": 86400, "windows": [ [ 57600, 28800 ], ... ] },
+	//                     "arrivals": { "kind": "piecewise", "period": 86400, "rates": [ [ 0, 5 ], [ 28800, 40 ], ... ],
+	//                                   "file": "orders.csv" },
+	//                     "name": 1, "description": 2 }, ... ],
+	//     "links": [ [from, to], ... ],
+	//     "products": [ "ore", "ingot", ... ],
+	//     "recipes": [ { "kind": "transform", "input": "ore", "output": "ingot", "count": 1, "time": 2.5,
+	//                    "label": 3 }, ... ],
+	//     "strings": [ "", "Furnace", "Melts the ore", "smelting", ... ] }
+	// links refer to the machines by their index in the list, merge and divert are for junctions only,
+	// product for imports only (the first product by default). Products and recipes are optional.
+	// Variations are for stations, fixed when missing; shape is read for erlang, cv for lognormal.
+	// Outages are for stations too: mtbf and mttr in seconds, then the calendar windows repeating
+	// every period as [ start, duration ] in seconds; each part is optional.
+	// Arrivals are for imports: rates are read for piecewise, as [ start, parts per minute ] with
+	// a period and at least one rate, and the file for trace, relative to the layout file, which
+	// must be readable when the layout is loaded.
+	// Names, descriptions and labels are indices in "strings", each distinct string is written once;
+	// plain strings are read too.
+	struct Layout
+	{
+		std::vector<FS::MachineSpec> machines;
+		std::vector<std::pair<quint32, quint32>> links;
+		FS::RecipeBook recipes;
+
+		// returns false and fills error if the file cannot be read or is malformed
+		bool load(QString const & fileName, QString *error = nullptr);
+		bool save(QString const & fileName) const;
+
+		// registers machines, links and recipes in the engine, machine i of the layout gets the id first + i
+		quint32 instantiate(FS::Engine & engine) const;
+	};
+};
+
+#endif // FS_LAYOUT_H
@@ -0,0 +1,73 @@
+#ifndef FS_MACHINE_KIND_H
+#define FS_MACHINE_KIND_H
+
+#include <QtGlobal>
+
+namespace FS
+{
+	// Closed set of machine kinds.
+	// Every branch on the machine type goes through this tag instead of RTTI,
+	// the engine keeps one bucket of homogeneous data per kind.
+	enum class MachineKind : quint8
+	{
+		Workspace,		// generic work station
+		Import,			// material source
+		Export,			// material sink
+		Transform,		// station changing the product
+		Conveyor,		// fixed delay transport
+		Transporter,	// free moving vehicle
+		Junction		// merge or divert point between belts
+	};
+	int const MachineKindCount{ 7 };
+
+	enum class MachineState : quint8
+	{
+		Idle,			// waiting for a part (starved)
+		Working,		// processing or carrying a part
+		Blocked,		// holding a finished part, downstream is full
+		Down			// broken or in a planned downtime
+	};
+
+	// which waiting input a junction takes next
+	enum class MergeRule : quint8
+	{
+		Zipper,			// the inputs take turns
+		Priority		// the first input with a part, in link order
+	};
+	int const MergeRuleCount{ 2 };
+
+	// which output a junction hands its part to
+	enum class DivertRule : quint8
+	{
+		RoundRobin,		// the outputs take turns, full ones are skipped
+		FirstFree		// the first output with room, in link order
+	};
+	int const DivertRuleCount{ 2 };
+
+	// lower case names used by the layout files and the reports
+	inline char const * machineKindName(FS::MachineKind kind)
+	{
+		static char const * const names[MachineKindCount] = { "workspace", "import", "export", "transform", "conveyor", "transporter", "junction" };
+		return names[static_cast<int>(kind)];
+	}
+
+	inline char const * mergeRuleName(FS::MergeRule rule)
+	{
+		static char const * const names[MergeRuleCount] = { "zipper", "priority" };
+		return names[static_cast<int>(rule)];
+	}
+
+	inline char const * divertRuleName(FS::DivertRule rule)
+	{
+		static char const * const names[DivertRuleCount] = { "round_robin", "first_free" };
+		return names[static_cast<int>(rule)];
+	}
+
+	inline char const * machineStateName(FS::MachineState state)
+	{
+		static char const * const names[] = { "idle", "working", "blocked", "down" };
+		return names[static_cast<int>(state)];
+	}
+};
+
+#endif // FS_MACHINE_KIND_H
@@ -0,0 +1,357 @@
+#include "FSMetricStore.h"
+
+#include <QFile>
+#include <QTemporaryFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+quint32 const FS::MetricStore::Factory;
+quint32 const FS::MetricStore::ChunkPoints;
+quint32 const FS::MetricStore::MinChunkPoints;
+quint64 const FS::MetricStore::DefaultResidentLimit;
+
+// Spill file, grown by large segments mapped once.
+// Chunks are copied in the mapped memory, the system writes them back and drops the pages
+// when memory is short, they are paged in again when a query reads them.
+class FS::MetricStore::SpillFile
+{
+public:
+	~SpillFile()
+	{
+		for (uchar *segment : mSegments)
+			mFile->unmap(segment);
+	}
+
+	bool open(QString const & fileName)
+	{
+		if (fileName.isEmpty())
+		{
+			QTemporaryFile *file = new QTemporaryFile;
+			mFile.reset(file);
+			return file->open();
+		}
+		mFile.reset(new QFile(fileName));
+		return mFile->open(QIODevice::ReadWrite | QIODevice::Truncate);
+	}
+
+	float * allocate(std::size_t bytes)
+	{
+		if (mCurrent == mSegments.size() || mUsed + static_cast<qint64>(bytes) > SegmentSize)
+		{
+			if (mCurrent + 1 < mSegments.size())
+			{
+				++mCurrent;
+			}
+			else
+			{
+				qint64 const offset = static_cast<qint64>(mSegments.size()) * SegmentSize;
+				if (!mFile->resize(offset + SegmentSize))
+					return nullptr;
+				uchar *segment = mFile->map(offset, SegmentSize);
+				if (!segment)
+					return nullptr;
+				mSegments.push_back(segment);
+				mCurrent = mSegments.size() - 1;
+			}
+			mUsed = 0;
+		}
+		float *p = reinterpret_cast<float*>(mSegments[mCurrent] + mUsed);
+		mUsed += bytes;
+		return p;
+	}
+
+	// the segments are reused from the start
+	void rewind()
+	{
+		mCurrent = 0;
+		mUsed = 0;
+	}
+
+private:
+	static qint64 const SegmentSize{ 64 << 20 };
+
+	std::unique_ptr<QFile> mFile;
+	std::vector<uchar*> mSegments;
+	std::size_t mCurrent{ 0 };
+	qint64 mUsed{ 0 };
+};
+
+qint64 const FS::MetricStore::SpillFile::SegmentSize;
+
+FS::MetricStore::MetricStore(qreal interval, quint32 fanout, quint32 levels)
+	: mInterval{ interval }
+	, mFanout{ std::max<quint32>(2, fanout) }
+	, mLevels{ std::max<quint32>(1, levels) }
+{
+	std::fill(mSamples, mSamples + FS::MetricCount, 0);
+	// a chunk of each level spans about ChunkPoints samples
+	quint64 points = ChunkPoints;
+	for (quint32 level = 0; level < mLevels; ++level)
+	{
+		mChunkPoints.push_back(static_cast<quint32>(std::max<quint64>(MinChunkPoints, points)));
+		points /= mFanout;
+	}
+	for (int m = 0; m < FS::MetricCount; ++m)
+		init(mFactory[m], m, Factory, 0);
+}
+
+FS::MetricStore::~MetricStore() = default;
+
+bool FS::MetricStore::enableSpill(QString const & fileName)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::unique_ptr<SpillFile> spill(new SpillFile);
+	if (!spill->open(fileName))
+		return false;
+	mSpill = std::move(spill);
+	spillFull();
+	return true;
+}
+
+void FS::MetricStore::setResidentLimit(quint64 bytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mResidentLimit = bytes;
+	spillFull();
+}
+
+quint32 FS::MetricStore::machineCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::size_t n = 0;
+	for (int m = 0; m < FS::MetricCount; ++m)
+		n = std::max(n, mSeries[m].size());
+	return static_cast<quint32>(n);
+}
+
+quint64 FS::MetricStore::sampleCount(FS::Metric metric) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mSamples[static_cast<int>(metric)];
+}
+
+quint64 FS::MetricStore::generation() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mGeneration;
+}
+
+quint64 FS::MetricStore::residentBytes() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mResidentBytes;
+}
+
+quint64 FS::MetricStore::spilledBytes() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mSpilledBytes;
+}
+
+quint64 FS::MetricStore::levelCount(Series const & s, quint32 level) const
+{
+	std::vector<Chunk> const & chunks = s.chunks[level];
+	return chunks.empty() ? 0 : (chunks.size() - 1) * static_cast<quint64>(mChunkPoints[level]) + s.fill[level];
+}
+
+void FS::MetricStore::init(Series & s, int metric, quint32 id, quint64 first) const
+{
+	s = Series();
+	s.metric = static_cast<quint8>(metric);
+	s.id = id;
+	s.first = first;
+	s.chunks.resize(mLevels);
+	s.pending.resize(mLevels);
+	s.fill.assign(mLevels, 0);
+}
+
+void FS::MetricStore::append(FS::Metric metric, std::vector<float> const & values, float factory)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	int const m = static_cast<int>(metric);
+	std::vector<Series> & series = mSeries[m];
+
+	// machines seen for the first time
+	if (series.size() < values.size())
+	{
+		std::size_t const old = series.size();
+		series.resize(values.size());
+		for (std::size_t id = old; id < series.size(); ++id)
+			init(series[id], m, static_cast<quint32>(id), mSamples[m]);
+	}
+
+	for (std::size_t id = 0; id < values.size(); ++id)
+	{
+		push(series[id], 0, values[id], values[id], values[id]);
+		++series[id].count;
+	}
+	push(mFactory[m], 0, factory, factory, factory);
+	++mFactory[m].count;
+	++mSamples[m];
+}
+
+void FS::MetricStore::push(Series & s, quint32 level, float min, float max, float mean)
+{
+	float *p = writable(s, level);
+	if (level == 0)
+	{
+		p[0] = mean;
+	}
+	else
+	{
+		p[0] = min;
+		p[1] = max;
+		p[2] = mean;
+	}
+	++s.fill[level];
+
+	// roll up into the next level
+	if (level + 1 >= mLevels)
+		return;
+	Accumulator & acc = s.pending[level + 1];
+	if (acc.count == 0)
+	{
+		acc.min = min;
+		acc.max = max;
+		acc.sum = 0.0;
+	}
+	else
+	{
+		acc.min = std::min(acc.min, min);
+		acc.max = std::max(acc.max, max);
+	}
+	acc.sum += mean;
+	if (++acc.count == mFanout)
+	{
+		acc.count = 0;
+		push(s, level + 1, acc.min, acc.max, static_cast<float>(acc.sum / mFanout));
+	}
+}
+
+float * FS::MetricStore::writable(Series & s, quint32 level)
+{
+	std::vector<Chunk> & chunks = s.chunks[level];
+	if (chunks.empty() || s.fill[level] == mChunkPoints[level])
+	{
+		if (chunks.empty())
+			mOpenBytes += chunkBytes(level);
+		else
+			mFullChunks.push_back(ChunkRef{ s.metric, static_cast<quint8>(level), s.id, static_cast<quint32>(chunks.size() - 1) });
+		Chunk chunk;
+		chunk.heap.reset(new float[mChunkPoints[level] * stride(level)]);
+		chunk.data = chunk.heap.get();
+		chunks.push_back(std::move(chunk));
+		s.fill[level] = 0;
+		mResidentBytes += chunkBytes(level);
+		spillFull();
+	}
+	return chunks.back().heap.get() + s.fill[level] * stride(level);
+}
+
+void FS::MetricStore::spillFull()
+{
+	// the open chunks are always resident, the full ones count against the limit
+	while (mSpill && !mFullChunks.empty() && mResidentBytes - mOpenBytes > mResidentLimit)
+	{
+		ChunkRef const ref = mFullChunks.front();
+		Series & s = ref.id == Factory ? mFactory[ref.metric] : mSeries[ref.metric][ref.id];
+		Chunk & chunk = s.chunks[ref.level][ref.index];
+		std::size_t const bytes = chunkBytes(ref.level);
+		float *p = mSpill->allocate(bytes);
+		if (!p)
+			return; // kept in memory
+		mFullChunks.pop_front();
+		std::memcpy(p, chunk.heap.get(), bytes);
+		chunk.data = p;
+		chunk.heap.reset();
+		mResidentBytes -= bytes;
+		mSpilledBytes += bytes;
+	}
+}
+
+void FS::MetricStore::query(FS::Metric metric, quint32 id, qreal t0, qreal t1, quint32 maxPoints, std::vector<Point> & out) const
+{
+	out.clear();
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::vector<Series> const & series = mSeries[static_cast<int>(metric)];
+	if ((id != Factory && id >= series.size()) || t1 < t0)
+		return;
+	Series const & s = id == Factory ? mFactory[static_cast<int>(metric)] : series[id];
+
+	// finest level with no more than maxPoints buckets in the range
+	qreal const samples = (t1 - t0) / mInterval;
+	quint32 level = 0;
+	quint64 span = 1;
+	while (level + 1 < mLevels && samples / span > std::max<quint32>(1, maxPoints))
+	{
+		++level;
+		span *= mFanout;
+	}
+
+	// buckets [k0, k1) of the level cover the range
+	qreal const origin = mStart + s.first * mInterval;
+	qreal const bucket = span * mInterval;
+	quint64 const stored = levelCount(s, level);
+	quint64 const k0 = static_cast<quint64>(std::max(0.0, std::floor((t0 - origin) / bucket)));
+	quint64 const k1 = static_cast<quint64>(std::max(0.0, std::floor((t1 - origin) / bucket) + 1.0));
+
+	if (k0 < stored)
+		out.reserve(static_cast<std::size_t>(std::min(k1, stored) - k0 + 1));
+	quint32 const w = stride(level);
+	for (quint64 k = k0; k < std::min(k1, stored); ++k)
+	{
+		float const *p = s.chunks[level][k / mChunkPoints[level]].data + (k % mChunkPoints[level]) * w;
+		Point point;
+		point.time = origin + k * bucket;
+		point.min = p[0];
+		point.max = p[w == 1 ? 0 : 1];
+		point.mean = p[w == 1 ? 0 : 2];
+		out.push_back(point);
+	}
+
+	// incomplete last bucket, merged from the pending points of every finer level
+	if (level == 0 || stored < k0 || stored >= k1)
+		return;
+	Point point;
+	point.time = origin + stored * bucket;
+	double sum = 0.0;
+	quint64 count = 0;
+	quint64 weight = 1;
+	for (quint32 l = 1; l <= level; ++l)
+	{
+		Accumulator const & acc = s.pending[l];
+		if (acc.count > 0)
+		{
+			point.min = count == 0 ? acc.min : std::min(point.min, acc.min);
+			point.max = count == 0 ? acc.max : std::max(point.max, acc.max);
+			sum += acc.sum * weight;
+			count += acc.count * weight;
+		}
+		weight *= mFanout;
+	}
+	if (count == 0)
+		return;
+	point.mean = static_cast<float>(sum / count);
+	out.push_back(point);
+}
+
+void FS::MetricStore::clear(qreal start)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mStart = start;
+	++mGeneration;
+	for (int m = 0; m < FS::MetricCount; ++m)
+	{
+		mSeries[m].clear();
+		init(mFactory[m], m, Factory, 0);
+		mSamples[m] = 0;
+	}
+	mFullChunks.clear();
+	mResidentBytes = 0;
+	mOpenBytes = 0;
+	mSpilledBytes = 0;
+	if (mSpill)
+		mSpill->rewind();
+}
@@ -0,0 +1,156 @@
+#ifndef FS_METRIC_STORE_H
+#define FS_METRIC_STORE_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class QFile;
+
+namespace FS
+{
+	// metrics sampled by the engine for every machine
+	enum class Metric : quint8
+	{
+		Queue,			// parts waiting in front of the machine
+		Throughput,		// parts per minute over the last sample interval
+		Utilisation		// 1 when the machine works, 0 otherwise, rollup means give the utilisation
+	};
+	int const MetricCount{ 3 };
+
+	// Time series of every (metric, machine id), sampled at a fixed interval.
+	// Each series keeps the raw samples and several rollup levels, a point of level k summarises
+	// fanout^k samples by their min, max and mean. A query picks the finest level that fits the
+	// requested number of points, so drawing any time range reads O(pixels) points.
+	// Storage is chunked, a chunk covers about the same time at every level (coarser levels have
+	// fanout times fewer points per chunk). Each series keeps its open chunk of every level in
+	// memory; full chunks are moved, oldest first, to a memory mapped spill file once the store
+	// holds more than its resident limit, leaving the paging to the system.
+	// Appends (engine thread) and queries (GUI thread) may run concurrently.
+	class MetricStore
+	{
+	public:
+		struct Point
+		{
+			qreal time;		// start of the bucket
+			float min;
+			float max;
+			float mean;
+		};
+
+		// id of the factory wide series of each metric
+		static quint32 const Factory{ 0xFFFFFFFF };
+
+		MetricStore(qreal interval, quint32 fanout = 16, quint32 levels = 5);
+		~MetricStore();
+
+		MetricStore(MetricStore const &) = delete;
+		MetricStore& operator=(MetricStore const &) = delete;
+
+		// empty name: temporary file removed with the store
+		bool enableSpill(QString const & fileName = QString());
+		// bytes of full chunks kept in memory when spilling, the open chunks are not counted
+		void setResidentLimit(quint64 bytes);
+
+		// time of the first sample and sampling interval, in simulated seconds
+		qreal start() const { return mStart; }
+		qreal interval() const { return mInterval; }
+		quint32 machineCount() const;
+		quint64 sampleCount(FS::Metric metric) const;
+		// incremented by clear(), readers compare it to notice the series were restarted
+		quint64 generation() const;
+		// bytes held in memory and in the spill file
+		quint64 residentBytes() const;
+		quint64 spilledBytes() const;
+
+		// next sample of a metric for every machine, values indexed by machine id, and for the factory
+		// machines added later start with their first sample
+		void append(FS::Metric metric, std::vector<float> const & values, float factory);
+
+		// points of a series (machine id or Factory) covering [t0, t1], at most about maxPoints
+		void query(FS::Metric metric, quint32 id, qreal t0, qreal t1, quint32 maxPoints, std::vector<Point> & out) const;
+
+		// drops every sample, the next one is taken at start
+		void clear(qreal start = 0.0);
+
+	private:
+		// one chunk of points, stride floats per point (1 for raw samples, 3 for rollups)
+		struct Chunk
+		{
+			std::unique_ptr<float[]> heap;
+			float const *data;
+		};
+
+		struct Accumulator
+		{
+			float min;
+			float max;
+			double sum;
+			quint32 count{ 0 };
+		};
+
+		struct Series
+		{
+			quint8 metric{ 0 };
+			quint32 id{ Factory };
+			// first sample index of the series (machines added during the run)
+			quint64 first{ 0 };
+			quint64 count{ 0 };
+			// chunks of each level, accumulators of the incomplete point of levels 1..
+			std::vector<std::vector<Chunk>> chunks;
+			std::vector<Accumulator> pending;
+			// write position in the last chunk of each level
+			std::vector<quint32> fill;
+		};
+
+		class SpillFile;
+
+		// full chunk waiting in memory to be spilled
+		struct ChunkRef
+		{
+			quint8 metric;
+			quint8 level;
+			quint32 id;
+			quint32 index;
+		};
+
+		// points per chunk of the raw samples, and at least per chunk of a rollup level
+		// (about 1.3 KB of open chunks per series with the default fanout and levels)
+		static quint32 const ChunkPoints{ 128 };
+		static quint32 const MinChunkPoints{ 16 };
+		static quint64 const DefaultResidentLimit{ 64 << 20 };
+
+		quint32 stride(quint32 level) const { return level == 0 ? 1 : 3; }
+		quint64 chunkBytes(quint32 level) const { return mChunkPoints[level] * stride(level) * sizeof(float); }
+		quint64 levelCount(Series const & s, quint32 level) const;
+		void init(Series & s, int metric, quint32 id, quint64 first) const;
+		void push(Series & s, quint32 level, float min, float max, float mean);
+		float * writable(Series & s, quint32 level);
+		void spillFull();
+
+		qreal mStart{ 0.0 };
+		qreal const mInterval;
+		quint32 const mFanout;
+		quint32 const mLevels;
+		std::vector<quint32> mChunkPoints;
+
+		mutable std::mutex mMutex;
+		std::vector<Series> mSeries[FS::MetricCount];
+		Series mFactory[FS::MetricCount];
+		quint64 mSamples[FS::MetricCount];
+		quint64 mGeneration{ 0 };
+		quint64 mResidentBytes{ 0 };
+		quint64 mSpilledBytes{ 0 };
+		// resident bytes of the chunks still filled
+		quint64 mOpenBytes{ 0 };
+		quint64 mResidentLimit{ DefaultResidentLimit };
+		std::deque<ChunkRef> mFullChunks;
+		std::unique_ptr<SpillFile> mSpill;
+	};
+};
+
+#endif // FS_METRIC_STORE_H
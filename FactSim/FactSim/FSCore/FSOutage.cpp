@@ -0,0 +1,58 @@
+#include "FSOutage.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	qreal const Never{ std::numeric_limits<qreal>::infinity() };
+}
+
+bool FS::Calendar::addWindow(qreal start, qreal duration)
+{
+	if (start < 0.0 || duration <= 0.0 || start + duration > period)
+		return false;
+
+	auto const it = std::lower_bound(windows.begin(), windows.end(), start,
+		[](Window const & w, qreal s) { return w.start < s; });
+	if (it != windows.end() && start + duration > it->start)
+		return false;
+	if (it != windows.begin() && (it - 1)->start + (it - 1)->duration > start)
+		return false;
+	windows.insert(it, Window{ start, duration });
+	return true;
+}
+
+bool FS::OutageTimeline::advance(FS::OutageModel const & model, FS::RandomStream const & stream, qreal time)
+{
+	// breakdowns: up time then repair time, two draws per breakdown
+	if (model.mtbf <= 0.0)
+		mFailFrom = mFailUntil = Never;
+	while (mFailUntil <= time)
+	{
+		qreal d[2];
+		stream.exponential(2 * mFailures, 2, 1.0, d);
+		mFailFrom = mFailUntil + d[0] * model.mtbf;
+		mFailUntil = mFailFrom + d[1] * model.mttr;
+		++mFailures;
+	}
+
+	// planned windows, the calendar repeats
+	FS::Calendar const & calendar = model.calendar;
+	if (calendar.isEmpty())
+		mPlannedFrom = mPlannedUntil = Never;
+	while (mPlannedUntil <= time)
+	{
+		quint64 const n = calendar.windows.size();
+		FS::Calendar::Window const & w = calendar.windows[mPlanned % n];
+		mPlannedFrom = (mPlanned / n) * calendar.period + w.start;
+		mPlannedUntil = mPlannedFrom + w.duration;
+		++mPlanned;
+	}
+
+	bool const failed = mFailFrom <= time;
+	bool const planned = mPlannedFrom <= time;
+	mNext = qMin(failed ? mFailUntil : mFailFrom, planned ? mPlannedUntil : mPlannedFrom);
+	mDown = failed || planned;
+	return mDown;
+}
@@ -0,0 +1,69 @@
+#ifndef FS_OUTAGE_H
+#define FS_OUTAGE_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+#include "FSRandom.h"
+
+namespace FS
+{
+	// Planned downtime repeating every period: shifts off, breaks and preventive maintenance.
+	// Windows start at start seconds in the period, they are kept sorted and must not overlap.
+	struct Calendar
+	{
+		struct Window
+		{
+			qreal start;
+			qreal duration;
+		};
+
+		qreal period{ 0.0 };
+		std::vector<Window> windows;
+
+		bool isEmpty() const { return period <= 0.0 || windows.empty(); }
+		// false if a window does not fit in the period or overlaps another one
+		bool addWindow(qreal start, qreal duration);
+	};
+
+	// Outages of a machine: random breakdowns and its calendar, 0 mtbf disables the breakdowns.
+	// Times between failures and repair times are exponential of mean mtbf and mttr, in seconds
+	// of simulated time whether the machine works or not.
+	struct OutageModel
+	{
+		qreal mtbf{ 0.0 };
+		qreal mttr{ 0.0 };
+		FS::Calendar calendar;
+
+		bool isEnabled() const { return mtbf > 0.0 || !calendar.isEmpty(); }
+	};
+
+	// Position of one machine in its outage timeline.
+	// The timeline is only computed up to the next time the machine may go down or up, the
+	// engine keeps that time in an event queue instead of testing the machines at every step.
+	// Breakdowns are drawn from the stream of the machine, so the timeline only depends on the
+	// seed and the time; the cursor is plain data, saved and restored by copy.
+	class OutageTimeline
+	{
+	public:
+		// down at time, and moves next() past it
+		bool advance(FS::OutageModel const & model, FS::RandomStream const & stream, qreal time);
+		// first time the state may change, 0 before the first advance()
+		qreal next() const { return mNext; }
+		bool isDown() const { return mDown; }
+
+	private:
+		// current or next breakdown and planned window, and how many of them were drawn
+		qreal mFailFrom{ 0.0 };
+		qreal mFailUntil{ 0.0 };
+		quint64 mFailures{ 0 };
+		qreal mPlannedFrom{ 0.0 };
+		qreal mPlannedUntil{ 0.0 };
+		quint64 mPlanned{ 0 };
+		qreal mNext{ 0.0 };
+		bool mDown{ false };
+	};
+};
+
+#endif // FS_OUTAGE_H
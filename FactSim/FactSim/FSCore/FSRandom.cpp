@@ -0,0 +1,118 @@
+#include "FSRandom.h"
+
+#include <cmath>
+
+namespace
+{
+	qreal const TwoPi{ 6.283185307179586 };
+
+	// uniform in (0, 1), never 0 so its log is finite
+	inline qreal unit(quint32 word)
+	{
+		return (static_cast<qreal>(word) + 0.5) * (1.0 / 4294967296.0);
+	}
+}
+
+bool FS::Philox::check()
+{
+	// counter, key and output of the kat_vectors file of Random123
+	static quint32 const known[3][10] = {
+		{ 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+			0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+		{ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+			0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd },
+		{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0,
+			0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }
+	};
+	for (quint32 const *k : known)
+	{
+		quint32 out[4];
+		block(k, k + 4, out);
+		for (int i = 0; i < 4; ++i)
+		{
+			if (out[i] != k[6 + i])
+				return false;
+		}
+	}
+	return true;
+}
+
+FS::RandomStream::RandomStream(quint64 seed, quint32 stream)
+	: mKey{ static_cast<quint32>(seed), static_cast<quint32>(seed >> 32) }, mStream{ stream }
+{
+
+}
+
+void FS::RandomStream::uniform(quint64 first, quint32 count, qreal *out) const
+{
+	blocks(first, count, [out](quint32 i, quint32 k, quint32 const w[4]) {
+		out[i] = unit(w[k]);
+	});
+}
+
+void FS::RandomStream::exponential(quint64 first, quint32 count, qreal rate, qreal *out) const
+{
+	qreal const mean = 1.0 / rate;
+	blocks(first, count, [out, mean](quint32 i, quint32 k, quint32 const w[4]) {
+		out[i] = -std::log(unit(w[k])) * mean;
+	});
+}
+
+void FS::RandomStream::erlang(quint64 first, quint32 count, quint32 shape, qreal rate, qreal *out) const
+{
+	// one log per block of four uniforms, their product does not underflow
+	qreal const mean = 1.0 / rate;
+	quint32 const blocks = (qMax<quint32>(1, shape) + 3) / 4;
+	for (quint32 i = 0; i < count; ++i)
+	{
+		qreal sum = 0.0;
+		quint32 left = qMax<quint32>(1, shape);
+		for (quint32 b = 0; b < blocks; ++b, left -= qMin<quint32>(4, left))
+		{
+			quint32 w[4];
+			block(first + i, b, w);
+			qreal product = unit(w[0]);
+			for (quint32 k = 1; k < qMin<quint32>(4, left); ++k)
+				product *= unit(w[k]);
+			sum -= std::log(product);
+		}
+		out[i] = sum * mean;
+	}
+}
+
+void FS::RandomStream::lognormal(quint64 first, quint32 count, qreal mu, qreal sigma, qreal *out) const
+{
+	// Box-Muller, words 0 and 1 give the cosine and sine normals of draws 0 and 1 of the block,
+	// words 2 and 3 those of draws 2 and 3
+	blocks(first, count, [out, mu, sigma](quint32 i, quint32 k, quint32 const w[4]) {
+		quint32 const pair = k & ~1u;
+		qreal const r = std::sqrt(-2.0 * std::log(unit(w[pair])));
+		qreal const a = TwoPi * unit(w[pair + 1]);
+		qreal const z = r * (k & 1u ? std::sin(a) : std::cos(a));
+		out[i] = std::exp(mu + sigma * z);
+	});
+}
+
+void FS::Variation::sample(FS::RandomStream const & stream, quint64 first, quint32 count, qreal *out) const
+{
+	switch (distribution)
+	{
+	case FS::Distribution::Exponential:
+		stream.exponential(first, count, 1.0, out);
+		break;
+	case FS::Distribution::Erlang:
+		stream.erlang(first, count, qMax<quint32>(1, shape), qMax<quint32>(1, shape), out);
+		break;
+	case FS::Distribution::Lognormal:
+	{
+		// mean 1: sigma^2 = ln(1 + cv^2), mu = -sigma^2 / 2
+		qreal const s2 = std::log(1.0 + cv * cv);
+		stream.lognormal(first, count, -0.5 * s2, std::sqrt(s2), out);
+		break;
+	}
+	default:
+		for (quint32 i = 0; i < count; ++i)
+			out[i] = 1.0;
+		break;
+	}
+}
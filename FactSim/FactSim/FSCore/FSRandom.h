@@ -0,0 +1,122 @@
+#ifndef FS_RANDOM_H
+#define FS_RANDOM_H
+
+#include <QtGlobal>
+
+namespace FS
+{
+	// Philox4x32-10 counter based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+	// A block of four words is a pure function of a 128-bit counter and a 64-bit key,
+	// no state is carried from one block to the next.
+	class Philox
+	{
+	public:
+		// the known answers of the Random123 reference implementation, false if one differs
+		static bool check();
+
+		static void block(quint32 const counter[4], quint32 const key[2], quint32 out[4])
+		{
+			quint32 c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+			quint32 k0 = key[0], k1 = key[1];
+			for (int r = 0; r < 10; ++r)
+			{
+				quint64 const p0 = static_cast<quint64>(0xD2511F53u) * c0;
+				quint64 const p1 = static_cast<quint64>(0xCD9E8D57u) * c2;
+				quint32 const hi0 = static_cast<quint32>(p0 >> 32), lo0 = static_cast<quint32>(p0);
+				quint32 const hi1 = static_cast<quint32>(p1 >> 32), lo1 = static_cast<quint32>(p1);
+				c0 = hi1 ^ c1 ^ k0;
+				c1 = lo1;
+				c2 = hi0 ^ c3 ^ k1;
+				c3 = lo0;
+				k0 += 0x9E3779B9u;
+				k1 += 0xBB67AE85u;
+			}
+			out[0] = c0;
+			out[1] = c1;
+			out[2] = c2;
+			out[3] = c3;
+		}
+	};
+
+	// Random draws of one machine in one run, keyed by (run seed, machine id, draw index).
+	// Draw n of a stream is the same whatever the thread, the batch it is drawn in and the draws
+	// made before it, so machines stepped by different threads and replays from a checkpoint see
+	// the same values. The caller keeps the index of its next draw.
+	// The batches fill out[i] with draw first + i. A block of four words gives four uniform or
+	// exponential draws (draw n is word n % 4 of block n / 4), or two Box-Muller pairs.
+	class RandomStream
+	{
+	public:
+		RandomStream(quint64 seed, quint32 stream);
+
+		// uniform in (0, 1)
+		void uniform(quint64 first, quint32 count, qreal *out) const;
+		// exponential of the given rate
+		void exponential(quint64 first, quint32 count, qreal rate, qreal *out) const;
+		// sum of shape exponentials of the given rate
+		void erlang(quint64 first, quint32 count, quint32 shape, qreal rate, qreal *out) const;
+		// exp of a normal of mean mu and standard deviation sigma
+		void lognormal(quint64 first, quint32 count, qreal mu, qreal sigma, qreal *out) const;
+
+	private:
+		// words of block n, several blocks per draw are told apart by part
+		void block(quint64 n, quint32 part, quint32 out[4]) const
+		{
+			quint32 const counter[4] = { static_cast<quint32>(n), static_cast<quint32>(n >> 32), mStream, part };
+			FS::Philox::block(counter, mKey, out);
+		}
+
+		// f(i, n % 4, words) for the draws n = first + i, words holds block n / 4
+		template <typename F>
+		void blocks(quint64 first, quint32 count, F f) const
+		{
+			quint32 w[4];
+			quint64 loaded = ~0ULL;
+			for (quint32 i = 0; i < count; ++i)
+			{
+				quint64 const n = first + i;
+				if (n / 4 != loaded)
+				{
+					loaded = n / 4;
+					block(loaded, 0, w);
+				}
+				f(i, n % 4, w);
+			}
+		}
+
+		quint32 mKey[2];
+		quint32 mStream;
+	};
+
+	enum class Distribution : quint8
+	{
+		Fixed,			// every operation takes its mean time
+		Exponential,	// coefficient of variation 1
+		Erlang,			// coefficient of variation 1 / sqrt(shape)
+		Lognormal		// coefficient of variation cv
+	};
+	int const DistributionCount{ 4 };
+
+	// lower case names used by the layout files
+	inline char const * distributionName(FS::Distribution distribution)
+	{
+		static char const * const names[DistributionCount] = { "fixed", "exponential", "erlang", "lognormal" };
+		return names[static_cast<int>(distribution)];
+	}
+
+	// Spread of the operation times of a station, as factors of mean 1 applied to the recipe time.
+	struct Variation
+	{
+		FS::Distribution distribution{ FS::Distribution::Fixed };
+		// erlang only
+		quint32 shape{ 1 };
+		// lognormal only
+		qreal cv{ 0.0 };
+
+		bool isFixed() const { return distribution == FS::Distribution::Fixed; }
+		// factors of the draws first .. first + count - 1 of the stream
+		void sample(FS::RandomStream const & stream, quint64 first, quint32 count, qreal *out) const;
+	};
+};
+
+#endif // FS_RANDOM_H
@@ -0,0 +1,74 @@
+#include "FSRecipeBook.h"
+
+quint32 const FS::RecipeBook::NoProduct;
+
+FS::RecipeTable::RecipeTable(quint32 productCount)
+	: mProductCount{ qMax<quint32>(1, productCount) }
+{
+	// every pair passes its part through
+	mEntries.resize(static_cast<std::size_t>(FS::MachineKindCount) * mProductCount);
+	for (int k = 0; k < FS::MachineKindCount; ++k)
+	{
+		for (quint32 p = 0; p < mProductCount; ++p)
+			mEntries[k * mProductCount + p] = Entry{ p, 1, 1.0 };
+	}
+}
+
+void FS::RecipeTable::set(FS::Recipe const & recipe)
+{
+	if (recipe.input >= mProductCount || recipe.output >= mProductCount || recipe.time <= 0.0)
+		return;
+	mEntries[static_cast<int>(recipe.kind) * mProductCount + recipe.input] =
+		Entry{ recipe.output, qMax<quint32>(1, recipe.outputCount), 1.0 / recipe.time };
+}
+
+quint32 FS::RecipeBook::addProduct(QString const & name)
+{
+	quint32 const handle = FS::StringPool::instance().intern(name);
+	auto const it = mIds.constFind(handle);
+	if (it != mIds.constEnd())
+		return it.value();
+
+	quint32 const id = productCount();
+	mNames.push_back(handle);
+	mIds.insert(handle, id);
+	return id;
+}
+
+quint32 FS::RecipeBook::product(QString const & name) const
+{
+	quint32 const handle = FS::StringPool::instance().find(name);
+	return handle == FS::StringPool::NoString ? NoProduct : mIds.value(handle, NoProduct);
+}
+
+bool FS::RecipeBook::addRecipe(FS::Recipe const & recipe)
+{
+	if (recipe.input >= productCount() || recipe.output >= productCount() || recipe.outputCount == 0 || recipe.time <= 0.0)
+		return false;
+
+	for (FS::Recipe &r : mRecipes)
+	{
+		if (r.kind == recipe.kind && r.input == recipe.input)
+		{
+			r = recipe;
+			return true;
+		}
+	}
+	mRecipes.push_back(recipe);
+	return true;
+}
+
+void FS::RecipeBook::clear()
+{
+	mNames.clear();
+	mIds.clear();
+	mRecipes.clear();
+}
+
+FS::RecipeTable FS::RecipeBook::compile() const
+{
+	FS::RecipeTable table(productCount());
+	for (FS::Recipe const & r : mRecipes)
+		table.set(r);
+	return table;
+}
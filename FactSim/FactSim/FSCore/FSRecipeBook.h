@@ -0,0 +1,89 @@
+#ifndef FS_RECIPE_BOOK_H
+#define FS_RECIPE_BOOK_H
+
+#include <QHash>
+#include <QString>
+
+#include <vector>
+
+#include "FSMachineKind.h"
+#include "FSStringPool.h"
+
+namespace FS
+{
+	// What the stations of one kind do with one input product: each part of input is turned
+	// into outputCount parts of output. The time is in seconds for a station running at
+	// 60 parts per minute, faster or slower stations scale it.
+	struct Recipe
+	{
+		FS::MachineKind kind{ FS::MachineKind::Transform };
+		quint32 input{ 0 };
+		quint32 output{ 0 };
+		quint32 outputCount{ 1 };
+		qreal time{ 1.0 };
+		// handle in FS::StringPool::instance()
+		quint32 label{ FS::StringPool::Empty };
+	};
+
+	// Recipes compiled into one flat table, indexed by (machine kind, product).
+	// A station resolves what it does with a part with one array access, whatever the number of
+	// products. Pairs without recipe pass the part through in one second at 60 parts per minute,
+	// so a table without recipe keeps the plain station behaviour.
+	class RecipeTable
+	{
+	public:
+		struct Entry
+		{
+			quint32 output;
+			quint32 outputCount;
+			// 1 / time, progress made per second at 60 parts per minute
+			qreal pace;
+		};
+
+		// one product, no recipe
+		RecipeTable() : RecipeTable(1) {}
+		explicit RecipeTable(quint32 productCount);
+
+		quint32 productCount() const { return mProductCount; }
+		// product must be below productCount()
+		Entry const & entry(FS::MachineKind kind, quint32 product) const { return mEntries[static_cast<int>(kind) * mProductCount + product]; }
+
+		void set(FS::Recipe const & recipe);
+
+	private:
+		quint32 mProductCount;
+		std::vector<Entry> mEntries;
+	};
+
+	// Named products and the recipes of a plant, as edited and stored in the layouts.
+	// Product ids are dense and given in the order the products are added.
+	class RecipeBook
+	{
+	public:
+		static quint32 const NoProduct{ 0xFFFFFFFF };
+
+		// id of the product, added if the name is new
+		quint32 addProduct(QString const & name);
+		// NoProduct if unknown
+		quint32 product(QString const & name) const;
+		QString const & productName(quint32 product) const { return FS::StringPool::instance().string(mNames[product]); }
+		quint32 productCount() const { return static_cast<quint32>(mNames.size()); }
+
+		// false if a product is unknown, the count is 0 or the time is not positive;
+		// a later recipe for the same kind and input replaces the former
+		bool addRecipe(FS::Recipe const & recipe);
+		std::vector<FS::Recipe> const & recipes() const { return mRecipes; }
+
+		void clear();
+		// at least one product, so the default product 0 always exists
+		FS::RecipeTable compile() const;
+
+	private:
+		// name handles, and products by name handle
+		std::vector<quint32> mNames;
+		QHash<quint32, quint32> mIds;
+		std::vector<FS::Recipe> mRecipes;
+	};
+};
+
+#endif // FS_RECIPE_BOOK_H
@@ -0,0 +1,201 @@
+#include "FSReservationTable.h"
+
+#include <algorithm>
+#include <cmath>
+
+quint32 const FS::ReservationTable::NoVehicle;
+quint32 const FS::ReservationTable::TooLong;
+
+FS::ReservationTable::ReservationTable(qreal slotDuration, quint32 horizon)
+	: mSlotDuration{ slotDuration }
+	, mHorizon{ qMax<quint32>(1, horizon) }
+{
+}
+
+void FS::ReservationTable::resize(quint32 resources)
+{
+	mResources = resources;
+	mCells.resize(static_cast<std::size_t>(resources) * mHorizon);
+}
+
+void FS::ReservationTable::clear()
+{
+	std::fill(mCells.begin(), mCells.end(), Cell());
+	mWaitsFor.clear();
+	mWaiting.clear();
+	mListed.clear();
+}
+
+void FS::ReservationTable::setHorizon(quint32 horizon)
+{
+	if (horizon <= mHorizon)
+		return;
+
+	// two slots on different cells of the old ring differ modulo the old horizon, so they
+	// still do modulo any multiple of it
+	quint64 const multiple = (static_cast<quint64>(horizon) + mHorizon - 1) / mHorizon * mHorizon;
+	if (multiple > 0xFFFFFFFF)
+		return;
+	horizon = static_cast<quint32>(multiple);
+	std::vector<Cell> cells(static_cast<std::size_t>(mResources) * horizon);
+	for (quint32 r = 0; r < mResources; ++r)
+	{
+		for (quint32 i = 0; i < mHorizon; ++i)
+		{
+			Cell const & c = mCells[static_cast<std::size_t>(r) * mHorizon + i];
+			if (c.vehicle != NoVehicle)
+				cells[static_cast<std::size_t>(r) * horizon + c.slot % horizon] = c;
+		}
+	}
+	mCells.swap(cells);
+	mHorizon = horizon;
+}
+
+quint64 FS::ReservationTable::slot(qreal time) const
+{
+	return time > 0.0 ? static_cast<quint64>(time / mSlotDuration) : 0;
+}
+
+quint64 FS::ReservationTable::slotCount(qreal t0, qreal t1) const
+{
+	quint64 const s0 = slot(t0);
+	return qMax(s0 + 1, static_cast<quint64>(std::ceil(qMax<qreal>(t1, 0.0) / mSlotDuration))) - s0;
+}
+
+bool FS::ReservationTable::range(qreal t0, qreal t1, quint64 & s0, quint64 & s1) const
+{
+	s0 = slot(t0);
+	s1 = s0 + slotCount(t0, t1);
+	if (s1 - s0 <= mHorizon)
+		return true;
+	s1 = s0 + mHorizon;
+	return false;
+}
+
+quint32 FS::ReservationTable::holder(quint32 resource, qreal time) const
+{
+	quint64 const s = slot(time);
+	Cell const & c = cell(resource, s);
+	return c.slot == s ? c.vehicle : NoVehicle;
+}
+
+bool FS::ReservationTable::isFree(quint32 resource, qreal t0, qreal t1, quint32 vehicle) const
+{
+	quint64 s0, s1;
+	if (!range(t0, t1, s0, s1))
+		return false;
+	for (quint64 s = s0; s < s1; ++s)
+	{
+		Cell const & c = cell(resource, s);
+		// an older stamp is a stale entry, a newer one a reservation further ahead
+		if (c.vehicle != NoVehicle && c.slot == s && c.vehicle != vehicle)
+			return false;
+	}
+	return true;
+}
+
+quint32 FS::ReservationTable::reserve(quint32 resource, qreal t0, qreal t1, quint32 vehicle)
+{
+	quint64 s0, s1;
+	if (!range(t0, t1, s0, s1))
+		return TooLong;
+	quint64 s = s0;
+	while (s < s1)
+	{
+		Cell const & c = cell(resource, s);
+		if (c.vehicle != NoVehicle && c.slot == s && c.vehicle != vehicle)
+			return c.vehicle;
+		if (c.vehicle == NoVehicle || c.slot <= s)
+		{
+			++s;
+			continue;
+		}
+		// a reservation a horizon or more ahead shares the cell, whoever holds it: the ring
+		// is too short, the slot is not taken
+		if (mHorizon > 0x7FFFFFFF)
+			return TooLong;
+		setHorizon(mHorizon * 2);
+		s = s0;
+	}
+	for (quint64 s = s0; s < s1; ++s)
+	{
+		Cell & c = cell(resource, s);
+		c.slot = s;
+		c.vehicle = vehicle;
+	}
+	return NoVehicle;
+}
+
+void FS::ReservationTable::release(quint32 resource, qreal t0, qreal t1, quint32 vehicle)
+{
+	// no reservation spans more than the horizon
+	quint64 s0, s1;
+	range(t0, t1, s0, s1);
+	for (quint64 s = s0; s < s1; ++s)
+	{
+		Cell & c = cell(resource, s);
+		if (c.slot == s && c.vehicle == vehicle)
+			c.vehicle = NoVehicle;
+	}
+}
+
+void FS::ReservationTable::setWaiting(quint32 vehicle, quint32 blocker)
+{
+	if (vehicle >= mWaitsFor.size())
+	{
+		if (blocker == NoVehicle)
+			return;
+		mWaitsFor.resize(vehicle + 1, NoVehicle);
+	}
+	if (mListed.size() < mWaitsFor.size())
+		mListed.resize(mWaitsFor.size(), 0);
+	if (blocker != NoVehicle && !mListed[vehicle])
+	{
+		mListed[vehicle] = 1;
+		mWaiting.push_back(vehicle);
+	}
+	mWaitsFor[vehicle] = blocker;
+}
+
+quint32 FS::ReservationTable::findDeadlocks(std::vector<std::vector<quint32>> & cycles)
+{
+	cycles.clear();
+
+	// forget the vehicles no longer waiting
+	std::size_t kept = 0;
+	for (quint32 v : mWaiting)
+	{
+		if (mWaitsFor[v] != NoVehicle)
+			mWaiting[kept++] = v;
+		else
+			mListed[v] = 0;
+	}
+	mWaiting.resize(kept);
+
+	// follow the waits from every waiting vehicle, each vehicle is visited once:
+	// reaching a vehicle of the current walk closes a cycle
+	mVisit.assign(mWaitsFor.size(), 0);
+	quint32 walk = 0;
+	for (quint32 start : mWaiting)
+	{
+		if (mVisit[start])
+			continue;
+		++walk;
+		quint32 v = start;
+		while (v != NoVehicle && v < mWaitsFor.size() && !mVisit[v])
+		{
+			mVisit[v] = walk;
+			v = mWaitsFor[v];
+		}
+		if (v == NoVehicle || v >= mWaitsFor.size() || mVisit[v] != walk)
+			continue;
+		cycles.emplace_back();
+		quint32 u = v;
+		do
+		{
+			cycles.back().push_back(u);
+			u = mWaitsFor[u];
+		} while (u != v);
+	}
+	return static_cast<quint32>(cycles.size());
+}
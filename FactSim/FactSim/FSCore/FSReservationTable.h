@@ -0,0 +1,85 @@
+#ifndef FS_RESERVATION_TABLE_H
+#define FS_RESERVATION_TABLE_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+namespace FS
+{
+	// Space-time reservations of the aisle segments shared by the vehicles.
+	// Time is cut in slots, every resource (a segment of the discretised aisle graph) owns a ring
+	// of horizon slots holding the vehicle that reserved it, stamped with the absolute slot.
+	// Checking or reserving a slot is one array access, stale entries are recognised by their
+	// stamp so nothing is ever purged. Windows longer than the horizon are refused, the horizon
+	// can be grown without losing the reservations; reserve() grows it by itself when a cell it
+	// needs holds a reservation a horizon or more ahead.
+	//
+	// Vehicles refused a reservation wait for its holder. Each vehicle waits for at most one
+	// other, so the wait-for graph is a functional graph and its cycles (deadlocks) are found
+	// in one pass over the waiting vehicles.
+	class ReservationTable
+	{
+	public:
+		static quint32 const NoVehicle{ 0xFFFFFFFF };
+		// reserve() result for a window longer than the horizon
+		static quint32 const TooLong{ 0xFFFFFFFE };
+
+		ReservationTable(qreal slotDuration = 0.25, quint32 horizon = 256);
+		~ReservationTable() = default;
+
+		void resize(quint32 resources);
+		void clear();
+		quint32 resourceCount() const { return mResources; }
+		qreal slotDuration() const { return mSlotDuration; }
+		quint32 horizon() const { return mHorizon; }
+		// a larger ring for every resource, rounded up to a multiple of the current horizon so
+		// every reservation keeps a cell of its own
+		void setHorizon(quint32 horizon);
+		quint64 slot(qreal time) const;
+		// slots covered by [t0, t1), at least one
+		quint64 slotCount(qreal t0, qreal t1) const;
+
+		// vehicle holding the resource at time, NoVehicle if free
+		quint32 holder(quint32 resource, qreal time) const;
+		// free, or already held by vehicle, during [t0, t1), false if longer than the horizon
+		bool isFree(quint32 resource, qreal t0, qreal t1, quint32 vehicle = NoVehicle) const;
+		// all or nothing, NoVehicle on success, TooLong if the window does not fit in the
+		// horizon, else a vehicle holding part of the window
+		quint32 reserve(quint32 resource, qreal t0, qreal t1, quint32 vehicle);
+		// drops the slots of [t0, t1) held by vehicle
+		void release(quint32 resource, qreal t0, qreal t1, quint32 vehicle);
+
+		// wait-for graph, NoVehicle as blocker clears the wait
+		void setWaiting(quint32 vehicle, quint32 blocker);
+		quint32 waitingFor(quint32 vehicle) const { return vehicle < mWaitsFor.size() ? mWaitsFor[vehicle] : NoVehicle; }
+		// cycles of the wait-for graph, each in wait order, returns their number
+		quint32 findDeadlocks(std::vector<std::vector<quint32>> & cycles);
+
+	private:
+		struct Cell
+		{
+			quint64 slot{ 0 };
+			quint32 vehicle{ NoVehicle };
+		};
+
+		// slot range of [t0, t1), at least one slot and at most the horizon, false if cut
+		bool range(qreal t0, qreal t1, quint64 & s0, quint64 & s1) const;
+		Cell & cell(quint32 resource, quint64 s) { return mCells[static_cast<std::size_t>(resource) * mHorizon + s % mHorizon]; }
+		Cell const & cell(quint32 resource, quint64 s) const { return mCells[static_cast<std::size_t>(resource) * mHorizon + s % mHorizon]; }
+
+		qreal const mSlotDuration;
+		quint32 mHorizon;
+		quint32 mResources{ 0 };
+		std::vector<Cell> mCells;
+
+		// wait-for graph, indexed by vehicle
+		std::vector<quint32> mWaitsFor;
+		std::vector<quint32> mVisit;
+		std::vector<quint32> mWaiting;
+		// vehicles in mWaiting, a vehicle waiting again before the compaction is listed once
+		std::vector<char> mListed;
+	};
+};
+
+#endif // FS_RESERVATION_TABLE_H
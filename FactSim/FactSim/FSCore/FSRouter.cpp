@@ -0,0 +1,238 @@
+#include "FSRouter.h"
+
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace
+{
+	qreal const Unreachable{ std::numeric_limits<qreal>::infinity() };
+
+	// negative lengths would break the shortest path trees, NaN fails the test too
+	bool isLength(qreal length)
+	{
+		return length >= 0.0 && length < Unreachable;
+	}
+
+	typedef std::pair<qreal, quint32> Entry;
+	typedef std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> MinQueue;
+}
+
+quint32 const FS::Router::NoNode;
+quint32 const FS::Router::NoEdge;
+
+quint32 FS::Router::addNode(qreal x, qreal y)
+{
+	mX.push_back(x);
+	mY.push_back(y);
+	mIn.emplace_back();
+	mOut.emplace_back();
+	// the cached trees gain an unreachable node, the new node's own tree is built on demand
+	for (Tree & t : mTrees)
+	{
+		if (!t.valid)
+			continue;
+		t.distance.push_back(Unreachable);
+		t.next.push_back(NoEdge);
+	}
+	mTrees.emplace_back();
+	return static_cast<quint32>(mX.size() - 1);
+}
+
+quint32 FS::Router::addEdge(quint32 from, quint32 to, qreal length)
+{
+	if (from >= nodeCount() || to >= nodeCount() || !isLength(length))
+		return NoEdge;
+
+	quint32 const edge = static_cast<quint32>(mFrom.size());
+	mFrom.push_back(from);
+	mTo.push_back(to);
+	mLength.push_back(length);
+	mBlocked.push_back(false);
+	mIn[to].push_back(edge);
+	mOut[from].push_back(edge);
+
+	for (Tree & t : mTrees)
+	{
+		if (t.valid)
+			improve(t, edge);
+	}
+	return edge;
+}
+
+void FS::Router::setBlocked(quint32 edge, bool blocked)
+{
+	if (mBlocked[edge] == blocked)
+		return;
+	mBlocked[edge] = blocked;
+	if (blocked)
+	{
+		invalidate(edge);
+		return;
+	}
+	for (Tree & t : mTrees)
+	{
+		if (t.valid)
+			improve(t, edge);
+	}
+}
+
+bool FS::Router::setLength(quint32 edge, qreal length)
+{
+	if (edge >= edgeCount() || !isLength(length))
+		return false;
+
+	qreal const old = mLength[edge];
+	mLength[edge] = length;
+	if (mBlocked[edge] || length == old)
+		return true;
+	if (length > old)
+	{
+		invalidate(edge);
+		return true;
+	}
+	for (Tree & t : mTrees)
+	{
+		if (t.valid)
+			improve(t, edge);
+	}
+	return true;
+}
+
+void FS::Router::clear()
+{
+	mX.clear();
+	mY.clear();
+	mIn.clear();
+	mOut.clear();
+	mFrom.clear();
+	mTo.clear();
+	mLength.clear();
+	mBlocked.clear();
+	mTrees.clear();
+}
+
+qreal FS::Router::cost(quint32 edge) const
+{
+	return mBlocked[edge] ? Unreachable : mLength[edge];
+}
+
+void FS::Router::precompute()
+{
+	for (quint32 d = 0; d < nodeCount(); ++d)
+	{
+		if (!mTrees[d].valid)
+			build(d);
+	}
+}
+
+FS::Router::Tree & FS::Router::tree(quint32 destination)
+{
+	if (!mTrees[destination].valid)
+		build(destination);
+	return mTrees[destination];
+}
+
+void FS::Router::build(quint32 destination)
+{
+	// Dijkstra from the destination over the reversed edges
+	Tree & t = mTrees[destination];
+	t.distance.assign(nodeCount(), Unreachable);
+	t.next.assign(nodeCount(), NoEdge);
+	t.distance[destination] = 0.0;
+
+	MinQueue queue;
+	queue.push(Entry(0.0, destination));
+	while (!queue.empty())
+	{
+		Entry const e = queue.top();
+		queue.pop();
+		quint32 const node = e.second;
+		if (e.first > t.distance[node])
+			continue;
+		for (quint32 edge : mIn[node])
+		{
+			qreal const d = e.first + cost(edge);
+			quint32 const prev = mFrom[edge];
+			if (d < t.distance[prev])
+			{
+				t.distance[prev] = d;
+				t.next[prev] = edge;
+				queue.push(Entry(d, prev));
+			}
+		}
+	}
+
+	t.valid = true;
+	++mTreesBuilt;
+}
+
+void FS::Router::improve(Tree & t, quint32 edge)
+{
+	// only the nodes now closer through edge are visited
+	qreal const d = t.distance[mTo[edge]] + cost(edge);
+	quint32 const start = mFrom[edge];
+	if (!(d < t.distance[start]))
+		return;
+	t.distance[start] = d;
+	t.next[start] = edge;
+
+	MinQueue queue;
+	queue.push(Entry(d, start));
+	while (!queue.empty())
+	{
+		Entry const e = queue.top();
+		queue.pop();
+		quint32 const node = e.second;
+		if (e.first > t.distance[node])
+			continue;
+		for (quint32 in : mIn[node])
+		{
+			qreal const dn = e.first + cost(in);
+			quint32 const prev = mFrom[in];
+			if (dn < t.distance[prev])
+			{
+				t.distance[prev] = dn;
+				t.next[prev] = in;
+				queue.push(Entry(dn, prev));
+			}
+		}
+	}
+}
+
+void FS::Router::invalidate(quint32 edge)
+{
+	// only the trees routing through edge may change
+	quint32 const from = mFrom[edge];
+	for (Tree & t : mTrees)
+	{
+		if (t.valid && t.next[from] == edge)
+		{
+			t.valid = false;
+			t.distance.clear();
+			t.next.clear();
+		}
+	}
+}
+
+qreal FS::Router::distance(quint32 from, quint32 to)
+{
+	return tree(to).distance[from];
+}
+
+quint32 FS::Router::nextEdge(quint32 from, quint32 to)
+{
+	return tree(to).next[from];
+}
+
+bool FS::Router::route(quint32 from, quint32 to, std::vector<quint32> & edges)
+{
+	edges.clear();
+	Tree const & t = tree(to);
+	if (t.distance[from] == Unreachable)
+		return false;
+	for (quint32 node = from; node != to; node = mTo[t.next[node]])
+		edges.push_back(t.next[node]);
+	return true;
+}
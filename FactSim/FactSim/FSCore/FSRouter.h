@@ -0,0 +1,90 @@
+#ifndef FS_ROUTER_H
+#define FS_ROUTER_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+namespace FS
+{
+	// Shortest routes over the transport graph (aisles, conveyor network) for the vehicles.
+	// Nodes are junctions, edges are directed segments, a two way aisle is two edges.
+	// One shortest path tree is cached per destination: for every node the distance to the
+	// destination and the first edge to take. A route is read by following the first edges,
+	// O(path length) without any search.
+	// Edits keep the trees up to date incrementally: a shorter or new segment only propagates
+	// to the nodes it improves, a longer or blocked segment drops the trees that used it,
+	// they are rebuilt by the next precompute() or the next query to their destination.
+	class Router
+	{
+	public:
+		static quint32 const NoNode{ 0xFFFFFFFF };
+		static quint32 const NoEdge{ 0xFFFFFFFF };
+
+		Router() = default;
+		~Router() = default;
+
+		quint32 addNode(qreal x, qreal y);
+		// NoEdge if a node does not exist or the length is negative or not finite
+		quint32 addEdge(quint32 from, quint32 to, qreal length);
+		// a blocked segment is kept but never routed through
+		void setBlocked(quint32 edge, bool blocked);
+		// false, and nothing changed, if the edge does not exist or the length is invalid
+		bool setLength(quint32 edge, qreal length);
+		void clear();
+
+		quint32 nodeCount() const { return static_cast<quint32>(mX.size()); }
+		quint32 edgeCount() const { return static_cast<quint32>(mFrom.size()); }
+		qreal x(quint32 node) const { return mX[node]; }
+		qreal y(quint32 node) const { return mY[node]; }
+		quint32 from(quint32 edge) const { return mFrom[edge]; }
+		quint32 to(quint32 edge) const { return mTo[edge]; }
+		qreal length(quint32 edge) const { return mLength[edge]; }
+		bool isBlocked(quint32 edge) const { return mBlocked[edge]; }
+		std::vector<quint32> const & outEdges(quint32 node) const { return mOut[node]; }
+
+		// builds every missing tree, to keep the searches off the tick
+		void precompute();
+		// trees built from scratch since the creation, for statistics
+		quint64 treesBuilt() const { return mTreesBuilt; }
+
+		// infinity if to cannot be reached
+		qreal distance(quint32 from, quint32 to);
+		// first edge of the route, NoEdge if unreachable or from == to
+		quint32 nextEdge(quint32 from, quint32 to);
+		// edges of the route, false if unreachable
+		bool route(quint32 from, quint32 to, std::vector<quint32> & edges);
+
+	private:
+		// distances and first edges toward one destination, indexed by node
+		struct Tree
+		{
+			bool valid{ false };
+			std::vector<qreal> distance;
+			std::vector<quint32> next;
+		};
+
+		qreal cost(quint32 edge) const;
+		Tree & tree(quint32 destination);
+		void build(quint32 destination);
+		void improve(Tree & t, quint32 edge);
+		void invalidate(quint32 edge);
+
+		// nodes
+		std::vector<qreal> mX;
+		std::vector<qreal> mY;
+		std::vector<std::vector<quint32>> mIn;
+		std::vector<std::vector<quint32>> mOut;
+
+		// edges
+		std::vector<quint32> mFrom;
+		std::vector<quint32> mTo;
+		std::vector<qreal> mLength;
+		std::vector<bool> mBlocked;
+
+		std::vector<Tree> mTrees;
+		quint64 mTreesBuilt{ 0 };
+	};
+};
+
+#endif // FS_ROUTER_H
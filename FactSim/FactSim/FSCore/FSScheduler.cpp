@@ -0,0 +1,266 @@
+#include "FSScheduler.h"
+
+#include <algorithm>
+
+namespace
+{
+	qint64 const InitialDequeSize{ 256 };
+	// failed searches before a worker goes to sleep
+	int const SpinRounds{ 64 };
+
+	// worker running on this thread and its scheduler
+	thread_local void const *tScheduler{ nullptr };
+	thread_local void *tWorker{ nullptr };
+}
+
+FS::Scheduler::Deque::Deque()
+{
+	mArrays.emplace_back(new Array(InitialDequeSize));
+	mArray.store(mArrays.back().get(), std::memory_order_relaxed);
+}
+
+FS::Scheduler::Deque::~Deque() = default;
+
+void FS::Scheduler::Deque::push(Task *task)
+{
+	qint64 const b = mBottom.load(std::memory_order_relaxed);
+	qint64 const t = mTop.load(std::memory_order_acquire);
+	Array *a = mArray.load(std::memory_order_relaxed);
+	if (b - t > a->mask)
+	{
+		// full, the owner alone grows the array
+		mArrays.emplace_back(new Array(2 * (a->mask + 1)));
+		Array *grown = mArrays.back().get();
+		for (qint64 i = t; i < b; ++i)
+			grown->put(i, a->get(i));
+		mArray.store(grown, std::memory_order_release);
+		a = grown;
+	}
+	a->put(b, task);
+	mBottom.store(b + 1, std::memory_order_release);
+}
+
+FS::Scheduler::Task* FS::Scheduler::Deque::take()
+{
+	qint64 const b = mBottom.load(std::memory_order_relaxed) - 1;
+	Array *a = mArray.load(std::memory_order_relaxed);
+	mBottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	qint64 t = mTop.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// empty
+		mBottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Task *task = a->get(b);
+	if (t == b)
+	{
+		// last task, race the thieves for it
+		if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			task = nullptr;
+		mBottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return task;
+}
+
+FS::Scheduler::Task* FS::Scheduler::Deque::steal()
+{
+	qint64 t = mTop.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	qint64 const b = mBottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return nullptr;
+
+	Array *a = mArray.load(std::memory_order_acquire);
+	Task *task = a->get(t);
+	if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr; // another thief or the owner got it
+	return task;
+}
+
+FS::Scheduler::Scheduler(quint32 workers)
+{
+	if (workers == 0)
+		workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	mSampledAt = std::chrono::steady_clock::now();
+	for (quint32 i = 0; i < workers; ++i)
+	{
+		mWorkers.emplace_back(new Worker);
+		mWorkers.back()->seed = 2654435761u * (i + 1);
+	}
+	// started once every deque exists, workers steal from each other
+	for (quint32 i = 0; i < workers; ++i)
+		mWorkers[i]->thread = std::thread(&FS::Scheduler::workerLoop, this, i);
+}
+
+FS::Scheduler::~Scheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mStop.store(true);
+	}
+	mWake.notify_all();
+	for (std::unique_ptr<Worker> &w : mWorkers)
+		w->thread.join();
+}
+
+FS::Scheduler & FS::Scheduler::instance()
+{
+	static Scheduler scheduler;
+	return scheduler;
+}
+
+FS::Scheduler::Worker* FS::Scheduler::current() const
+{
+	return tScheduler == this ? static_cast<Worker*>(tWorker) : nullptr;
+}
+
+void FS::Scheduler::spawn(Task *task)
+{
+	if (mWorkers.empty())
+	{
+		// nobody to hand it to
+		execute(task);
+		return;
+	}
+
+	Worker *self = current();
+	if (self)
+	{
+		self->deque.push(task);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(mInjectionMutex);
+		mInjection.push_back(task);
+	}
+
+	// a sleeping worker either sees the count or is woken, both are sequentially consistent
+	mQueued.fetch_add(1);
+	if (mSleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mWake.notify_one();
+	}
+}
+
+FS::Scheduler::Task* FS::Scheduler::find(Worker *self)
+{
+	Task *task = self ? self->deque.take() : nullptr;
+
+	if (!task && mQueued.load(std::memory_order_relaxed) > 0)
+	{
+		std::lock_guard<std::mutex> lock(mInjectionMutex);
+		if (!mInjection.empty())
+		{
+			task = mInjection.front();
+			mInjection.pop_front();
+		}
+	}
+
+	if (!task)
+	{
+		// one round over the victims, from a random one
+		quint32 const n = workerCount();
+		quint32 start = 0;
+		if (self)
+		{
+			self->seed ^= self->seed << 13;
+			self->seed ^= self->seed >> 17;
+			self->seed ^= self->seed << 5;
+			start = self->seed % n;
+		}
+		for (quint32 k = 0; k < n && !task; ++k)
+		{
+			Worker *victim = mWorkers[start + k < n ? start + k : start + k - n].get();
+			if (victim != self)
+				task = victim->deque.steal();
+		}
+	}
+
+	if (task)
+		mQueued.fetch_sub(1, std::memory_order_relaxed);
+	return task;
+}
+
+void FS::Scheduler::execute(Task *task)
+{
+	std::atomic<quint32> *pending = task->pending;
+	task->run();
+	delete task;
+	pending->fetch_sub(1, std::memory_order_release);
+}
+
+void FS::Scheduler::wait(std::atomic<quint32> const & pending)
+{
+	// help instead of blocking, the tasks waited for may be queued behind others
+	Worker *self = current();
+	while (pending.load(std::memory_order_acquire) > 0)
+	{
+		Task *task = find(self);
+		if (!task)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// the time is accounted to the task this worker is waiting in
+		execute(task);
+	}
+}
+
+void FS::Scheduler::workerLoop(quint32 index)
+{
+	Worker *self = mWorkers[index].get();
+	tScheduler = this;
+	tWorker = self;
+
+	int idle = 0;
+	while (!mStop.load(std::memory_order_relaxed))
+	{
+		Task *task = find(self);
+		if (task)
+		{
+			idle = 0;
+			auto const start = std::chrono::steady_clock::now();
+			execute(task);
+			auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+			self->busyNs.fetch_add(static_cast<quint64>(ns.count()), std::memory_order_relaxed);
+			continue;
+		}
+
+		if (++idle < SpinRounds)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// nothing to run nor to steal, sleep until a task is spawned
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		mSleeping.fetch_add(1);
+		mWake.wait(lock, [this]() { return mQueued.load() > 0 || mStop.load(); });
+		mSleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
+
+void FS::Scheduler::utilisation(std::vector<qreal> & busy)
+{
+	std::lock_guard<std::mutex> lock(mUtilisationMutex);
+	auto const now = std::chrono::steady_clock::now();
+	qreal const elapsed = static_cast<qreal>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - mSampledAt).count());
+	mSampledAt = now;
+
+	busy.resize(mWorkers.size());
+	for (std::size_t i = 0; i < mWorkers.size(); ++i)
+	{
+		// a task is accounted when it ends, a long one may overflow into the next window
+		quint64 const ns = mWorkers[i]->busyNs.load(std::memory_order_relaxed);
+		busy[i] = elapsed > 0.0 ? qMin<qreal>(1.0, (ns - mWorkers[i]->sampledNs) / elapsed) : 0.0;
+		mWorkers[i]->sampledNs = ns;
+	}
+}
@@ -0,0 +1,212 @@
+#ifndef FS_SCHEDULER_H
+#define FS_SCHEDULER_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FS
+{
+	// Work-stealing task scheduler.
+	// Each worker owns a Chase-Lev deque: it pushes and takes its own tasks at the bottom (last in,
+	// first out, cache friendly for the split halves of a range), idle workers steal the oldest
+	// task at the top of a random victim. Threads that are not workers of this scheduler (GUI,
+	// engine, main) hand their tasks through a shared injection queue.
+	//
+	// A thread waiting for its tasks runs other tasks meanwhile, so fork-join may nest freely.
+	// Tasks must not throw.
+	class Scheduler
+	{
+	public:
+		class Group;
+
+		// workers 0: one per core but the calling thread, which helps while it waits
+		explicit Scheduler(quint32 workers = 0);
+		~Scheduler();
+
+		Scheduler(Scheduler const &) = delete;
+		Scheduler& operator=(Scheduler const &) = delete;
+
+		// scheduler shared by the application, created on first use
+		static Scheduler & instance();
+
+		quint32 workerCount() const { return static_cast<quint32>(mWorkers.size()); }
+
+		// Calls f(begin, end) on sub ranges of [begin, end) of at most grain indices, in parallel,
+		// and returns once all of them are done. A range of one grain runs on the calling thread.
+		template <typename F>
+		void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, F const & f);
+
+		// runs a and b in parallel, returns once both are done
+		template <typename A, typename B>
+		void invoke(A const & a, B const & b);
+
+		// share of the wall time each worker spent running tasks since the previous call
+		void utilisation(std::vector<qreal> & busy);
+
+	private:
+		struct Task
+		{
+			virtual ~Task() = default;
+			virtual void run() = 0;
+			std::atomic<quint32> *pending{ nullptr };
+		};
+
+		template <typename F>
+		struct FunctionTask : Task
+		{
+			explicit FunctionTask(F const & f) : function(f) {}
+			void run() override { function(); }
+			F function;
+		};
+
+		// Chase-Lev deque, the owner pushes and takes at the bottom, thieves steal at the top.
+		// Arrays outgrown by the owner are kept until destruction, a thief may still read them.
+		class Deque
+		{
+		public:
+			Deque();
+			~Deque();
+
+			void push(Task *task);
+			Task* take();
+			Task* steal();
+
+		private:
+			struct Array
+			{
+				explicit Array(qint64 size) : mask{ size - 1 }, tasks{ new std::atomic<Task*>[size] } {}
+				Task* get(qint64 i) const { return tasks[i & mask].load(std::memory_order_relaxed); }
+				void put(qint64 i, Task *task) { tasks[i & mask].store(task, std::memory_order_relaxed); }
+
+				qint64 const mask;
+				std::unique_ptr<std::atomic<Task*>[]> tasks;
+			};
+
+			static std::size_t const CacheLine{ 64 };
+
+			char mPad0[CacheLine];
+			std::atomic<qint64> mTop{ 0 };		// moved by the thieves
+			char mPad1[CacheLine - sizeof(std::atomic<qint64>)];
+			std::atomic<qint64> mBottom{ 0 };	// moved by the owner
+			std::atomic<Array*> mArray;
+			char mPad2[CacheLine - sizeof(std::atomic<qint64>) - sizeof(std::atomic<Array*>)];
+			std::vector<std::unique_ptr<Array>> mArrays;
+		};
+
+		struct Worker
+		{
+			Deque deque;
+			std::thread thread;
+			quint32 seed{ 0 };
+			// nanoseconds spent in tasks, and its value at the previous utilisation()
+			std::atomic<quint64> busyNs{ 0 };
+			quint64 sampledNs{ 0 };
+		};
+
+		void spawn(Task *task);
+		void wait(std::atomic<quint32> const & pending);
+		// a task of the calling thread, the injection queue or a victim, nullptr if none
+		Task* find(Worker *self);
+		void execute(Task *task);
+		void workerLoop(quint32 index);
+		// worker of this scheduler running on the calling thread, nullptr for other threads
+		Worker* current() const;
+
+		std::vector<std::unique_ptr<Worker>> mWorkers;
+
+		std::mutex mInjectionMutex;
+		std::deque<Task*> mInjection;
+
+		// tasks pushed and not taken yet, sleeping workers wait for it to be positive
+		std::atomic<qint64> mQueued{ 0 };
+		std::atomic<quint32> mSleeping{ 0 };
+		std::mutex mSleepMutex;
+		std::condition_variable mWake;
+		std::atomic<bool> mStop{ false };
+
+		std::mutex mUtilisationMutex;
+		std::chrono::steady_clock::time_point mSampledAt;
+	};
+
+	// Tasks spawned together, wait() returns once all of them ran. Destruction waits too.
+	class Scheduler::Group
+	{
+	public:
+		explicit Group(Scheduler & scheduler) : mScheduler(scheduler) {}
+		~Group() { wait(); }
+
+		Group(Group const &) = delete;
+		Group& operator=(Group const &) = delete;
+
+		template <typename F>
+		void run(F const & f)
+		{
+			Task *task = new FunctionTask<F>(f);
+			task->pending = &mPending;
+			mPending.fetch_add(1, std::memory_order_relaxed);
+			mScheduler.spawn(task);
+		}
+
+		void wait() { mScheduler.wait(mPending); }
+
+	private:
+		Scheduler &mScheduler;
+		std::atomic<quint32> mPending{ 0 };
+	};
+};
+
+template <typename F>
+void FS::Scheduler::parallelFor(std::size_t begin, std::size_t end, std::size_t grain, F const & f)
+{
+	grain = qMax<std::size_t>(1, grain);
+	if (end <= begin)
+		return;
+	if (end - begin <= grain || mWorkers.empty())
+	{
+		f(begin, end);
+		return;
+	}
+
+	// each task hands its upper half to the others until it is down to one grain,
+	// thieves take the largest halves first
+	Group group(*this);
+	struct Split
+	{
+		Group &group;
+		std::size_t grain;
+		F const &f;
+
+		void operator()(std::size_t b, std::size_t e) const
+		{
+			while (e - b > grain)
+			{
+				std::size_t const mid = b + (e - b) / 2;
+				Split const self = *this;
+				group.run([self, mid, e]() { self(mid, e); });
+				e = mid;
+			}
+			f(b, e);
+		}
+	};
+	Split{ group, grain, f }(begin, end);
+	group.wait();
+}
+
+template <typename A, typename B>
+void FS::Scheduler::invoke(A const & a, B const & b)
+{
+	Group group(*this);
+	group.run(b);
+	a();
+	group.wait();
+}
+
+#endif // FS_SCHEDULER_H
@@ -0,0 +1,102 @@
+#include "FSSpatialGrid.h"
+
+#include <cmath>
+
+quint32 const FS::SpatialGrid::NoId;
+
+namespace
+{
+	// the grid never holds more than this many cells per box
+	qreal const MaxCellsPerBox{ 4.0 };
+}
+
+void FS::SpatialGrid::clear()
+{
+	mBoxes.clear();
+	mCellStart.clear();
+	mCellIds.clear();
+	mCellsX = mCellsY = 0;
+}
+
+void FS::SpatialGrid::build(std::vector<FS::Box> const & boxes, qreal cellSize)
+{
+	clear();
+	mBoxes = boxes;
+
+	// bounds and mean extent of the boxes
+	qreal x0 = 0.0, y0 = 0.0, x1 = 0.0, y1 = 0.0, extent = 0.0;
+	std::size_t n = 0;
+	for (FS::Box const & b : mBoxes)
+	{
+		if (b.isEmpty())
+			continue;
+		if (n == 0)
+		{
+			x0 = b.x0; y0 = b.y0; x1 = b.x1; y1 = b.y1;
+		}
+		x0 = qMin(x0, b.x0); y0 = qMin(y0, b.y0);
+		x1 = qMax(x1, b.x1); y1 = qMax(y1, b.y1);
+		extent += qMax(b.x1 - b.x0, b.y1 - b.y0);
+		++n;
+	}
+	if (n == 0)
+		return;
+
+	qreal const w = qMax<qreal>(x1 - x0, 1.0);
+	qreal const h = qMax<qreal>(y1 - y0, 1.0);
+	if (cellSize <= 0.0)
+	{
+		// about two boxes per cell, never smaller than a box
+		cellSize = qMax(extent / n, std::sqrt(w * h * 2.0 / n));
+	}
+	cellSize = qMax(cellSize, std::sqrt(w * h / (MaxCellsPerBox * n)));
+	cellSize = qMax<qreal>(cellSize, 1e-6);
+
+	mOriginX = x0;
+	mOriginY = y0;
+	mInvCell = 1.0 / cellSize;
+	mCellsX = qMax(1, static_cast<int>(std::ceil(w * mInvCell)));
+	mCellsY = qMax(1, static_cast<int>(std::ceil(h * mInvCell)));
+
+	// counting pass, then fill the flat cell arrays
+	std::size_t const nCells = static_cast<std::size_t>(mCellsX) * mCellsY;
+	mCellStart.assign(nCells + 1, 0);
+	for (FS::Box const & b : mBoxes)
+	{
+		if (b.isEmpty())
+			continue;
+		for (int cy = cellY(b.y0); cy <= cellY(b.y1); ++cy)
+			for (int cx = cellX(b.x0); cx <= cellX(b.x1); ++cx)
+				++mCellStart[cy * mCellsX + cx + 1];
+	}
+	for (std::size_t c = 0; c < nCells; ++c)
+		mCellStart[c + 1] += mCellStart[c];
+
+	mCellIds.resize(mCellStart[nCells]);
+	std::vector<quint32> cursor(mCellStart.begin(), mCellStart.end() - 1);
+	for (quint32 id = 0; id < count(); ++id)
+	{
+		FS::Box const & b = mBoxes[id];
+		if (b.isEmpty())
+			continue;
+		for (int cy = cellY(b.y0); cy <= cellY(b.y1); ++cy)
+			for (int cx = cellX(b.x0); cx <= cellX(b.x1); ++cx)
+				mCellIds[cursor[cy * mCellsX + cx]++] = id;
+	}
+}
+
+quint32 FS::SpatialGrid::pick(qreal x, qreal y) const
+{
+	if (mCellsX == 0)
+		return NoId;
+
+	int const cell = cellY(y) * mCellsX + cellX(x);
+	quint32 found = NoId;
+	for (quint32 i = mCellStart[cell]; i < mCellStart[cell + 1]; ++i)
+	{
+		quint32 const id = mCellIds[i];
+		if (mBoxes[id].contains(x, y) && (found == NoId || id > found))
+			found = id;
+	}
+	return found;
+}
@@ -0,0 +1,94 @@
+#ifndef FS_SPATIAL_GRID_H
+#define FS_SPATIAL_GRID_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+namespace FS
+{
+	// Axis aligned box in scene coordinates.
+	// An empty box (x0 > x1) marks an id without geometry.
+	struct Box
+	{
+		qreal x0{ 1.0 };
+		qreal y0{ 1.0 };
+		qreal x1{ 0.0 };
+		qreal y1{ 0.0 };
+
+		bool isEmpty() const { return x0 > x1 || y0 > y1; }
+		bool contains(qreal x, qreal y) const { return x >= x0 && x <= x1 && y >= y0 && y <= y1; }
+		bool intersects(Box const & b) const { return x0 <= b.x1 && b.x0 <= x1 && y0 <= b.y1 && b.y0 <= y1; }
+	};
+
+	// Uniform grid over boxes keyed by dense id.
+	// The grid is rebuilt in one pass (O(n)) and stored as flat arrays (cell start + ids),
+	// point and area queries only visit the cells they overlap.
+	// Queries are const and can run concurrently.
+	class SpatialGrid
+	{
+	public:
+		static quint32 const NoId{ 0xFFFFFFFF };
+
+		SpatialGrid() = default;
+		~SpatialGrid() = default;
+
+		// boxes are indexed by id, cellSize <= 0 picks a size from the box density
+		void build(std::vector<FS::Box> const & boxes, qreal cellSize = 0.0);
+		void clear();
+
+		quint32 count() const { return static_cast<quint32>(mBoxes.size()); }
+		FS::Box const & box(quint32 id) const { return mBoxes[id]; }
+
+		// topmost (highest id) box containing the point
+		quint32 pick(qreal x, qreal y) const;
+
+		// calls f(id) once for every box intersecting area
+		template <typename F>
+		void query(FS::Box const & area, F f) const;
+
+	private:
+		int cellX(qreal x) const { return qBound(0, static_cast<int>((x - mOriginX) * mInvCell), mCellsX - 1); }
+		int cellY(qreal y) const { return qBound(0, static_cast<int>((y - mOriginY) * mInvCell), mCellsY - 1); }
+
+		std::vector<FS::Box> mBoxes;
+		std::vector<quint32> mCellStart;
+		std::vector<quint32> mCellIds;
+
+		qreal mOriginX{ 0.0 };
+		qreal mOriginY{ 0.0 };
+		qreal mInvCell{ 1.0 };
+		int mCellsX{ 0 };
+		int mCellsY{ 0 };
+	};
+};
+
+template <typename F>
+void FS::SpatialGrid::query(FS::Box const & area, F f) const
+{
+	if (mCellsX == 0 || area.isEmpty())
+		return;
+
+	int const cx0 = cellX(area.x0), cx1 = cellX(area.x1);
+	int const cy0 = cellY(area.y0), cy1 = cellY(area.y1);
+	for (int cy = cy0; cy <= cy1; ++cy)
+	{
+		for (int cx = cx0; cx <= cx1; ++cx)
+		{
+			int const cell = cy * mCellsX + cx;
+			for (quint32 i = mCellStart[cell]; i < mCellStart[cell + 1]; ++i)
+			{
+				quint32 const id = mCellIds[i];
+				FS::Box const & b = mBoxes[id];
+				if (!b.intersects(area))
+					continue;
+				// a box spanning several cells is only reported by the cell holding
+				// the top left corner of its overlap with the area
+				if (cellX(qMax(b.x0, area.x0)) == cx && cellY(qMax(b.y0, area.y0)) == cy)
+					f(id);
+			}
+		}
+	}
+}
+
+#endif // FS_SPATIAL_GRID_H
@@ -0,0 +1,91 @@
+#ifndef FS_SPSC_QUEUE_H
+#define FS_SPSC_QUEUE_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <memory>
+
+namespace FS
+{
+	// Bounded single producer, single consumer queue.
+	// One thread pushes, one (possibly other) thread pops, without lock: each index is written
+	// by one side only and published with release/acquire ordering. The indices are aligned on
+	// separate cache lines so the two sides do not share one, they stay a line apart even where
+	// the allocator does not honour the alignment (operator new before C++17).
+	template <typename T>
+	class SpscQueue
+	{
+	public:
+		explicit SpscQueue(quint32 capacity)
+			: mSize{ capacity + 1 }
+			, mItems{ new T[capacity + 1] }
+		{
+		}
+		~SpscQueue() = default;
+
+		SpscQueue(SpscQueue const &) = delete;
+		SpscQueue& operator=(SpscQueue const &) = delete;
+
+		quint32 capacity() const { return mSize - 1; }
+
+		// producer side, false if full
+		bool push(T const & item)
+		{
+			quint32 const tail = mTail.load(std::memory_order_relaxed);
+			quint32 const next = tail + 1 == mSize ? 0 : tail + 1;
+			if (next == mHead.load(std::memory_order_acquire))
+				return false;
+			mItems[tail] = item;
+			mTail.store(next, std::memory_order_release);
+			return true;
+		}
+
+		// consumer side, false if empty
+		bool pop(T & item)
+		{
+			quint32 const head = mHead.load(std::memory_order_relaxed);
+			if (head == mTail.load(std::memory_order_acquire))
+				return false;
+			item = mItems[head];
+			mHead.store(head + 1 == mSize ? 0 : head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// exact on the consumer side, a lower bound of the free room on the producer side
+		quint32 size() const
+		{
+			quint32 const head = mHead.load(std::memory_order_acquire);
+			quint32 const tail = mTail.load(std::memory_order_acquire);
+			return tail >= head ? tail - head : tail + mSize - head;
+		}
+		bool isEmpty() const { return size() == 0; }
+		bool isFull() const { return size() == capacity(); }
+
+		// only while neither side runs (checkpoints)
+		template <typename F>
+		void forEach(F f) const
+		{
+			quint32 const tail = mTail.load(std::memory_order_acquire);
+			for (quint32 i = mHead.load(std::memory_order_acquire); i != tail; i = i + 1 == mSize ? 0 : i + 1)
+				f(mItems[i]);
+		}
+		void clear()
+		{
+			mHead.store(0, std::memory_order_relaxed);
+			mTail.store(0, std::memory_order_release);
+		}
+
+	private:
+		static std::size_t const CacheLine{ 64 };
+
+		quint32 const mSize;
+		std::unique_ptr<T[]> mItems;
+
+		// aligned, which also pads the members after them to the next line
+		alignas(CacheLine) std::atomic<quint32> mHead{ 0 };	// written by the consumer
+		alignas(CacheLine) std::atomic<quint32> mTail{ 0 };	// written by the producer
+	};
+};
+
+#endif // FS_SPSC_QUEUE_H
@@ -0,0 +1,46 @@
+#include "FSStringPool.h"
+
+quint32 const FS::StringPool::Empty;
+quint32 const FS::StringPool::NoString;
+quint32 const FS::StringPool::ChunkBits;
+quint32 const FS::StringPool::ChunkMask;
+quint32 const FS::StringPool::MaxChunks;
+
+FS::StringPool::StringPool()
+{
+	intern(QString());
+}
+
+FS::StringPool & FS::StringPool::instance()
+{
+	static StringPool pool;
+	return pool;
+}
+
+quint32 FS::StringPool::intern(QString const & string)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto const it = mHandles.constFind(string);
+	if (it != mHandles.constEnd())
+		return it.value();
+
+	// a full pool hands out the empty string rather than overwrite one
+	quint32 const handle = mCount.load(std::memory_order_relaxed);
+	quint32 const chunk = handle >> ChunkBits;
+	if (chunk >= MaxChunks)
+		return Empty;
+	if (!mChunks[chunk])
+		mChunks[chunk].reset(new QString[ChunkMask + 1]);
+
+	// the key shares the stored string data
+	mChunks[chunk][handle & ChunkMask] = string;
+	mHandles.insert(mChunks[chunk][handle & ChunkMask], handle);
+	mCount.store(handle + 1, std::memory_order_release);
+	return handle;
+}
+
+quint32 FS::StringPool::find(QString const & string) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mHandles.value(string, NoString);
+}
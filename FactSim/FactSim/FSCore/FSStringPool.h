@@ -0,0 +1,61 @@
+#ifndef FS_STRING_POOL_H
+#define FS_STRING_POOL_H
+
+#include <QHash>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace FS
+{
+	// Interned strings: every distinct string is stored once and named by a 32-bit handle.
+	// Names, descriptions, product names and recipe labels keep handles, most of them repeat.
+	//
+	// Strings are stored in chunks that never move, so string() hands out a reference without
+	// copy nor lock. Interning is thread safe; a handle may be read on any thread that got it
+	// from intern() or from a thread synchronised with it.
+	class StringPool
+	{
+	public:
+		// handle of the empty string, the default of every handle
+		static quint32 const Empty{ 0 };
+		static quint32 const NoString{ 0xFFFFFFFF };
+
+		StringPool();
+		~StringPool() = default;
+
+		StringPool(StringPool const &) = delete;
+		StringPool& operator=(StringPool const &) = delete;
+
+		// pool shared by the application, created on first use
+		static StringPool & instance();
+
+		// handle of the string, stored if it is new
+		quint32 intern(QString const & string);
+		// NoString if the string was never interned
+		quint32 find(QString const & string) const;
+		// the empty string for a handle the pool never handed out, NoString included
+		QString const & string(quint32 handle) const
+		{
+			if (handle >= mCount.load(std::memory_order_acquire))
+				return mChunks[0][Empty];
+			return mChunks[handle >> ChunkBits][handle & ChunkMask];
+		}
+		quint32 count() const { return mCount.load(std::memory_order_acquire); }
+
+	private:
+		static quint32 const ChunkBits{ 14 };
+		static quint32 const ChunkMask{ (1u << ChunkBits) - 1 };
+		static quint32 const MaxChunks{ 1u << 14 };
+
+		mutable std::mutex mMutex;
+		QHash<QString, quint32> mHandles;
+		// published after the string is stored, so string() checks a handle without the lock
+		std::atomic<quint32> mCount{ 0 };
+		std::unique_ptr<QString[]> mChunks[MaxChunks];
+	};
+};
+
+#endif // FS_STRING_POOL_H
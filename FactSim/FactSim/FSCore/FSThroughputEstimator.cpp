@@ -0,0 +1,304 @@
+#include "FSThroughputEstimator.h"
+
+#include "FSEngine.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+	int const MaxVisitIterations{ 64 };
+	int const MaxIterations{ 200 };
+	qreal const Tolerance{ 1e-6 };
+
+	// the kinds of stations running the recipes, the others pass their parts on
+	bool hasRecipe(FS::MachineKind kind)
+	{
+		return kind == FS::MachineKind::Import || kind == FS::MachineKind::Transform || kind == FS::MachineKind::Workspace
+			|| kind == FS::MachineKind::Export;
+	}
+}
+
+quint32 const FS::ThroughputEstimator::NoMachine;
+
+void FS::ThroughputEstimator::build(FS::Engine const & engine)
+{
+	quint32 const n = engine.machineCount();
+
+	mKind.resize(n);
+	mSpeed.resize(n);
+	mLength.resize(n);
+	mCapacity.resize(n);
+	mOutDegree.resize(n);
+	mImportProduct.resize(n);
+	mRecipes = engine.recipes();
+	mPopulation = 0.0;
+	for (quint32 id = 0; id < n; ++id)
+	{
+		mKind[id] = engine.kind(id);
+		mSpeed[id] = engine.speed(id);
+		mLength[id] = engine.conveyorLength(id);
+		mCapacity[id] = engine.capacity(id);
+		mOutDegree[id] = engine.outDegree(id);
+		mImportProduct[id] = mKind[id] == FS::MachineKind::Import ? engine.importProduct(id) : 0;
+		// imports generate parts, they hold none
+		if (mKind[id] != FS::MachineKind::Import)
+			mPopulation += engine.capacity(id);
+	}
+	mPopulation = qMax<qreal>(1.0, mPopulation);
+
+	// reverse adjacency
+	mInBegin.assign(n + 1, 0);
+	for (quint32 id = 0; id < n; ++id)
+	{
+		for (quint32 k = 0; k < mOutDegree[id]; ++k)
+			++mInBegin[engine.successor(id, k) + 1];
+	}
+	for (quint32 id = 0; id < n; ++id)
+		mInBegin[id + 1] += mInBegin[id];
+	mIn.resize(mInBegin[n]);
+	std::vector<quint32> cursor(mInBegin.begin(), mInBegin.end() - 1);
+	for (quint32 id = 0; id < n; ++id)
+	{
+		for (quint32 k = 0; k < mOutDegree[id]; ++k)
+			mIn[cursor[engine.successor(id, k)]++] = id;
+	}
+
+	// Kahn's order, so one sweep propagates the visits of an acyclic layout
+	std::vector<quint32> pending(n);
+	mOrder.clear();
+	mOrder.reserve(n);
+	for (quint32 id = 0; id < n; ++id)
+	{
+		pending[id] = mInBegin[id + 1] - mInBegin[id];
+		if (pending[id] == 0)
+			mOrder.push_back(id);
+	}
+	for (std::size_t i = 0; i < mOrder.size(); ++i)
+	{
+		quint32 const id = mOrder[i];
+		for (quint32 k = 0; k < mOutDegree[id]; ++k)
+		{
+			quint32 const next = engine.successor(id, k);
+			if (--pending[next] == 0)
+				mOrder.push_back(next);
+		}
+	}
+	mAcyclic = mOrder.size() == n;
+	for (quint32 id = 0; id < n && !mAcyclic; ++id)
+	{
+		if (pending[id] > 0)
+			mOrder.push_back(id);
+	}
+
+	mVisits.assign(n, 0.0);
+	mFlow.assign(std::size_t(n) * mRecipes.productCount(), 0.0);
+	mQueue.assign(n, 0.0);
+	mUtilisation.assign(n, 0.0);
+}
+
+void FS::ThroughputEstimator::setSpeed(quint32 id, qreal speed)
+{
+	if (id < machineCount())
+		mSpeed[id] = qMax<qreal>(0.0, speed);
+}
+
+void FS::ThroughputEstimator::updateVisits()
+{
+	// the engine hands a part to the first successor with room, so the flow splits
+	// in proportion of the successor rates (evenly if they are all stopped)
+	quint32 const n = machineCount();
+	std::vector<qreal> rate(n), outRate(n, 0.0);
+	for (quint32 id = 0; id < n; ++id)
+	{
+		rate[id] = mKind[id] == FS::MachineKind::Conveyor
+			? (mLength[id] > 0.0 ? mCapacity[id] * mSpeed[id] * 60.0 / mLength[id] : 0.0)
+			: mSpeed[id];
+		for (quint32 i = mInBegin[id]; i < mInBegin[id + 1]; ++i)
+			outRate[mIn[i]] += rate[id];
+	}
+
+	// sources are visited in proportion of their rate
+	qreal sourceRate = 0.0;
+	quint32 sources = 0;
+	for (quint32 id = 0; id < n; ++id)
+	{
+		if (mKind[id] == FS::MachineKind::Import)
+		{
+			sourceRate += mSpeed[id];
+			++sources;
+		}
+	}
+
+	auto injected = [this, sourceRate, sources](quint32 id) {
+		if (mKind[id] != FS::MachineKind::Import)
+			return 0.0;
+		return sourceRate > 0.0 ? mSpeed[id] / sourceRate : 1.0 / sources;
+	};
+
+	// parts of each product put out per visit to the factory: a recipe turns a part into
+	// outputCount parts of its output, an export takes its part out, the others pass it on
+	quint32 const products = mRecipes.productCount();
+	std::vector<qreal> out(std::size_t(n) * products, 0.0);
+	auto putOut = [this, products, &out](quint32 id) {
+		qreal const *flow = &mFlow[std::size_t(id) * products];
+		qreal *o = &out[std::size_t(id) * products];
+		std::fill(o, o + products, 0.0);
+		for (quint32 p = 0; p < products; ++p)
+		{
+			if (flow[p] <= 0.0)
+				continue;
+			if (hasRecipe(mKind[id]) && mKind[id] != FS::MachineKind::Export)
+			{
+				FS::RecipeTable::Entry const & recipe = mRecipes.entry(mKind[id], p);
+				o[recipe.output] += flow[p] * recipe.outputCount;
+			}
+			else
+			{
+				o[p] += flow[p];
+			}
+		}
+	};
+	for (quint32 id = 0; id < n; ++id)
+		putOut(id);
+
+	int const sweeps = mAcyclic ? 1 : MaxVisitIterations;
+	for (int sweep = 0; sweep < sweeps; ++sweep)
+	{
+		qreal change = 0.0;
+		for (quint32 id : mOrder)
+		{
+			qreal *flow = &mFlow[std::size_t(id) * products];
+			std::fill(flow, flow + products, 0.0);
+			flow[mImportProduct[id]] = injected(id);
+			for (quint32 i = mInBegin[id]; i < mInBegin[id + 1]; ++i)
+			{
+				quint32 const from = mIn[i];
+				qreal const share = outRate[from] > 0.0 ? rate[id] / outRate[from] : 1.0 / mOutDegree[from];
+				for (quint32 p = 0; p < products; ++p)
+					flow[p] += out[std::size_t(from) * products + p] * share;
+			}
+			qreal const v = std::accumulate(flow, flow + products, 0.0);
+			change = qMax(change, qAbs(v - mVisits[id]));
+			mVisits[id] = v;
+			putOut(id);
+		}
+		if (change < Tolerance)
+			break;
+	}
+
+	mExitFlow = 0.0;
+	for (quint32 id = 0; id < n; ++id)
+	{
+		if (mOutDegree[id] == 0)
+			mExitFlow += std::accumulate(&out[std::size_t(id) * products], &out[std::size_t(id + 1) * products], 0.0);
+	}
+}
+
+FS::ThroughputEstimator::Estimate FS::ThroughputEstimator::solve()
+{
+	Estimate estimate;
+	quint32 const n = machineCount();
+	updateVisits();
+
+	// service demand per visit to the factory, a stopped machine on the flow stops the line
+	std::vector<qreal> demand(n, 0.0);
+	quint32 stations = 0;
+	for (quint32 id = 0; id < n; ++id)
+	{
+		mUtilisation[id] = 0.0;
+		if (mVisits[id] <= 0.0)
+			continue;
+		if (mSpeed[id] <= 0.0)
+		{
+			estimate.bottleneck = id;
+			estimate.bottleneckUtilisation = 1.0;
+			if (mKind[id] != FS::MachineKind::Conveyor)
+				mUtilisation[id] = 1.0;
+			return estimate;
+		}
+		if (mKind[id] == FS::MachineKind::Conveyor)
+		{
+			demand[id] = mVisits[id] * mLength[id] / mSpeed[id];
+		}
+		else
+		{
+			// each product at the pace of its recipe
+			qreal visitsAtPace = mVisits[id];
+			if (hasRecipe(mKind[id]))
+			{
+				quint32 const products = mRecipes.productCount();
+				visitsAtPace = 0.0;
+				for (quint32 p = 0; p < products; ++p)
+					visitsAtPace += mFlow[std::size_t(id) * products + p] / mRecipes.entry(mKind[id], p).pace;
+			}
+			demand[id] = visitsAtPace * 60.0 / mSpeed[id];
+			++stations;
+		}
+	}
+	if (stations == 0)
+		return estimate;
+
+	// Schweitzer: a part arriving at a station sees (N - 1) / N of its mean queue
+	qreal const n1 = (mPopulation - 1.0) / mPopulation;
+	qreal queued = 0.0;
+	for (quint32 id = 0; id < n; ++id)
+	{
+		if (demand[id] <= 0.0 || mKind[id] == FS::MachineKind::Conveyor)
+			mQueue[id] = 0.0;
+		queued += mQueue[id];
+	}
+	// cold start: parts evenly spread over the stations
+	if (queued <= 0.0)
+	{
+		for (quint32 id = 0; id < n; ++id)
+		{
+			if (demand[id] > 0.0 && mKind[id] != FS::MachineKind::Conveyor)
+				mQueue[id] = mPopulation / stations;
+		}
+	}
+
+	qreal x = 0.0;
+	for (int it = 0; it < MaxIterations; ++it)
+	{
+		estimate.iterations = it + 1;
+
+		qreal cycle = 0.0;
+		for (quint32 id = 0; id < n; ++id)
+		{
+			if (mKind[id] == FS::MachineKind::Conveyor)
+				cycle += demand[id];
+			else
+				cycle += demand[id] * (1.0 + mQueue[id] * n1);
+		}
+		x = mPopulation / cycle;
+
+		qreal change = 0.0;
+		for (quint32 id = 0; id < n; ++id)
+		{
+			if (demand[id] <= 0.0 || mKind[id] == FS::MachineKind::Conveyor)
+				continue;
+			qreal const q = x * demand[id] * (1.0 + mQueue[id] * n1);
+			change = qMax(change, qAbs(q - mQueue[id]));
+			mQueue[id] = q;
+		}
+		if (change < Tolerance * mPopulation)
+			break;
+	}
+
+	for (quint32 id = 0; id < n; ++id)
+	{
+		if (demand[id] <= 0.0 || mKind[id] == FS::MachineKind::Conveyor)
+			continue;
+		mUtilisation[id] = qMin<qreal>(1.0, x * demand[id]);
+		if (mUtilisation[id] > estimate.bottleneckUtilisation)
+		{
+			estimate.bottleneck = id;
+			estimate.bottleneckUtilisation = mUtilisation[id];
+		}
+	}
+
+	// x counts passes through the factory per second
+	estimate.throughput = x * mExitFlow * 60.0;
+	return estimate;
+}
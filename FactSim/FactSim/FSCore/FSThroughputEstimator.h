@@ -0,0 +1,83 @@
+#ifndef FS_THROUGHPUT_ESTIMATOR_H
+#define FS_THROUGHPUT_ESTIMATOR_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+#include "FSMachineKind.h"
+#include "FSRecipeBook.h"
+
+namespace FS
+{
+	class Engine;
+
+	// Analytic estimate of the line rate, without simulation.
+	// The layout is seen as a closed queueing network: stations are single servers with a
+	// service time of 60 / (speed * pace) seconds, the pace of their recipe for the product of the
+	// part, conveyors are pure delays (length / speed), and the buffers bound the number of parts
+	// in the factory. A station with a recipe puts out outputCount parts of its output per part.
+	// Parts split between successors in proportion of their rates and leave through the machines
+	// without successor.
+	// Solved with Schweitzer's approximate mean value analysis, O(machines) per iteration,
+	// warm started from the previous solution so a speed edit converges in a few iterations.
+	class ThroughputEstimator
+	{
+	public:
+		static quint32 const NoMachine{ 0xFFFFFFFF };
+
+		struct Estimate
+		{
+			// parts per minute leaving the factory
+			qreal throughput{ 0.0 };
+			// station with the highest utilisation
+			quint32 bottleneck{ NoMachine };
+			qreal bottleneckUtilisation{ 0.0 };
+			int iterations{ 0 };
+		};
+
+		ThroughputEstimator() = default;
+		~ThroughputEstimator() = default;
+
+		// copies topology and parameters, only while the engine is not stepping,
+		// the links are read as of the last FS::Engine::updateTopology()
+		void build(FS::Engine const & engine);
+
+		quint32 machineCount() const { return static_cast<quint32>(mKind.size()); }
+		void setSpeed(quint32 id, qreal speed);
+
+		FS::ThroughputEstimator::Estimate solve();
+		// utilisation of a station in the last solve, 0 for conveyors
+		qreal utilisation(quint32 id) const { return mUtilisation[id]; }
+
+	private:
+		void updateVisits();
+
+		std::vector<FS::MachineKind> mKind;
+		std::vector<qreal> mSpeed;
+		std::vector<qreal> mLength;
+		std::vector<quint32> mCapacity;
+		std::vector<quint32> mOutDegree;
+		FS::RecipeTable mRecipes;
+		std::vector<quint32> mImportProduct;
+
+		// predecessors of id in mIn[mInBegin[id]..mInBegin[id + 1]]
+		std::vector<quint32> mInBegin;
+		std::vector<quint32> mIn;
+		// sources first, then topological order, machines on cycles last
+		std::vector<quint32> mOrder;
+		bool mAcyclic{ true };
+
+		qreal mPopulation{ 1.0 };
+
+		// last solution, also the starting point of the next solve
+		std::vector<qreal> mVisits;
+		// visits of id with a part of product p in mFlow[id * productCount + p]
+		std::vector<qreal> mFlow;
+		std::vector<qreal> mQueue;
+		std::vector<qreal> mUtilisation;
+		qreal mExitFlow{ 0.0 };
+	};
+};
+
+#endif // FS_THROUGHPUT_ESTIMATOR_H
@@ -0,0 +1,164 @@
+#include "FSTimeControl.h"
+
+#include "FSEngine.h"
+
+namespace
+{
+	using Seconds = std::chrono::duration<qreal>;
+
+	// steps run between two clock checks
+	int const StepBatch{ 64 };
+	int const WorkerBatch{ 256 };
+	// the engine never owes more than this much wall time, otherwise it would never catch up
+	qreal const MaxLag{ 0.25 };
+	// share of a frame the GUI thread may spend stepping the engine
+	qreal const FrameBudget{ 0.8 };
+	// window used to measure the simulation rate
+	qreal const RateWindow{ 0.5 };
+}
+
+FS::TimeControl::TimeControl(FS::Engine *engine)
+	: mEngine{ engine }
+{
+	mLastFrame = mLastRender = mRateRef = Clock::now();
+}
+
+FS::TimeControl::~TimeControl()
+{
+	stopWorker();
+}
+
+void FS::TimeControl::setMode(Mode m)
+{
+	if (m == mMode)
+		return;
+
+	stopWorker();
+	mMode = m;
+	mDebt = 0.0;
+	if (mRunning && mMode == Mode::MaxSpeed)
+		startWorker();
+}
+
+void FS::TimeControl::setRatio(qreal r)
+{
+	if (r > 0.0) // validate ratio
+		mRatio = r;
+}
+
+void FS::TimeControl::setRunning(bool running)
+{
+	if (running == mRunning)
+		return;
+
+	mRunning = running;
+	mDebt = 0.0;
+	mLastFrame = Clock::now();
+	if (mRunning && mMode == Mode::MaxSpeed)
+		startWorker();
+	else
+		stopWorker();
+}
+
+bool FS::TimeControl::frame()
+{
+	Clock::time_point const now = Clock::now();
+	qreal const wall = Seconds(now - mLastFrame).count();
+	mLastFrame = now;
+
+	bool behind = false;
+	if (mRunning && mMode != Mode::MaxSpeed)
+	{
+		qreal const rate = mMode == Mode::Scaled ? mRatio : 1.0;
+		mDebt = qMin(mDebt + wall * rate, MaxLag * rate);
+
+		Seconds const budget(qMax(wall, 0.005) * FrameBudget);
+		stepFor(now + std::chrono::duration_cast<Clock::duration>(budget));
+
+		behind = mDebt >= mEngine->timeStep();
+		mEngine->publish();
+	}
+	updateSimRate(now);
+
+	bool render;
+	if (mRunning && mMode == Mode::MaxSpeed)
+		render = Seconds(now - mLastRender).count() >= 0.9 / mMaxDisplayRate;
+	else
+		render = !behind || mSkippedFrames >= mMaxFrameSkip;
+
+	if (render)
+	{
+		mSkippedFrames = 0;
+		mLastRender = now;
+	}
+	else
+	{
+		++mSkippedFrames;
+	}
+	return render;
+}
+
+void FS::TimeControl::stepFor(Clock::time_point deadline)
+{
+	qreal const dt = mEngine->timeStep();
+	while (mDebt >= dt)
+	{
+		int const batch = static_cast<int>(qMin<qreal>(StepBatch, mDebt / dt));
+		for (int i = 0; i < batch; ++i)
+			mEngine->step();
+		mDebt -= batch * dt;
+
+		if (Clock::now() >= deadline)
+			break;
+	}
+}
+
+void FS::TimeControl::updateSimRate(Clock::time_point now)
+{
+	qreal const elapsed = Seconds(now - mRateRef).count();
+	if (elapsed < RateWindow)
+		return;
+
+	qreal const simTime = mEngine->snapshot()->simTime;
+	mSimRate = (simTime - mRateSimRef) / elapsed;
+	mRateSimRef = simTime;
+	mRateRef = now;
+}
+
+void FS::TimeControl::startWorker()
+{
+	if (mWorker.joinable())
+		return;
+
+	mStopWorker.store(false);
+	mWorker = std::thread(&FS::TimeControl::workerLoop, this);
+}
+
+void FS::TimeControl::stopWorker()
+{
+	if (!mWorker.joinable())
+		return;
+
+	mStopWorker.store(true);
+	mWorker.join();
+}
+
+void FS::TimeControl::workerLoop()
+{
+	Seconds const publishPeriod(1.0 / mMaxDisplayRate);
+	Clock::time_point lastPublish = Clock::now();
+
+	while (!mStopWorker.load(std::memory_order_relaxed))
+	{
+		for (int i = 0; i < WorkerBatch; ++i)
+			mEngine->step();
+
+		Clock::time_point const now = Clock::now();
+		if (now - lastPublish >= publishPeriod)
+		{
+			mEngine->publish();
+			lastPublish = now;
+		}
+	}
+	mEngine->publish();
+}
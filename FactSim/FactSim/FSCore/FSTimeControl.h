@@ -0,0 +1,86 @@
+#ifndef FS_TIME_CONTROL_H
+#define FS_TIME_CONTROL_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace FS
+{
+	class Engine;
+
+	// Drives an FS::Engine against the wall clock.
+	// RealTime and Scaled step the engine on the caller's thread from frame(),
+	// MaxSpeed runs the engine on its own thread and frame() only samples its snapshots.
+	class TimeControl
+	{
+	public:
+		enum class Mode { RealTime, Scaled, MaxSpeed };
+
+		TimeControl(FS::Engine *engine);
+		~TimeControl();
+
+		TimeControl(TimeControl const &) = delete;
+		TimeControl& operator=(TimeControl const &) = delete;
+
+		Mode mode() const { return mMode; }
+		void setMode(Mode m);
+
+		// simulated seconds per wall second in Scaled mode
+		qreal ratio() const { return mRatio; }
+		void setRatio(qreal r);
+
+		bool isRunning() const { return mRunning; }
+		void setRunning(bool running);
+		// the engine steps on the worker thread, the other threads may only read its snapshots
+		bool isThreaded() const { return mWorker.joinable(); }
+
+		// display rate cap in MaxSpeed mode (Hz)
+		qreal maxDisplayRate() const { return mMaxDisplayRate; }
+		void setMaxDisplayRate(qreal hz) { if (hz > 0.0) mMaxDisplayRate = hz; }
+
+		// consecutive frames allowed to be dropped while the engine catches up
+		int maxFrameSkip() const { return mMaxFrameSkip; }
+		void setMaxFrameSkip(int n) { mMaxFrameSkip = qMax(0, n); }
+
+		// called once per display frame, returns true if the frame should be rendered
+		bool frame();
+
+		// measured simulated seconds per wall second
+		qreal simRate() const { return mSimRate; }
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		void startWorker();
+		void stopWorker();
+		void workerLoop();
+		void stepFor(Clock::time_point deadline);
+		void updateSimRate(Clock::time_point now);
+
+		FS::Engine *mEngine;
+		Mode mMode{ Mode::RealTime };
+		qreal mRatio{ 1.0 };
+		bool mRunning{ false };
+
+		qreal mMaxDisplayRate{ 30.0 };
+		int mMaxFrameSkip{ 4 };
+		int mSkippedFrames{ 0 };
+
+		// simulated time owed to the engine (seconds)
+		qreal mDebt{ 0.0 };
+
+		Clock::time_point mLastFrame;
+		Clock::time_point mLastRender;
+		Clock::time_point mRateRef;
+		qreal mRateSimRef{ 0.0 };
+		qreal mSimRate{ 0.0 };
+
+		std::thread mWorker;
+		std::atomic<bool> mStopWorker{ false };
+	};
+};
+
+#endif // FS_TIME_CONTROL_H
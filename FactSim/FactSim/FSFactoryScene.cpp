@@ -1,7 +1,74 @@
 #include "FSFactoryScene.h"
 
+#include "FSCore/FSScheduler.h"
+#include "FSItems/FSMachine.h"
+#include "FSItems/FSWorkspace.h"
+#include "FSItems/FSImport.h"
+#include "FSItems/FSExport.h"
+#include "FSItems/FSTransform.h"
+
+namespace
+{
+	// items per task, below it the hand over costs more than the construction
+	std::size_t const ItemsPerTask{ 2048 };
+}
+
 FS::FactoryScene::FactoryScene(int w, int h)
 	: QGraphicsScene(0,0,w,h)
 {
 
-}
\ No newline at end of file
+}
+
+FS::Machine* FS::FactoryScene::buildMachine(FS::MachineSpec const & spec)
+{
+	FS::Machine *machine;
+	switch (spec.kind)
+	{
+		case FS::MachineKind::Import:
+			machine = new FS::Import(spec.x, spec.y);
+			break;
+		case FS::MachineKind::Workspace:
+			machine = new FS::Workspace(spec.x, spec.y);
+			break;
+		case FS::MachineKind::Transform:
+			machine = new FS::Transform(spec.x, spec.y);
+			break;
+		case FS::MachineKind::Export:
+			machine = new FS::Export(spec.x, spec.y);
+			break;
+		default: // no graphics item for this kind yet
+			return nullptr;
+	}
+
+	machine->setName(spec.name);
+	machine->setDescription(spec.description);
+	machine->setSpeed(spec.speed);
+	return machine;
+}
+
+std::vector<FS::Machine*> FS::FactoryScene::addMachines(std::vector<FS::MachineSpec> const & specs)
+{
+	std::vector<FS::Machine*> machines(specs.size(), nullptr);
+
+	// items that are not in a scene yet can be built off the GUI thread
+	FS::Scheduler::instance().parallelFor(0, specs.size(), ItemsPerTask, [&specs, &machines](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i)
+			machines[i] = buildMachine(specs[i]);
+	});
+
+	// insert without index, then let the scene build its BSP tree once
+	ItemIndexMethod const indexMethod = itemIndexMethod();
+	setItemIndexMethod(QGraphicsScene::NoIndex);
+
+	mSimObject.reserve(mSimObject.size() + static_cast<int>(machines.size()));
+	for (FS::Machine *machine : machines)
+	{
+		if (!machine)
+			continue;
+		addItem(machine);
+		mSimObject.append(machine);
+	}
+
+	setItemIndexMethod(indexMethod);
+	return machines;
+}
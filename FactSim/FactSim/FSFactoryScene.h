@@ -4,21 +4,36 @@
 #include <QGraphicsScene>
 #include <QList>
 
+#include <vector>
+
+#include "FSCore/FSLayout.h"
+
 namespace FS
 {
+	class Machine;
 
 	class FactoryScene : public QGraphicsScene
 	{
 		Q_OBJECT
-	
+
 	public:
 		FactoryScene() = delete;
 		FactoryScene(int w, int h);
 		~FactoryScene() = default;
 
+		// Bulk insertion of machines.
+		// The items are built on worker threads, then added in one batch with the scene index
+		// disabled, so the index is rebuilt once instead of being updated for every item.
+		// The returned list is aligned on specs, kinds without graphics item are nullptr.
+		std::vector<FS::Machine*> addMachines(std::vector<FS::MachineSpec> const & specs);
+
+		QList<QGraphicsItem*> const & simObjects() const { return mSimObject; }
+
 	private:
+		static FS::Machine* buildMachine(FS::MachineSpec const & spec);
+
 		QList<QGraphicsItem*> mSimObject;
 	};
 }
 
-#endif // FS_FACTORY_SCENE
\ No newline at end of file
+#endif // FS_FACTORY_SCENE
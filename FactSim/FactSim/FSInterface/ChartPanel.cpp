@@ -0,0 +1,81 @@
+#include "ChartPanel.h"
+
+#include <QGroupBox>
+#include <QGridLayout>
+#include <QTimer>
+
+#include <QGraphicsItem>
+
+#include "MetricChart.h"
+
+#include "FSCore/FSMetricStore.h"
+#include "FSItems/FSMachine.h"
+
+int const FS::ChartPanel::ChartCount;
+
+FS::ChartPanel::ChartPanel(QWidget *parent)
+	: QWidget(parent)
+{
+	mCharts[0] = new FS::MetricChart(QString("Factory throughput"), "/min", FS::Metric::Throughput);
+	mCharts[1] = new FS::MetricChart(QString("Factory WIP"), "parts", FS::Metric::Queue);
+	mCharts[2] = new FS::MetricChart(QString("Factory utilisation"), "", FS::Metric::Utilisation);
+	mCharts[3] = new FS::MetricChart(QString("Throughput"), "/min", FS::Metric::Throughput);
+	mCharts[4] = new FS::MetricChart(QString("Queue"), "parts", FS::Metric::Queue);
+	mCharts[5] = new FS::MetricChart(QString("Utilisation"), "", FS::Metric::Utilisation);
+	for (int i = 0; i < 3; ++i)
+		mCharts[i]->setSeries(FS::MetricStore::Factory);
+	// utilisation samples are states, only their means read as a utilisation
+	mCharts[2]->setTop(1.0f);
+	mCharts[2]->setMeans(true);
+	mCharts[5]->setTop(1.0f);
+	mCharts[5]->setMeans(true);
+
+	// factory on the first row, selected machine on the second
+	QGridLayout *grid = new QGridLayout;
+	for (int i = 0; i < ChartCount; ++i)
+		grid->addWidget(mCharts[i], i / 3, i % 3);
+
+	QGroupBox *GroupBox = new QGroupBox(QString("Charts"));
+	GroupBox->setLayout(grid);
+
+	QGridLayout *tmp = new QGridLayout;
+	tmp->setContentsMargins(0, 0, 0, 0);
+	tmp->addWidget(GroupBox, 0, 0);
+	setLayout(tmp);
+
+	// refresh timer
+	mTimer = new QTimer(this);
+	connect(mTimer, &QTimer::timeout, this, &FS::ChartPanel::refresh);
+	setRefreshRate(20);
+}
+
+void FS::ChartPanel::setRefreshRate(int hz)
+{
+	if (hz > 0) // validate rate
+		mTimer->start(1000 / hz);
+}
+
+void FS::ChartPanel::activeObject(QGraphicsItem *tgt)
+{
+	quint32 id = FS::MetricChart::NoSeries;
+	if (tgt != nullptr && tgt->type() == FS::Machine::Type)
+		id = static_cast<FS::Machine*>(tgt)->id();
+
+	for (int i = 3; i < ChartCount; ++i)
+		mCharts[i]->setSeries(id);
+	refresh();
+}
+
+void FS::ChartPanel::refresh()
+{
+	if (!mStore || !isVisible())
+		return;
+
+	mRefreshTimer.start();
+	// the whole run, up to the last sample
+	qreal const t0 = mStore->start();
+	qreal const t1 = t0 + mStore->sampleCount(FS::Metric::Queue) * mStore->interval();
+	for (FS::MetricChart *chart : mCharts)
+		chart->refresh(*mStore, t0, t1);
+	mLastRefreshNs = mRefreshTimer.nsecsElapsed();
+}
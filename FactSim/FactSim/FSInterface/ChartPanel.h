@@ -0,0 +1,52 @@
+#ifndef FS_CHARTPANEL_H
+#define FS_CHARTPANEL_H
+
+#include <QWidget>
+#include <QElapsedTimer>
+
+class QTimer;
+class QGraphicsItem;
+
+namespace FS
+{
+	class MetricChart;
+	class MetricStore;
+
+	// Throughput, work in progress and utilisation charts of the whole factory and of the
+	// selected machine, over the whole run.
+	// The charts pull decimated points from the metrics store at a bounded rate, so a refresh
+	// costs the same for a minute or for hours of history.
+	class ChartPanel : public QWidget
+	{
+		Q_OBJECT
+
+	public slots:
+		void activeObject(QGraphicsItem *tgt);
+
+	public:
+		ChartPanel(QWidget *parent = nullptr);
+		~ChartPanel() = default;
+
+		void setStore(FS::MetricStore const *store) { mStore = store; }
+		// maximum number of refresh per second
+		void setRefreshRate(int hz);
+		// time taken by the last refresh of every chart, in milliseconds
+		qreal lastRefreshTime() const { return mLastRefreshNs * 1e-6; }
+
+	private slots:
+		void refresh();
+
+	private:
+		static int const ChartCount{ 6 };
+
+		FS::MetricStore const *mStore{ nullptr };
+		// factory charts, then the selected machine charts
+		FS::MetricChart *mCharts[ChartCount];
+
+		QTimer *mTimer;
+		QElapsedTimer mRefreshTimer;
+		qint64 mLastRefreshNs{ 0 };
+	};
+};
+
+#endif // FS_CHARTPANEL_H
@@ -1,22 +1,232 @@
 #include "FSFactoryView.h"
 
+#include <QApplication>
 #include <QMouseEvent>
+#include <QPainter>
+
+#include "FSItems/FSMachine.h"
+
+namespace
+{
+	FS::Box toBox(QRectF const & r)
+	{
+		FS::Box b;
+		b.x0 = r.left();
+		b.y0 = r.top();
+		b.x1 = r.right();
+		b.y1 = r.bottom();
+		return b;
+	}
+}
 
 FS::FactoryView::FactoryView(QGraphicsScene * scene, QWidget * parent)
 	: QInteractiveGraphicsView(scene)
 {
+	// hover needs move events without any button pressed
+	setMouseTracking(true);
+}
+
+void FS::FactoryView::setMachines(std::vector<FS::Machine*> const & machines)
+{
+	quint32 size = 0;
+	for (FS::Machine *machine : machines)
+		if (machine)
+			size = qMax(size, machine->id() + 1);
 
+	mMachines.assign(size, nullptr);
+	std::vector<FS::Box> boxes(size);
+	for (FS::Machine *machine : machines)
+	{
+		if (!machine)
+			continue;
+		mMachines[machine->id()] = machine;
+		boxes[machine->id()] = toBox(machine->sceneBoundingRect());
+	}
+
+	mPickGrid.build(boxes);
+	mHeatmap.setMachines(mMachines);
+	mSelection.resize(size);
+	mSelection.clear();
+	mHovered = FS::SpatialGrid::NoId;
+	viewport()->update();
+	emit machinesChanged();
+}
+
+quint32 FS::FactoryView::pick(QPoint const & pos) const
+{
+	QPointF const p = mapToScene(pos);
+	return mPickGrid.pick(p.x(), p.y());
+}
+
+QGraphicsItem * FS::FactoryView::item(quint32 id) const
+{
+	return id < mMachines.size() ? mMachines[id] : nullptr;
+}
+
+void FS::FactoryView::mouseMoveEvent(QMouseEvent *event)
+{
+	if (mPressed && mPersistentInteractionMode == PersistentInteractionMode::None)
+	{
+		if (!mRubberBand && (event->pos() - mPressPos).manhattanLength() >= QApplication::startDragDistance())
+			mRubberBand = true;
+		if (mRubberBand)
+			viewport()->update();
+	}
+	else if (!mPressed)
+	{
+		quint32 const hovered = pick(event->pos());
+		if (hovered != mHovered)
+		{
+			mHovered = hovered;
+			viewport()->update();
+			emit hoveredObject(item(mHovered));
+		}
+	}
+
+	QInteractiveGraphicsView::mouseMoveEvent(event);
+}
+
+void FS::FactoryView::mousePressEvent(QMouseEvent *event)
+{
+	mPressed = event->button() == Qt::LeftButton;
+	mRubberBand = false;
+	mPressPos = event->pos();
+
+	QInteractiveGraphicsView::mousePressEvent(event);
 }
 
 void FS::FactoryView::mouseReleaseEvent(QMouseEvent *event)
 {
-	if (itemAt(event->pos()))
+	// view interactions (translation, scaling, rotation) don't change the selection
+	bool const moved = (event->pos() - mPressPos).manhattanLength() >= QApplication::startDragDistance();
+	bool const interacting = mPersistentInteractionMode != PersistentInteractionMode::None;
+	bool const toggle = mPersistentInteractionMode == PersistentInteractionMode::MouseScaling && !moved;
+
+	if (mPressed && mRubberBand)
+	{
+		selectArea(QRect(mPressPos, event->pos()).normalized());
+	}
+	else if (mPressed && toggle)
+	{
+		quint32 const id = pick(event->pos());
+		if (id != FS::SpatialGrid::NoId)
+		{
+			mSelection.toggle(id);
+			emit selectionChanged();
+			emit activeObject(mSelection.test(id) ? item(id) : nullptr);
+		}
+	}
+	else if (mPressed && !interacting)
+	{
+		quint32 const id = pick(event->pos());
+		mSelection.clear();
+		if (id != FS::SpatialGrid::NoId)
+			mSelection.set(id);
+		emit selectionChanged();
+
+		if (id == FS::SpatialGrid::NoId)
+			qDebug("You didn't click on an item.");
+		emit activeObject(item(id));
+	}
+
+	mPressed = false;
+	mRubberBand = false;
+	viewport()->update();
+
+	QInteractiveGraphicsView::mouseReleaseEvent(event);
+}
+
+void FS::FactoryView::selectArea(QRect const & area)
+{
+	FS::Box const box = toBox(mapToScene(area).boundingRect());
+
+	mSelection.clear();
+	quint32 first = FS::SpatialGrid::NoId;
+	mPickGrid.query(box, [this, &first](quint32 id) {
+		mSelection.set(id);
+		first = qMin(first, id);
+	});
+
+	emit selectionChanged();
+	emit activeObject(item(first));
+}
+
+void FS::FactoryView::paintEvent(QPaintEvent *event)
+{
+	QInteractiveGraphicsView::paintEvent(event);
+
+	if (!mRubberBand)
+		return;
+
+	QPainter painter(viewport());
+	painter.setPen(QPen(QColor(67, 114, 196), 1.0, Qt::DashLine));
+	painter.setBrush(QColor(132, 164, 217, 48));
+	painter.drawRect(QRect(mPressPos, mCurrentMousePos).normalized());
+}
+
+void FS::FactoryView::setBottleneck(quint32 id)
+{
+	if (id >= mPickGrid.count())
+		id = FS::SpatialGrid::NoId;
+	if (id == mBottleneck)
+		return;
+	mBottleneck = id;
+	viewport()->update();
+}
+
+void FS::FactoryView::setHeatMetric(FS::HeatMetric metric)
+{
+	if (metric == mHeatmap.metric())
+		return;
+	mHeatmap.setMetric(metric);
+	refreshHeatmap();
+	viewport()->update();
+}
+
+void FS::FactoryView::refreshHeatmap()
+{
+	if (!mEngine || mHeatmap.metric() == FS::HeatMetric::Off)
+		return;
+	if (mHeatmap.update(*mEngine->snapshot(), *mEngine))
+		viewport()->update();
+}
+
+void FS::FactoryView::drawForeground(QPainter *painter, QRectF const & rect)
+{
+	// under the outlines, texels stay sharp when zoomed in
+	if (mHeatmap.metric() != FS::HeatMetric::Off && !mHeatmap.image().isNull())
 	{
-		emit activeObject(itemAt(event->pos()));
+		painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+		painter->drawImage(mHeatmap.rect(), mHeatmap.image());
 	}
-	else
+
+	if (mBottleneck != FS::SpatialGrid::NoId && !mPickGrid.box(mBottleneck).isEmpty())
+	{
+		FS::Box const & b = mPickGrid.box(mBottleneck);
+		painter->setPen(QPen(QColor(200, 30, 30), 4.0));
+		painter->setBrush(Qt::NoBrush);
+		painter->drawRect(QRectF(b.x0 - 3.0, b.y0 - 3.0, b.x1 - b.x0 + 6.0, b.y1 - b.y0 + 6.0));
+	}
+
+	// only the exposed part of the selection is drawn
+	if (!mSelection.isEmpty())
 	{
-		qDebug("You didn't click on an item.");
-		emit activeObject(nullptr);
+		painter->setPen(QPen(QColor(67, 114, 196), 2.0));
+		painter->setBrush(Qt::NoBrush);
+		mPickGrid.query(toBox(rect), [this, painter](quint32 id) {
+			if (mSelection.test(id))
+			{
+				FS::Box const & b = mPickGrid.box(id);
+				painter->drawRect(QRectF(b.x0, b.y0, b.x1 - b.x0, b.y1 - b.y0));
+			}
+		});
 	}
-}
\ No newline at end of file
+
+	if (mHovered != FS::SpatialGrid::NoId)
+	{
+		FS::Box const & b = mPickGrid.box(mHovered);
+		painter->setPen(QPen(QColor(208, 109, 42), 2.0));
+		painter->setBrush(Qt::NoBrush);
+		painter->drawRect(QRectF(b.x0, b.y0, b.x1 - b.x0, b.y1 - b.y0));
+	}
+}
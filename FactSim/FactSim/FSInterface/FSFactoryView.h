@@ -1,11 +1,26 @@
 #ifndef FS_FACTORYVIEW_H
 #define FS_FACTORYVIEW_H
 
-#include "Provided\QInteractiveGraphicsView.h"
+#include "Provided/QInteractiveGraphicsView.h"
 
+#include <vector>
+
+#include "FSHeatmap.h"
+#include "FSCore/FSSpatialGrid.h"
+#include "FSCore/FSIdSet.h"
 
 namespace FS
 {
+	class Machine;
+
+	// Hover and selection are answered from a spatial grid over the machine ids
+	// and the selection is a bitset over the same ids, the items' own selection flags are not used.
+	//
+	// left click : select one machine
+	// left click and move : rubber band selection
+	// CTRL + left click : add or remove one machine from the selection
+	//
+	// The heatmap overlay is one image drawn over the scene, see FS::Heatmap.
 	class FactoryView : public QInteractiveGraphicsView
 	{
 		Q_OBJECT
@@ -14,14 +29,53 @@ namespace FS
 		FactoryView(QGraphicsScene * scene, QWidget * parent = nullptr);
 		~FactoryView() = default;
 
+		// machines indexed by their engine id, rebuilds the pick structure
+		void setMachines(std::vector<FS::Machine*> const & machines);
+
+		FS::IdSet const & selection() const { return mSelection; }
+		quint32 hovered() const { return mHovered; }
+
+		// machine outlined as the current bottleneck, FS::SpatialGrid::NoId for none
+		void setBottleneck(quint32 id);
+
+		// engine whose snapshots feed the heatmap
+		void setEngine(FS::Engine const *engine) { mEngine = engine; }
+		FS::HeatMetric heatMetric() const { return mHeatmap.metric(); }
+		void setHeatMetric(FS::HeatMetric metric);
+		// folds the last engine snapshot in the heatmap, once per frame
+		void refreshHeatmap();
+
 	signals:
 		void activeObject(QGraphicsItem *tgt);
+		void hoveredObject(QGraphicsItem *tgt);
+		void selectionChanged();
+		// after setMachines()
+		void machinesChanged();
 
 	protected:
+		virtual void mouseMoveEvent(QMouseEvent *event) override;
+		virtual void mousePressEvent(QMouseEvent *event) override;
 		virtual void mouseReleaseEvent(QMouseEvent *event) override;
+		virtual void paintEvent(QPaintEvent *event) override;
+		virtual void drawForeground(QPainter *painter, QRectF const & rect) override;
 
 	private:
+		quint32 pick(QPoint const & pos) const;
+		QGraphicsItem * item(quint32 id) const;
+		void selectArea(QRect const & area);
+
+		std::vector<FS::Machine*> mMachines;
+		FS::SpatialGrid mPickGrid;
+		FS::IdSet mSelection;
+		quint32 mHovered{ FS::SpatialGrid::NoId };
+		quint32 mBottleneck{ FS::SpatialGrid::NoId };
+
+		FS::Engine const *mEngine{ nullptr };
+		FS::Heatmap mHeatmap;
 
+		bool mPressed{ false };
+		bool mRubberBand{ false };
+		QPoint mPressPos;
 	};
 };
 
@@ -0,0 +1,237 @@
+#include "FSHeatmap.h"
+
+#include <QPolygonF>
+
+#include <algorithm>
+#include <cmath>
+
+#include "FSItems/FSConveyor.h"
+#include "FSItems/FSMachine.h"
+
+namespace
+{
+	// longest side of the image in texels, a texel is never smaller than a scene unit
+	qreal const MaxSide{ 1024.0 };
+	qreal const MinTexel{ 1.0 };
+	// weight of a new snapshot in the smoothed values
+	float const Smoothing{ 0.125f };
+	// opacity of the overlay
+	int const Alpha{ 176 };
+	// conveyor paths are drawn this many texels wide
+	int const PathWidth{ 2 };
+
+	// green (0) to yellow to red (1)
+	QRgb heat(float v)
+	{
+		float const r = v < 0.5f ? 46.0f + v * 2.0f * (250.0f - 46.0f) : 250.0f - (v - 0.5f) * 2.0f * (250.0f - 200.0f);
+		float const g = v < 0.5f ? 160.0f + v * 2.0f * (200.0f - 160.0f) : 200.0f - (v - 0.5f) * 2.0f * (200.0f - 30.0f);
+		float const b = v < 0.5f ? 67.0f - v * 2.0f * (67.0f - 40.0f) : 40.0f - (v - 0.5f) * 2.0f * (40.0f - 30.0f);
+		return qPremultiply(qRgba(qRound(r), qRound(g), qRound(b), Alpha));
+	}
+}
+
+int const FS::Heatmap::Levels;
+quint8 const FS::Heatmap::Unpainted;
+
+FS::Heatmap::Heatmap()
+{
+	for (int i = 0; i < Levels; ++i)
+		mPalette[i] = heat(static_cast<float>(i) / (Levels - 1));
+}
+
+void FS::Heatmap::setMachines(std::vector<FS::Machine*> const & machines)
+{
+	mSpanBegin.assign(1, 0);
+	mSpans.clear();
+	mCapacity.clear();
+
+	QRectF bounds;
+	for (FS::Machine *machine : machines)
+		if (machine)
+			bounds |= machine->sceneBoundingRect();
+	if (bounds.isEmpty())
+	{
+		mImage = QImage();
+		mRect = QRectF();
+		mSpanBegin.assign(machines.size() + 1, 0);
+		clear();
+		return;
+	}
+
+	mTexel = qMax(MinTexel, qMax(bounds.width(), bounds.height()) / MaxSide);
+	int const width = static_cast<int>(std::ceil(bounds.width() / mTexel)) + 1;
+	int const height = static_cast<int>(std::ceil(bounds.height() / mTexel)) + 1;
+	mImage = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+	mRect = QRectF(bounds.topLeft(), QSizeF(width * mTexel, height * mTexel));
+	mStride = static_cast<quint32>(mImage.bytesPerLine() / sizeof(QRgb));
+
+	mSpanBegin.reserve(machines.size() + 1);
+	for (FS::Machine *machine : machines)
+	{
+		if (machine && machine->kind() == FS::MachineKind::Conveyor)
+			addPath(machine->mapToScene(static_cast<FS::Conveyor*>(machine)->path()));
+		else if (machine)
+			addBox(machine->sceneBoundingRect());
+		mSpanBegin.push_back(static_cast<quint32>(mSpans.size()));
+	}
+	resolveOverlaps(machines);
+	clear();
+}
+
+void FS::Heatmap::resolveOverlaps(std::vector<FS::Machine*> const & machines)
+{
+	// owner of each texel, the boxes first then the conveyors over them
+	quint32 const NoOwner{ 0xFFFFFFFF };
+	quint32 const n = static_cast<quint32>(mSpanBegin.size() - 1);
+	std::vector<quint32> owner(static_cast<std::size_t>(mStride) * mImage.height(), NoOwner);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (quint32 id = 0; id < n; ++id)
+		{
+			bool const conveyor = machines[id] && machines[id]->kind() == FS::MachineKind::Conveyor;
+			if (conveyor != (pass == 1))
+				continue;
+			for (quint32 i = mSpanBegin[id]; i < mSpanBegin[id + 1]; ++i)
+				std::fill_n(owner.begin() + mSpans[i].offset, mSpans[i].length, id);
+		}
+	}
+
+	// keep the runs each machine owns, a texel taken is released so a path listing it twice keeps it once
+	std::vector<quint32> begin{ 0 };
+	std::vector<Span> spans;
+	begin.reserve(n + 1);
+	spans.reserve(mSpans.size());
+	for (quint32 id = 0; id < n; ++id)
+	{
+		for (quint32 i = mSpanBegin[id]; i < mSpanBegin[id + 1]; ++i)
+		{
+			quint32 const end = mSpans[i].offset + mSpans[i].length;
+			for (quint32 t = mSpans[i].offset; t < end; )
+			{
+				if (owner[t] != id)
+				{
+					++t;
+					continue;
+				}
+				quint32 const first = t;
+				while (t < end && owner[t] == id)
+					owner[t++] = NoOwner;
+				spans.push_back(Span{ first, t - first });
+			}
+		}
+		begin.push_back(static_cast<quint32>(spans.size()));
+	}
+	mSpanBegin.swap(begin);
+	mSpans.swap(spans);
+}
+
+void FS::Heatmap::addSpan(int x0, int x1, int y)
+{
+	int const width = mImage.width();
+	if (y < 0 || y >= mImage.height() || x1 < 0 || x0 >= width)
+		return;
+	x0 = qMax(0, x0);
+	x1 = qMin(width - 1, x1);
+	mSpans.push_back(Span{ static_cast<quint32>(y) * mStride + static_cast<quint32>(x0), static_cast<quint32>(x1 - x0 + 1) });
+}
+
+void FS::Heatmap::addBox(QRectF const & box)
+{
+	int const x0 = static_cast<int>((box.left() - mRect.left()) / mTexel);
+	int const x1 = static_cast<int>((box.right() - mRect.left()) / mTexel);
+	int const y0 = static_cast<int>((box.top() - mRect.top()) / mTexel);
+	int const y1 = static_cast<int>((box.bottom() - mRect.top()) / mTexel);
+	for (int y = y0; y <= y1; ++y)
+		addSpan(x0, x1, y);
+}
+
+void FS::Heatmap::addPath(QPolygonF const & path)
+{
+	// half a texel between samples, a sample falling on the previous texel adds nothing
+	int lastX = -1, lastY = -1;
+	for (int i = 0; i + 1 < path.size(); ++i)
+	{
+		QPointF const a = (path[i] - mRect.topLeft()) / mTexel;
+		QPointF const b = (path[i + 1] - mRect.topLeft()) / mTexel;
+		int const samples = 1 + static_cast<int>(2.0 * qMax(qAbs(b.x() - a.x()), qAbs(b.y() - a.y())));
+		for (int s = 0; s <= samples; ++s)
+		{
+			QPointF const p = a + (b - a) * (static_cast<qreal>(s) / samples);
+			int const x = static_cast<int>(p.x()) - PathWidth / 2;
+			int const y = static_cast<int>(p.y()) - PathWidth / 2;
+			if (x == lastX && y == lastY)
+				continue;
+			lastX = x;
+			lastY = y;
+			for (int k = 0; k < PathWidth; ++k)
+				addSpan(x, x + PathWidth - 1, y + k);
+		}
+	}
+}
+
+void FS::Heatmap::setMetric(FS::HeatMetric metric)
+{
+	mMetric = metric;
+	clear();
+}
+
+void FS::Heatmap::clear()
+{
+	quint32 const n = static_cast<quint32>(mSpanBegin.size() - 1);
+	mValue.assign(n, 0.0f);
+	mLevel.assign(n, Unpainted);
+	mPrimed = false;
+	if (!mImage.isNull())
+		mImage.fill(Qt::transparent);
+}
+
+bool FS::Heatmap::update(FS::Engine::Snapshot const & snap, FS::Engine const & engine)
+{
+	if (mMetric == FS::HeatMetric::Off || mImage.isNull())
+		return false;
+	if (mPrimed && snap.steps == mLastSteps)
+		return false;
+
+	quint32 const n = qMin(static_cast<quint32>(mValue.size()), static_cast<quint32>(snap.state.size()));
+	if (mMetric == FS::HeatMetric::Queue)
+	{
+		for (quint32 id = static_cast<quint32>(mCapacity.size()); id < n; ++id)
+			mCapacity.push_back(qMax(1u, engine.capacity(id)));
+	}
+
+	// the first snapshot is taken as is, the next ones are smoothed
+	float const weight = mPrimed ? Smoothing : 1.0f;
+	QRgb *bits = reinterpret_cast<QRgb*>(mImage.bits());
+	bool changed = false;
+	for (quint32 id = 0; id < n; ++id)
+	{
+		float sample;
+		switch (mMetric)
+		{
+			case FS::HeatMetric::Queue:
+				sample = qMin(1.0f, static_cast<float>(snap.queue[id]) / mCapacity[id]);
+				break;
+			case FS::HeatMetric::Utilisation:
+				sample = snap.state[id] == FS::MachineState::Working ? 1.0f : 0.0f;
+				break;
+			default:
+				sample = snap.state[id] == FS::MachineState::Blocked ? 1.0f : 0.0f;
+				break;
+		}
+		float &value = mValue[id];
+		value += weight * (sample - value);
+
+		quint8 const level = static_cast<quint8>(value * (Levels - 1) + 0.5f);
+		if (level == mLevel[id])
+			continue;
+		mLevel[id] = level;
+		QRgb const colour = mPalette[level];
+		for (quint32 i = mSpanBegin[id]; i < mSpanBegin[id + 1]; ++i)
+			std::fill_n(bits + mSpans[i].offset, mSpans[i].length, colour);
+		changed = true;
+	}
+
+	mPrimed = true;
+	mLastSteps = snap.steps;
+	return changed;
+}
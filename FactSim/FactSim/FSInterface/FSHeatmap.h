@@ -0,0 +1,98 @@
+#ifndef FS_HEATMAP_H
+#define FS_HEATMAP_H
+
+#include <QImage>
+#include <QRectF>
+#include <QtGlobal>
+
+#include <vector>
+
+#include "FSCore/FSEngine.h"
+
+class QPolygonF;
+
+namespace FS
+{
+	class Machine;
+
+	// machine value coloured by the heatmap
+	enum class HeatMetric : quint8
+	{
+		Off,
+		Queue,			// parts waiting over the capacity of the machine
+		Utilisation,	// share of the frames the machine was working
+		Blocking		// share of the frames the machine was blocked
+	};
+	int const HeatMetricCount{ 4 };
+
+	inline char const * heatMetricName(FS::HeatMetric metric)
+	{
+		static char const * const names[HeatMetricCount] = { "off", "queue", "utilisation", "blocking" };
+		return names[static_cast<int>(metric)];
+	}
+
+	// Colours every machine by a metric of the engine snapshot, in one image laid over the scene.
+	// The texels covered by each machine are listed once when the machines are set (its box, or
+	// its path for a conveyor). A texel covered by several machines belongs to one of them, the
+	// conveyors lie over the boxes and the highest id over its own kind. A frame smooths the snapshot values and only rewrites the texels
+	// of the machines whose colour changed, the graphics items are never touched.
+	// Utilisation and blocking are sampled on each snapshot, like the metric store does.
+	class Heatmap
+	{
+	public:
+		Heatmap();
+		~Heatmap() = default;
+
+		// machines indexed by their engine id, nullptr for ids without graphics item
+		void setMachines(std::vector<FS::Machine*> const & machines);
+
+		FS::HeatMetric metric() const { return mMetric; }
+		// clears the image and the smoothed values
+		void setMetric(FS::HeatMetric metric);
+
+		// folds a snapshot in, true if the image changed
+		bool update(FS::Engine::Snapshot const & snap, FS::Engine const & engine);
+
+		QImage const & image() const { return mImage; }
+		// scene area covered by the image
+		QRectF const & rect() const { return mRect; }
+
+	private:
+		// run of texels on one row of the image
+		struct Span
+		{
+			quint32 offset;
+			quint32 length;
+		};
+
+		static int const Levels{ 64 };
+		static quint8 const Unpainted{ 0xFF };
+
+		void addBox(QRectF const & box);
+		void addPath(QPolygonF const & path);
+		void addSpan(int x0, int x1, int y);
+		void resolveOverlaps(std::vector<FS::Machine*> const & machines);
+		void clear();
+
+		FS::HeatMetric mMetric{ FS::HeatMetric::Off };
+
+		QImage mImage;
+		QRectF mRect;
+		qreal mTexel{ 1.0 };
+		quint32 mStride{ 0 };
+		QRgb mPalette[Levels];
+
+		// spans of machine id: mSpans[mSpanBegin[id] .. mSpanBegin[id + 1]]
+		std::vector<quint32> mSpanBegin{ 0 };
+		std::vector<Span> mSpans;
+
+		// per machine id
+		std::vector<float> mValue;
+		std::vector<quint8> mLevel;
+		std::vector<quint32> mCapacity;
+		bool mPrimed{ false };
+		quint64 mLastSteps{ 0 };
+	};
+};
+
+#endif // FS_HEATMAP_H
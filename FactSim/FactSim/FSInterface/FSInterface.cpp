@@ -9,28 +9,48 @@
 #include <QVBoxLayout>
 
 // Factory Simulator interface packages
+#include "ChartPanel.h"
 #include "FSFactoryView.h"
 #include "FSFactoryScene.h"
 #include "MachineInformation.h"
 #include "MachineParameters.h"
+#include "MachineStatistics.h"
 #include "FactSimStats.h"
-#include "Provided\QInteractiveGraphicsView.h"
+#include "SimulationControl.h"
+#include "Provided/QInteractiveGraphicsView.h"
 
 // Machine package
-#include "FSCore\FSMachine.h"
-#include "FSCore\FSImport.h"
+#include "FSItems/FSMachine.h"
+#include "FSItems/FSImport.h"
+
+// Simulation engine
+#include "FSCore/FSEngine.h"
+#include "FSCore/FSMetricStore.h"
+#include "FSCore/FSScheduler.h"
+#include "FSCore/FSStringPool.h"
+#include "FSCore/FSTimeControl.h"
 
 FS::Interface::Interface(QWidget *parent)
 {
+	// setting the simulation engine, stopped until powered on
+	mEngine.reset(new FS::Engine);
+	mTimeControl.reset(new FS::TimeControl(mEngine.get()));
+
 	// setting timer
 	mTimer = new QTimer(this);
 	connect(mTimer, &QTimer::timeout, this, &FS::Interface::tick);
 	mTimer->start(15);
 	mElapsedTimer.start();
+	mLoadTimer.start();
 
 	// set default power button
 	mPower = new QPushButton(QString("Power On"));
 	mPower->setFixedWidth(200);
+	mPower->setCheckable(true);
+
+	// set default simulation speed
+	mSimControl = new FS::SimulationControl;
+	mSimControl->setFixedWidth(200);
 
 	// set default machine informations
 	mMachineInfo = new FS::MachineInformation;
@@ -41,6 +61,9 @@ FS::Interface::Interface(QWidget *parent)
 	mMachineParam->setFixedWidth(200);
 
 	// set default machine statistics informations
+	mMachineStats = new FS::MachineStatistics;
+	mMachineStats->setFixedWidth(200);
+	mMachineStats->setEngine(mEngine.get());
 
 	// Simulation statistics
 	mSimStats = new FS::FactSimStats;
@@ -49,21 +72,40 @@ FS::Interface::Interface(QWidget *parent)
 	// set up sidepanel layout
 	QVBoxLayout *sidePanel = new QVBoxLayout;
 	sidePanel->addWidget(mPower);
+	sidePanel->addWidget(mSimControl);
 	sidePanel->addWidget(mMachineInfo);
 	sidePanel->addWidget(mMachineParam);
+	sidePanel->addWidget(mMachineStats);
 
 	sidePanel->addWidget(mSimStats);
 	sidePanel->addStretch();
 
 	// set up the interactive view
-	mScene = new QGraphicsScene(0, 0, 1920, 1080);
+	mScene = new FS::FactoryScene(1920, 1080);
 	mView = new FS::FactoryView(mScene);
+	mView->setEngine(mEngine.get());
 	// Scene building function
 	buildDemoScene();
+	// one checkpoint every 10 simulated seconds, an edit at the current time replays at most 10 s, ~10 minutes are kept
+	mEngine->setCheckpointing(static_cast<quint64>(10.0 / mEngine->timeStep()), 64);
+	mMachineParam->setTimeControl(mTimeControl.get());
+	mMachineParam->setEngine(mEngine.get());
+	// one sample per simulated second, older chunks spilled to a temporary file
+	mMetrics.reset(new FS::MetricStore(1.0));
+	mMetrics->enableSpill();
+	mEngine->setMetrics(mMetrics.get());
+	mEngine->setScheduler(&FS::Scheduler::instance());
+
+	// charts under the view
+	mCharts = new FS::ChartPanel;
+	mCharts->setStore(mMetrics.get());
+	QVBoxLayout *mainPanel = new QVBoxLayout;
+	mainPanel->addWidget(mView, 1);
+	mainPanel->addWidget(mCharts);
 
 	// Set up the final layout
 	QHBoxLayout *layout = new QHBoxLayout;
-	layout->addWidget(mView);
+	layout->addLayout(mainPanel);
 	layout->addLayout(sidePanel);
 
 	setLayout(layout);
@@ -71,29 +113,58 @@ FS::Interface::Interface(QWidget *parent)
 	// set connections
 	connect(mView, &FS::FactoryView::activeObject, mMachineInfo, &FS::MachineInformation::activeObject);
 	connect(mView, &FS::FactoryView::activeObject, mMachineParam, &FS::MachineParameters::activeObject);
+	connect(mView, &FS::FactoryView::activeObject, mMachineStats, &FS::MachineStatistics::activeObject);
+	connect(mView, &FS::FactoryView::activeObject, mCharts, &FS::ChartPanel::activeObject);
+	connect(mView, &FS::FactoryView::machinesChanged, mMachineParam, &FS::MachineParameters::rebuildEstimator);
+
+	connect(mPower, &QPushButton::toggled, [this](bool on) {
+		mTimeControl->setRunning(on);
+		mPower->setText(on ? QString("Power Off") : QString("Power On"));
+		mMachineParam->refreshEstimator();
+	});
+	connect(mSimControl, &FS::SimulationControl::modeChanged, [this](int mode) {
+		mTimeControl->setMode(static_cast<FS::TimeControl::Mode>(mode));
+		mMachineParam->refreshEstimator();
+	});
+	connect(mSimControl, &FS::SimulationControl::ratioChanged, [this](double ratio) {
+		mTimeControl->setRatio(ratio);
+	});
+	connect(mSimControl, &FS::SimulationControl::heatMetricChanged, [this](int metric) {
+		mView->setHeatMetric(static_cast<FS::HeatMetric>(metric));
+	});
+	mTimeControl->setRatio(10.0);
+}
+
+FS::Interface::~Interface()
+{
+	// the engine thread must be stopped before the engine goes away
+	mTimeControl.reset();
 }
 
 void FS::Interface::buildDemoScene()
 {
-	FS::Import *tmp1 = new FS::Import(300, 250);
-	tmp1->setName(QString("Test Machine #1"));
-	tmp1->setDescription(QString("This machine is meant to be a test for the pointer of object"));
-	tmp1->setSpeed(0.0f);
-
-	FS::Import *tmp2 = new FS::Import(600, 250);
-	tmp2->setName(QString("Test Machine #2"));
-	tmp2->setDescription(QString("This machine is meant to be a test for the pointer of object"));
-	tmp2->setSpeed(0.0f);
-
-	FS::Import *tmp3 = new FS::Import(150, 250);
-	tmp3->setName(QString("Test Machine #3"));
-	tmp3->setDescription(QString("This machine is meant to be a test for the pointer of object"));
-	tmp3->setSpeed(0.0f);
-
-	// add one import machine
-	mScene->addItem(tmp1);
-	mScene->addItem(tmp2);
-	mScene->addItem(tmp3);
+	std::vector<FS::MachineSpec> specs(3);
+	int const xPos[] = { 300, 600, 150 };
+	FS::StringPool &strings = FS::StringPool::instance();
+	quint32 const description = strings.intern(QString("This machine is meant to be a test for the pointer of object"));
+	for (std::size_t i = 0; i < specs.size(); ++i)
+	{
+		specs[i].kind = FS::MachineKind::Import;
+		specs[i].x = xPos[i];
+		specs[i].y = 250;
+		specs[i].speed = 0.0;
+		specs[i].name = strings.intern(QString("Test Machine #%1").arg(i + 1));
+		specs[i].description = description;
+	}
+
+	// add the import machines
+	std::vector<FS::Machine*> machines = mScene->addMachines(specs);
+	for (FS::Machine *machine : machines)
+	{
+		if (machine)
+			machine->setId(mEngine->addMachine(machine->kind(), machine->speed()));
+	}
+	mView->setMachines(machines);
 	// add one conveyor
 	// add one export machine
 }
@@ -101,7 +172,22 @@ void FS::Interface::buildDemoScene()
 
 void FS::Interface::tick()
 {
-	mScene->update();
+	// the time control skips frames while the engine is catching up
+	if (!mTimeControl->frame())
+		return;
 
-	mSimStats->setFPS(1000.0 / mElapsedTimer.restart());
+	mScene->update();
+	mView->setBottleneck(mEngine->snapshot()->bottleneck);
+	mView->refreshHeatmap();
+
+	mSimStats->setFPS(1000.0 / qMax<qint64>(1, mElapsedTimer.restart()));
+	mSimStats->setSimRate(mTimeControl->simRate());
+	mSimStats->setChartTime(mCharts->lastRefreshTime());
+	// per frame the window would be too short to mean anything
+	if (mLoadTimer.elapsed() >= 500)
+	{
+		mLoadTimer.restart();
+		FS::Scheduler::instance().utilisation(mWorkerLoad);
+		mSimStats->setWorkerLoad(mWorkerLoad);
+	}
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <QWidget>
 #include <QElapsedTimer>
 
+#include <memory>
+#include <vector>
+
 class QGraphicsScene;
 class QGraphicsItem;
 class QPushButton;
@@ -12,6 +15,7 @@ class QTimer;
 
 namespace FS
 {
+	class ChartPanel;
 	class FactoryView;
 	class FactoryScene;
 
@@ -19,6 +23,11 @@ namespace FS
 	class MachineParameters;
 	class MachineStatistics;
 	class FactSimStats;
+	class SimulationControl;
+
+	class Engine;
+	class MetricStore;
+	class TimeControl;
 
 	class Interface : public QWidget
 	{
@@ -26,7 +35,7 @@ namespace FS
 
 	public:
 		Interface(QWidget *parent = nullptr);
-		~Interface() = default;
+		~Interface();
 
 		// This function is specific to this demo since, the scene is hardcoded within the programm
 		// otherwise there would a builder function where the user can add building blocks and shiits
@@ -38,6 +47,7 @@ namespace FS
 	private:
 		// side panel
 		QPushButton *mPower;
+		FS::SimulationControl *mSimControl;
 		FS::MachineInformation *mMachineInfo;
 		FS::MachineParameters *mMachineParam;
 		FS::MachineStatistics *mMachineStats;
@@ -46,11 +56,19 @@ namespace FS
 		// World timer
 		QTimer *mTimer;
 		QElapsedTimer mElapsedTimer;
+		// scheduler utilisation window
+		QElapsedTimer mLoadTimer;
+		std::vector<qreal> mWorkerLoad;
+
+		// simulation, the metrics outlive the engine sampling them
+		std::unique_ptr<FS::MetricStore> mMetrics;
+		std::unique_ptr<FS::Engine> mEngine;
+		std::unique_ptr<FS::TimeControl> mTimeControl;
 
 		// main panel
 		FS::FactoryView *mView;
-		//FS::FactoryScene *mScene;
-		QGraphicsScene *mScene;
+		FS::ChartPanel *mCharts;
+		FS::FactoryScene *mScene;
 	};
 };
 
@@ -3,7 +3,7 @@
 #include <QLabel>
 #include <QGroupBox>
 #include <QGridLayout>
-#include <QHBoxLayout>
+#include <QVBoxLayout>
 
 FS::FactSimStats::FactSimStats(QWidget *parent)
 {
@@ -11,8 +11,26 @@ FS::FactSimStats::FactSimStats(QWidget *parent)
 	mFPS->setAlignment(Qt::AlignRight);
 	mFPS->setFixedWidth(150);
 
-	QHBoxLayout *layout = new QHBoxLayout;
+	// simulated seconds per wall second
+	mSimRate = new QLabel(QString("Sim rate : "));
+	mSimRate->setAlignment(Qt::AlignRight);
+	mSimRate->setFixedWidth(150);
+
+	mChartTime = new QLabel(QString("Charts : "));
+	mChartTime->setAlignment(Qt::AlignRight);
+	mChartTime->setFixedWidth(150);
+
+	// one percentage per worker thread
+	mWorkers = new QLabel(QString("Workers : "));
+	mWorkers->setAlignment(Qt::AlignRight);
+	mWorkers->setFixedWidth(150);
+	mWorkers->setWordWrap(true);
+
+	QVBoxLayout *layout = new QVBoxLayout;
 	layout->addWidget(mFPS);
+	layout->addWidget(mSimRate);
+	layout->addWidget(mChartTime);
+	layout->addWidget(mWorkers);
 	
 	QGroupBox *gb = new QGroupBox(QString("Simulation statistics"));
 	gb->setLayout(layout);
@@ -25,4 +43,28 @@ FS::FactSimStats::FactSimStats(QWidget *parent)
 void FS::FactSimStats::setFPS(qreal fps)
 {
 	mFPS->setText(QString("FPS : %1").arg(fps));
-}
\ No newline at end of file
+}
+
+void FS::FactSimStats::setSimRate(qreal rate)
+{
+	mSimRate->setText(QString("Sim rate : %1 s/s").arg(rate, 0, 'f', 2));
+}
+
+void FS::FactSimStats::setChartTime(qreal ms)
+{
+	mChartTime->setText(QString("Charts : %1 ms").arg(ms, 0, 'f', 3));
+}
+
+void FS::FactSimStats::setWorkerLoad(std::vector<qreal> const & busy)
+{
+	if (busy.empty())
+	{
+		mWorkers->setText(QString("Workers : none"));
+		return;
+	}
+
+	QString text("Workers (%) :");
+	for (qreal b : busy)
+		text += QString(" %1").arg(qRound(b * 100.0));
+	mWorkers->setText(text);
+}
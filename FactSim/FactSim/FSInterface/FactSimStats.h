@@ -3,6 +3,8 @@
 
 #include <QWidget>
 
+#include <vector>
+
 class QLabel;
 
 namespace FS
@@ -16,9 +18,17 @@ namespace FS
 		~FactSimStats() = default;
 	
 		void setFPS(qreal fps);
+		void setSimRate(qreal rate);
+		// time of the last chart refresh, in milliseconds
+		void setChartTime(qreal ms);
+		// share of the time each scheduler worker was busy, in [0, 1]
+		void setWorkerLoad(std::vector<qreal> const & busy);
 
 	private:
 		QLabel *mFPS;
+		QLabel *mSimRate;
+		QLabel *mChartTime;
+		QLabel *mWorkers;
 	};
 };
 
@@ -7,8 +7,7 @@
 
 #include <QGraphicsItem>
 
-#include "FSCore\FSMachine.h"
-#include "FSCore\FSImport.h"
+#include "FSItems/FSMachine.h"
 
 FS::MachineInformation::MachineInformation(QWidget *parent)
 {
@@ -54,47 +53,40 @@ void FS::MachineInformation::activeObject(QGraphicsItem *tgt)
 		return;
 	}
 
-	if (dynamic_cast<FS::Workspace*>(tgt))
-	{
-		if (dynamic_cast<FS::Import*>(tgt))
-		{
-			FS::Import* castedTgt = dynamic_cast<FS::Import*>(tgt);
-			mName->setText(castedTgt->name());
-			mType->setText("Material Import");
-			mDescription->setText(castedTgt->description());
-		}/*
-		else if (dynamic_cast<FS::Export*>(tgt))
-		{
-
-		}
-		else if (dynamic_cast<FS::Transform*>(tgt))
-		{
-
-		}*/
-		else // generic machine
-		{
-			FS::Machine* castedTgt = dynamic_cast<FS::Machine*>(tgt);
-			mName->setText(castedTgt->name());
-			mType->setText("Generic machine");
-			mDescription->setText(castedTgt->description());
-		}
-		
-	}/*
-	else if (dynamic_cast<FS::Transporter*>(tgt))
-	{
-
-	}
-	else if (dynamic_cast<FS::Material*>(tgt))
-	{
-
-	}*/
-	else // unknown object
+	if (tgt->type() != FS::Machine::Type) // unknown object
 	{
 		mName->setText("Unknown object");
 		mType->setText("Unknown object");
 		mDescription->setText("Unknown object");
+		return;
 	}
 
+	FS::Machine* castedTgt = static_cast<FS::Machine*>(tgt);
+	mName->setText(castedTgt->name());
+	mDescription->setText(castedTgt->description());
 
-	
+	switch (castedTgt->kind())
+	{
+		case FS::MachineKind::Import:
+			mType->setText("Material Import");
+			break;
+		case FS::MachineKind::Export:
+			mType->setText("Material Export");
+			break;
+		case FS::MachineKind::Transform:
+			mType->setText("Transformation");
+			break;
+		case FS::MachineKind::Conveyor:
+			mType->setText("Conveyor");
+			break;
+		case FS::MachineKind::Transporter:
+			mType->setText("Transporter");
+			break;
+		case FS::MachineKind::Junction:
+			mType->setText("Junction");
+			break;
+		default: // generic machine
+			mType->setText("Generic machine");
+			break;
+	}
 }
@@ -0,0 +1,169 @@
+#include "MachineStatistics.h"
+
+#include <QLabel>
+#include <QTimer>
+#include <QGroupBox>
+#include <QVBoxLayout>
+#include <QGridLayout>
+
+#include <QGraphicsItem>
+
+#include "FSItems/FSMachine.h"
+
+quint32 const FS::MachineStatistics::NoSelection;
+
+FS::MachineStatistics::MachineStatistics(QWidget *parent)
+{
+	QGroupBox *GroupBox = new QGroupBox;
+	GroupBox->setTitle(QString("Machine's statistics"));
+
+	// machine state
+	mState = new QLabel(QString("State : "));
+	mState->setFixedWidth(150);
+	mState->setFixedHeight(15);
+
+	// parts waiting in front of the machine
+	mQueue = new QLabel(QString("Queue : "));
+	mQueue->setFixedWidth(150);
+	mQueue->setFixedHeight(15);
+
+	// parts done by the machine
+	mCompleted = new QLabel(QString("Completed : "));
+	mCompleted->setFixedWidth(150);
+	mCompleted->setFixedHeight(15);
+
+	// share of the time spent as the bottleneck (sole or shifting)
+	mBottleneck = new QLabel(QString("Bottleneck : "));
+	mBottleneck->setFixedWidth(150);
+	mBottleneck->setFixedHeight(15);
+
+	// grouping in one box
+	QVBoxLayout *layout = new QVBoxLayout;
+	layout->addWidget(mState);
+	layout->addWidget(mQueue);
+	layout->addWidget(mCompleted);
+	layout->addWidget(mBottleneck);
+	layout->addStretch();
+	GroupBox->setLayout(layout);
+
+	// setting the final layout
+	QGridLayout *tmp = new QGridLayout;
+	tmp->addWidget(GroupBox, 0, 0);
+	setLayout(tmp);
+
+	// refresh timer
+	mTimer = new QTimer(this);
+	connect(mTimer, &QTimer::timeout, this, &FS::MachineStatistics::refresh);
+	setRefreshRate(10);
+}
+
+void FS::MachineStatistics::setRefreshRate(int hz)
+{
+	if (hz > 0) // validate rate
+		mTimer->start(1000 / hz);
+}
+
+void FS::MachineStatistics::activeObject(QGraphicsItem *tgt)
+{
+	if (tgt == nullptr || tgt->type() != FS::Machine::Type)
+	{
+		mSelected = NoSelection;
+		clear();
+		return;
+	}
+
+	mSelected = static_cast<FS::Machine*>(tgt)->id();
+	mShown = false;
+	refresh();
+}
+
+void FS::MachineStatistics::clear()
+{
+	mState->setText(QString("State : "));
+	mQueue->setText(QString("Queue : "));
+	mCompleted->setText(QString("Completed : "));
+	mBottleneck->setText(QString("Bottleneck : "));
+	mShown = false;
+}
+
+void FS::MachineStatistics::refresh()
+{
+	if (!mEngine || mSelected == NoSelection)
+		return;
+
+	std::shared_ptr<const FS::Engine::Snapshot> snap = mEngine->snapshot();
+	if (snap->version.size() <= mSelected)
+		return;
+
+	// first display of this machine, every label is written
+	bool const force = !mShown;
+	mShown = true;
+
+	// the bottleneck share moves with the steps and the detector, not with the machine version
+	quint64 const steps = qMax<quint64>(1, snap->steps);
+	quint64 const bottleneck = (snap->soleBottleneck[mSelected] + snap->shiftingBottleneck[mSelected]) * 100 / steps;
+	if (force || bottleneck != mShownBottleneck)
+	{
+		mShownBottleneck = bottleneck;
+		setNumber(mBottleneck, "Bottleneck : ", mShownBottleneck, " %");
+	}
+
+	if (!force && snap->version[mSelected] == mLastVersion)
+		return;
+	mLastVersion = snap->version[mSelected];
+
+	FS::MachineState const state = snap->state[mSelected];
+	if (force || state != mShownState)
+	{
+		mShownState = state;
+		switch (state)
+		{
+			case FS::MachineState::Working:
+				mState->setText(QString("State : working"));
+				break;
+			case FS::MachineState::Blocked:
+				mState->setText(QString("State : blocked"));
+				break;
+			case FS::MachineState::Down:
+				mState->setText(QString("State : down"));
+				break;
+			default:
+				mState->setText(QString("State : idle"));
+				break;
+		}
+	}
+
+	if (force || snap->queue[mSelected] != mShownQueue)
+	{
+		mShownQueue = snap->queue[mSelected];
+		setNumber(mQueue, "Queue : ", mShownQueue);
+	}
+
+	if (force || snap->completed[mSelected] != mShownCompleted)
+	{
+		mShownCompleted = snap->completed[mSelected];
+		setNumber(mCompleted, "Completed : ", mShownCompleted);
+	}
+}
+
+void FS::MachineStatistics::setNumber(QLabel *label, char const *prefix, quint64 value, char const *suffix)
+{
+	// format in the member buffer, without QString::arg temporaries
+	int len = 0;
+	while (*prefix && len < 40)
+		mBuffer[len++] = *prefix++;
+
+	char digits[20];
+	int n = 0;
+	do
+	{
+		digits[n++] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+	while (n > 0)
+		mBuffer[len++] = digits[--n];
+	while (*suffix && len < 63)
+		mBuffer[len++] = *suffix++;
+
+	label->setText(QString::fromLatin1(mBuffer, len));
+}
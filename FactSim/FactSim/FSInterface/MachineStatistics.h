@@ -3,19 +3,62 @@
 
 #include <QWidget>
 
+#include "FSCore/FSEngine.h"
+
+class QLabel;
+class QTimer;
+class QGraphicsItem;
+
 namespace FS
 {
 
+	// Live values of the selected machine.
+	// The panel polls the engine snapshot at a bounded rate and only touches
+	// its labels when the machine's change counter moved, the bottleneck share when its value did.
 	class MachineStatistics : public QWidget
 	{
 		Q_OBJECT
 
+	public slots:
+		void activeObject(QGraphicsItem *tgt);
+
 	public:
 		MachineStatistics(QWidget *parent = nullptr);
 		~MachineStatistics() = default;
 
+		void setEngine(FS::Engine const *engine) { mEngine = engine; }
+		// maximum number of refresh per second
+		void setRefreshRate(int hz);
+
+	private slots:
+		void refresh();
+
 	private:
-		
+		void clear();
+		void setNumber(QLabel *label, char const *prefix, quint64 value, char const *suffix = "");
+
+		FS::Engine const *mEngine{ nullptr };
+
+		static quint32 const NoSelection{ 0xFFFFFFFF };
+		quint32 mSelected{ NoSelection };
+		// no snapshot is kept, it would stop the engine from recycling its buffers
+		bool mShown{ false };
+		quint32 mLastVersion{ 0 };
+
+		// last displayed values, labels are only updated on change
+		FS::MachineState mShownState{ FS::MachineState::Idle };
+		quint32 mShownQueue{ 0 };
+		quint64 mShownCompleted{ 0 };
+		quint64 mShownBottleneck{ 0 };
+
+		// formatting scratch buffer
+		char mBuffer[64];
+
+		QTimer *mTimer;
+		QLabel *mState;
+		QLabel *mQueue;
+		QLabel *mCompleted;
+		QLabel *mBottleneck;
 	};
 };
 
@@ -0,0 +1,135 @@
+#include "MetricChart.h"
+
+#include <QPainter>
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	// room for the caption above the plot
+	int const CaptionHeight{ 14 };
+}
+
+quint32 const FS::MetricChart::NoSeries;
+
+FS::MetricChart::MetricChart(QString const & title, char const *unit, FS::Metric metric, QWidget *parent)
+	: QWidget(parent)
+	, mTitle{ title }
+	, mUnit{ unit }
+	, mMetric{ metric }
+{
+	setMinimumSize(160, 70);
+	// the whole widget is painted
+	setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void FS::MetricChart::setSeries(quint32 id)
+{
+	if (id == mId)
+		return;
+	mId = id;
+	mDirty = true;
+	if (id == NoSeries)
+	{
+		mLine.clear();
+		mCaption = mTitle;
+		mTopLabel.clear();
+		update();
+	}
+}
+
+void FS::MetricChart::resizeEvent(QResizeEvent *event)
+{
+	mDirty = true;
+	QWidget::resizeEvent(event);
+}
+
+void FS::MetricChart::refresh(FS::MetricStore const & store, qreal t0, qreal t1)
+{
+	quint64 const samples = store.sampleCount(mMetric);
+	quint64 const generation = store.generation();
+	if (mId == NoSeries || (!mDirty && samples == mSamples && generation == mGeneration))
+		return;
+	mSamples = samples;
+	mGeneration = generation;
+	mDirty = false;
+
+	int const w = qMax(1, width());
+	store.query(mMetric, mId, t0, t1, static_cast<quint32>(w), mPoints);
+	decimate(t0, t1);
+	update();
+}
+
+void FS::MetricChart::decimate(qreal t0, qreal t1)
+{
+	int const w = qMax(1, width());
+	mColumnMin.assign(w, std::numeric_limits<float>::max());
+	mColumnMax.assign(w, std::numeric_limits<float>::lowest());
+
+	// min and max of each pixel column
+	float top = mFixedTop;
+	qreal const scale = t1 > t0 ? w / (t1 - t0) : 0.0;
+	for (FS::MetricStore::Point const & p : mPoints)
+	{
+		int const x = qBound(0, static_cast<int>((p.time - t0) * scale), w - 1);
+		float const low = mMeans ? p.mean : p.min;
+		float const high = mMeans ? p.mean : p.max;
+		mColumnMin[x] = std::min(mColumnMin[x], low);
+		mColumnMax[x] = std::max(mColumnMax[x], high);
+		if (mFixedTop <= 0.0f)
+			top = std::max(top, high);
+	}
+	if (top <= 0.0f)
+		top = 1.0f;
+
+	// two vertices per column, ordered to continue from the previous column
+	qreal const bottom = height() - 1;
+	qreal const yScale = (height() - CaptionHeight - 2) / static_cast<qreal>(top);
+	mLine.resize(0);
+	mLine.reserve(2 * w);
+	qreal lastY = bottom;
+	for (int x = 0; x < w; ++x)
+	{
+		if (mColumnMin[x] > mColumnMax[x])
+			continue;
+		qreal const yMin = bottom - mColumnMin[x] * yScale;
+		qreal const yMax = bottom - mColumnMax[x] * yScale;
+		if (qAbs(lastY - yMin) <= qAbs(lastY - yMax))
+		{
+			mLine << QPointF(x, yMin);
+			if (yMax != yMin)
+				mLine << QPointF(x, yMax);
+			lastY = yMax;
+		}
+		else
+		{
+			mLine << QPointF(x, yMax);
+			if (yMax != yMin)
+				mLine << QPointF(x, yMin);
+			lastY = yMin;
+		}
+	}
+
+	float const last = mPoints.empty() ? 0.0f : mPoints.back().mean;
+	mCaption = QString("%1 : %2 %3").arg(mTitle).arg(last, 0, 'f', 1).arg(QString::fromLatin1(mUnit));
+	mTopLabel = QString::number(top, 'g', 3);
+}
+
+void FS::MetricChart::paintEvent(QPaintEvent *)
+{
+	QPainter painter(this);
+	painter.fillRect(rect(), Qt::white);
+
+	// frame of the plot
+	painter.setPen(Qt::lightGray);
+	painter.drawRect(0, CaptionHeight, width() - 1, height() - CaptionHeight - 1);
+
+	painter.setPen(QColor(30, 90, 200));
+	painter.drawPolyline(mLine);
+
+	painter.setPen(Qt::black);
+	painter.drawText(2, CaptionHeight - 3, mCaption);
+	painter.setPen(Qt::darkGray);
+	painter.drawText(QRect(0, 0, width() - 2, CaptionHeight), Qt::AlignRight | Qt::AlignVCenter, mTopLabel);
+}
@@ -0,0 +1,65 @@
+#ifndef FS_METRICCHART_H
+#define FS_METRICCHART_H
+
+#include <QWidget>
+#include <QPolygonF>
+
+#include <vector>
+
+#include "FSCore/FSMetricStore.h"
+
+namespace FS
+{
+	// Line chart of one metric series.
+	// The store hands at most one point per pixel column, the chart reduces them to the min and
+	// max of each column so spikes survive, and draws a single polyline of two vertices per column.
+	// Series of states (0 or 1) plot the bucket means instead, their min and max only span 0..1.
+	class MetricChart : public QWidget
+	{
+	public:
+		static quint32 const NoSeries{ 0xFFFFFFFE };
+
+		MetricChart(QString const & title, char const *unit, FS::Metric metric, QWidget *parent = nullptr);
+		~MetricChart() = default;
+
+		// machine id, FS::MetricStore::Factory, or NoSeries to show nothing
+		void setSeries(quint32 id);
+		// fixed top of the vertical axis, 0 to follow the visible maximum
+		void setTop(float top) { mFixedTop = top; }
+		// plots the bucket means rather than their min and max
+		void setMeans(bool means) { mMeans = means; mDirty = true; }
+
+		// pulls the points of [t0, t1], nothing is done if no sample came since the last call
+		void refresh(FS::MetricStore const & store, qreal t0, qreal t1);
+
+	protected:
+		void paintEvent(QPaintEvent *event) override;
+		void resizeEvent(QResizeEvent *event) override;
+
+	private:
+		void decimate(qreal t0, qreal t1);
+
+		QString mTitle;
+		char const *mUnit;
+		FS::Metric mMetric;
+		quint32 mId{ NoSeries };
+		float mFixedTop{ 0.0f };
+		bool mMeans{ false };
+
+		// last pulled state, to skip refreshes without new sample
+		quint64 mSamples{ 0 };
+		quint64 mGeneration{ 0 };
+		bool mDirty{ true };
+
+		// scratch buffers, kept between refreshes
+		std::vector<FS::MetricStore::Point> mPoints;
+		std::vector<float> mColumnMin;
+		std::vector<float> mColumnMax;
+
+		QPolygonF mLine;
+		QString mCaption;
+		QString mTopLabel;
+	};
+};
+
+#endif // FS_METRICCHART_H
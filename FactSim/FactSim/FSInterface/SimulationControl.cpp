@@ -0,0 +1,62 @@
+#include "SimulationControl.h"
+
+#include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QGroupBox>
+#include <QGridLayout>
+#include <QVBoxLayout>
+
+FS::SimulationControl::SimulationControl(QWidget *parent)
+{
+	// speed mode
+	mMode = new QComboBox;
+	mMode->addItem(QString("Real time"));
+	mMode->addItem(QString("N x real time"));
+	mMode->addItem(QString("As fast as possible"));
+	mMode->setFixedWidth(150);
+
+	// time ratio for the N x real time mode
+	mRatio = new QDoubleSpinBox;
+	mRatio->setRange(0.1, 10000.0);
+	mRatio->setValue(10.0);
+	mRatio->setSuffix(QString(" x"));
+	mRatio->setFixedWidth(150);
+	mRatio->setEnabled(false);
+
+	// grouping in one box
+	QVBoxLayout *layout = new QVBoxLayout;
+	layout->addWidget(mMode);
+	layout->addWidget(mRatio);
+
+	QGroupBox *gb = new QGroupBox(QString("Simulation speed"));
+	gb->setLayout(layout);
+
+	// overlay colouring the machines, order matches FS::HeatMetric
+	mHeatMetric = new QComboBox;
+	mHeatMetric->addItem(QString("None"));
+	mHeatMetric->addItem(QString("Queue length"));
+	mHeatMetric->addItem(QString("Utilisation"));
+	mHeatMetric->addItem(QString("Blocking time"));
+	mHeatMetric->setFixedWidth(150);
+
+	QVBoxLayout *heatLayout = new QVBoxLayout;
+	heatLayout->addWidget(mHeatMetric);
+
+	QGroupBox *heat = new QGroupBox(QString("Heatmap"));
+	heat->setLayout(heatLayout);
+
+	QGridLayout *f = new QGridLayout;
+	f->addWidget(gb, 0, 0);
+	f->addWidget(heat, 1, 0);
+	setLayout(f);
+
+	connect(mMode, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &FS::SimulationControl::onModeChanged);
+	connect(mRatio, static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged), this, &FS::SimulationControl::ratioChanged);
+	connect(mHeatMetric, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &FS::SimulationControl::heatMetricChanged);
+}
+
+void FS::SimulationControl::onModeChanged(int index)
+{
+	mRatio->setEnabled(index == Scaled);
+	emit modeChanged(index);
+}
@@ -0,0 +1,38 @@
+#ifndef FS_SIMULATION_CONTROL_H
+#define FS_SIMULATION_CONTROL_H
+
+#include <QWidget>
+
+class QComboBox;
+class QDoubleSpinBox;
+
+namespace FS
+{
+	class SimulationControl : public QWidget
+	{
+		Q_OBJECT
+
+	public:
+		// order matches FS::TimeControl::Mode
+		enum SpeedMode { RealTime, Scaled, MaxSpeed };
+
+		SimulationControl(QWidget *parent = nullptr);
+		~SimulationControl() = default;
+
+	signals:
+		void modeChanged(int mode);
+		void ratioChanged(double ratio);
+		// index of an FS::HeatMetric
+		void heatMetricChanged(int metric);
+
+	private slots:
+		void onModeChanged(int index);
+
+	private:
+		QComboBox *mMode;
+		QDoubleSpinBox *mRatio;
+		QComboBox *mHeatMetric;
+	};
+};
+
+#endif // FS_SIMULATION_CONTROL_H
@@ -0,0 +1,27 @@
+#include "FSConveyor.h"
+
+#include <QPainter>
+
+#include "Provided/QPathBuilder.h"
+
+FS::Conveyor::Conveyor(int XPos, int YPos, QPathBuilder const & path)
+	: Transporter(FS::MachineKind::Conveyor), mLength{ path.length() }
+{
+	mPath.reserve(path.count());
+	for (QPointF const & p : path.points())
+		mPath.append(p + QPointF(XPos, YPos));
+}
+
+QRectF FS::Conveyor::boundingRect() const
+{
+	qreal penWidth = 5;
+	return mPath.boundingRect().adjusted(-penWidth, -penWidth, penWidth, penWidth);
+}
+
+void FS::Conveyor::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+	Q_UNUSED(option);
+	Q_UNUSED(widget);
+
+	painter->drawPolyline(mPath);
+}
@@ -0,0 +1,33 @@
+#ifndef FS_CONVEYOR_H
+#define FS_CONVEYOR_H
+
+#include "FSTransporter.h"
+
+#include <QPolygonF>
+
+class QPathBuilder;
+
+namespace FS
+{
+	class Conveyor : public FS::Transporter
+	{
+	public:
+		Conveyor() : Transporter(FS::MachineKind::Conveyor) {};
+		// the path starts at (XPos, YPos)
+		Conveyor(int XPos, int YPos, QPathBuilder const & path);
+		~Conveyor() = default;
+
+		qreal length() const { return mLength; }
+		// in item coordinates
+		QPolygonF const & path() const { return mPath; }
+
+		virtual QRectF boundingRect() const override;
+		virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+	private:
+		QPolygonF mPath;
+		qreal mLength{ 0.0 };
+	};
+};
+
+#endif // FS_CONVEYOR_H
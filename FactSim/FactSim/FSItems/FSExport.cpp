@@ -0,0 +1,6 @@
+#include "FSExport.h"
+
+FS::Export::Export(int XPos, int YPos)
+	: FS::Workspace(FS::MachineKind::Export, XPos, YPos, 20, 20)
+{
+}
@@ -0,0 +1,17 @@
+#ifndef FS_EXPORT_H
+#define FS_EXPORT_H
+
+#include "FSWorkspace.h"
+
+namespace FS
+{
+	class Export : public Workspace
+	{
+	public:
+		Export() : Export(0, 0) {};
+		Export(int XPos, int YPos);
+		~Export() = default;
+	};
+};
+
+#endif // FS_EXPORT_H
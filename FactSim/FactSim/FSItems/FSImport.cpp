@@ -1,7 +1,7 @@
 #include "FSImport.h"
 
 FS::Import::Import(int XPos, int YPos)
-	: FS::Workspace(XPos, YPos)
+	: FS::Workspace(FS::MachineKind::Import, XPos, YPos, 20, 20)
 {
 }
 
@@ -8,7 +8,7 @@ namespace FS
 	class Import : public Workspace
 	{
 	public:
-		Import() = default;
+		Import() : Import(0, 0) {};
 		Import(int XPos, int YPos);
 		~Import() = default;
 
@@ -0,0 +1,17 @@
+#include "FSMachine.h"
+
+void FS::Machine::setSpeed(qreal s)
+{
+	// same range as the engine, a negative speed stops the machine
+	mSpeed = qMax<qreal>(0.0, s);
+}
+
+void FS::Machine::setName(QString const & n)
+{
+	mName = FS::StringPool::instance().intern(n);
+}
+
+void FS::Machine::setDescription(QString const & d)
+{
+	mDescription = FS::StringPool::instance().intern(d);
+}
\ No newline at end of file
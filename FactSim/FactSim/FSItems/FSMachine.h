@@ -0,0 +1,48 @@
+#ifndef FS_MACHINE_H
+#define FS_MACHINE_H
+
+#include <QGraphicsItem>
+#include <QtMath>
+
+#include "FSCore/FSMachineKind.h"
+#include "FSCore/FSStringPool.h"
+
+namespace FS
+{
+	class Machine : public QGraphicsItem
+	{
+	public:
+		// every machine shares one graphics item type, the kind tells them apart
+		enum { Type = UserType + 1 };
+
+		Machine() = default;
+		explicit Machine(FS::MachineKind kind) : mKind{ kind } {};
+		virtual ~Machine() = default;
+
+		virtual int type() const override { return Type; }
+		FS::MachineKind kind() const { return mKind; }
+
+		void setSpeed(qreal s);
+		// name and description are handles in FS::StringPool::instance()
+		void setName(quint32 n) { mName = n; }
+		void setDescription(quint32 d) { mDescription = d; }
+		void setName(QString const & n);
+		void setDescription(QString const & d);
+		void setId(quint32 id) { mId = id; }
+
+		qreal speed() { return mSpeed; }
+		QString const & name() const { return FS::StringPool::instance().string(mName); }
+		QString const & description() const { return FS::StringPool::instance().string(mDescription); }
+		// dense engine id, valid once the machine is registered in the FS::Engine
+		quint32 id() const { return mId; }
+
+	private:
+		FS::MachineKind mKind{ FS::MachineKind::Workspace };
+		quint32 mId{ 0 };
+		qreal mSpeed{ 0.0 };
+		quint32 mName{ FS::StringPool::Empty };
+		quint32 mDescription{ FS::StringPool::Empty };
+	};
+};
+
+#endif // FS_MACHINE_H
@@ -0,0 +1,6 @@
+#include "FSTransform.h"
+
+FS::Transform::Transform(int XPos, int YPos)
+	: FS::Workspace(FS::MachineKind::Transform, XPos, YPos, 20, 20)
+{
+}
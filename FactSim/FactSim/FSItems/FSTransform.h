@@ -0,0 +1,17 @@
+#ifndef FS_TRANSFORM_H
+#define FS_TRANSFORM_H
+
+#include "FSWorkspace.h"
+
+namespace FS
+{
+	class Transform : public Workspace
+	{
+	public:
+		Transform() : Transform(0, 0) {};
+		Transform(int XPos, int YPos);
+		~Transform() = default;
+	};
+};
+
+#endif // FS_TRANSFORM_H
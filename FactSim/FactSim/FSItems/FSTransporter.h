@@ -8,9 +8,12 @@ namespace FS
 	class Transporter : public FS::Machine
 	{
 	public:
-		Transporter() = default;
+		Transporter() : Machine(FS::MachineKind::Transporter) {};
 		~Transporter() = default;
 
+	protected:
+		explicit Transporter(FS::MachineKind kind) : Machine(kind) {};
+
 	private:
 
 	};
@@ -3,7 +3,13 @@
 #include <QPainter>
 
 FS::Workspace::Workspace(int XPos, int YPos, int Width, int Height)
-	: mXPos{ XPos }, mYPos{ YPos }, mWidth{ Width }, mHeight{ Height }
+	: Workspace(FS::MachineKind::Workspace, XPos, YPos, Width, Height)
+{
+
+}
+
+FS::Workspace::Workspace(FS::MachineKind kind, int XPos, int YPos, int Width, int Height)
+	: Machine(kind), mXPos{ XPos }, mYPos{ YPos }, mWidth{ Width }, mHeight{ Height }
 {
 
 }
@@ -16,5 +22,8 @@ QRectF FS::Workspace::boundingRect() const
 
 void FS::Workspace::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
+	Q_UNUSED(option);
+	Q_UNUSED(widget);
+
 	painter->drawRect(mXPos, mYPos, 20, 20);
 }
\ No newline at end of file
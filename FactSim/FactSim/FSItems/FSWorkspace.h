@@ -17,6 +17,8 @@ namespace FS
 		virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
 
 	protected:
+		Workspace(FS::MachineKind kind, int XPos, int YPos, int Width, int Height);
+
 		int mXPos;
 		int mYPos;
 		int mWidth;
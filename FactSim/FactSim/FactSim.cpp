@@ -1,6 +1,6 @@
 #include "FactSim.h"
 
-#include "FSInterface\FSInterface.h"
+#include "FSInterface/FSInterface.h"
 
 FactSim::FactSim(QWidget *parent)
 	: QMainWindow(parent)
@@ -5,11 +5,13 @@
 #include <QGroupBox>
 #include <QVBoxLayout>
 #include <QGridLayout>
+#include <QSignalBlocker>
 
 #include <QGraphicsItem>
 
-#include "FSCore\FSMachine.h"
-#include "FSCore\FSImport.h"
+#include "FSCore/FSEngine.h"
+#include "FSCore/FSTimeControl.h"
+#include "FSItems/FSMachine.h"
 
 FS::MachineParameters::MachineParameters(QWidget *parent)
 {
@@ -27,58 +29,103 @@ FS::MachineParameters::MachineParameters(QWidget *parent)
 	mSpeed->setFixedWidth(150);
 	mSpeed->setOrientation(Qt::Horizontal);
 
+	// analytic prediction
+	mLineRate = new QLabel;
+	mBottleneck = new QLabel;
+	mUtilisation = new QLabel;
+
 	// grouping in one box
 	QVBoxLayout *layout = new QVBoxLayout;
 	layout->addWidget(speedLabel);
 	layout->addWidget(mSpeed);
+	layout->addWidget(mLineRate);
+	layout->addWidget(mBottleneck);
+	layout->addWidget(mUtilisation);
 	GroupBox->setLayout(layout);
 
 	// setting the final layout
 	QGridLayout *tmp = new QGridLayout;
 	tmp->addWidget(GroupBox, 0, 0);
 	setLayout(tmp);
+
+	connect(mSpeed, &QSlider::valueChanged, this, &FS::MachineParameters::speedChanged);
+}
+
+void FS::MachineParameters::setEngine(FS::Engine *engine)
+{
+	mEngine = engine;
+	rebuildEstimator();
+}
+
+void FS::MachineParameters::rebuildEstimator()
+{
+	// the engine thread writes the topology while it steps
+	if (mEngine && mTimeControl && mTimeControl->isThreaded())
+	{
+		mStale = true;
+		return;
+	}
+	if (mEngine)
+	{
+		mEngine->updateTopology();
+		mEstimator.build(*mEngine);
+	}
+	mStale = false;
+	updatePrediction();
 }
 
 void FS::MachineParameters::activeObject(QGraphicsItem *tgt)
 {
-	if (!tgt)
+	// showing a machine is not an edit
+	QSignalBlocker blocker(mSpeed);
+
+	if (!tgt || tgt->type() != FS::Machine::Type) // no or unknown object
 	{
+		mMachine = nullptr;
 		mSpeed->setValue(0);
+		updatePrediction();
 		return;
 	}
 
-	if (dynamic_cast<FS::Workspace*>(tgt))
+	mMachine = static_cast<FS::Machine*>(tgt);
+	mSpeed->setValue(static_cast<int>(mMachine->speed()));
+	updatePrediction();
+}
+
+void FS::MachineParameters::speedChanged(int speed)
+{
+	if (!mMachine)
+		return;
+
+	mMachine->setSpeed(speed);
+	if (mEngine && mMachine->id() < mEstimator.machineCount())
 	{
-		if (dynamic_cast<FS::Import*>(tgt))
-		{
-			FS::Import* castedTgt = dynamic_cast<FS::Import*>(tgt);
-			mSpeed->setValue(static_cast<int>(castedTgt->speed()));
-		}/*
-		 else if (dynamic_cast<FS::Export*>(tgt))
-		 {
-
-		 }
-		 else if (dynamic_cast<FS::Transform*>(tgt))
-		 {
-
-		 }*/
-		/*else // generic machine
-		{
-			FS::Machine* castedTgt = dynamic_cast<FS::Machine*>(tgt);
-			mSpeed->setValue(castedTgt->speed());
-		}*/
-
-	}/*
-	 else if (dynamic_cast<FS::Transporter*>(tgt))
-	 {
-
-	 }
-	 else if (dynamic_cast<FS::Material*>(tgt))
-	 {
-
-	 }*/
-	else // unknown object
+		// applies from the time shown, only the steps since the last checkpoint before it are replayed
+		mEngine->setSpeedSince(mMachine->id(), speed, mEngine->snapshot()->simTime);
+		mEstimator.setSpeed(mMachine->id(), speed);
+	}
+	updatePrediction();
+}
+
+void FS::MachineParameters::updatePrediction()
+{
+	if (mEstimator.machineCount() == 0)
 	{
-		mSpeed->setValue(0);
+		mLineRate->clear();
+		mBottleneck->clear();
+		mUtilisation->clear();
+		return;
 	}
+
+	FS::ThroughputEstimator::Estimate const e = mEstimator.solve();
+	mLineRate->setText(QString("Predicted rate: %1 parts/min").arg(e.throughput, 0, 'f', 1));
+	if (e.bottleneck == FS::ThroughputEstimator::NoMachine)
+		mBottleneck->setText(QString("Bottleneck: none"));
+	else
+		mBottleneck->setText(QString("Bottleneck: #%1 (%2 %)").arg(e.bottleneck).arg(qRound(e.bottleneckUtilisation * 100.0)));
+
+	if (mMachine && mMachine->id() < mEstimator.machineCount())
+		mUtilisation->setText(QString("Utilisation: %1 %").arg(qRound(mEstimator.utilisation(mMachine->id()) * 100.0)));
+	else
+		mUtilisation->clear();
 }
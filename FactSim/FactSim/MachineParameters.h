@@ -3,6 +3,8 @@
 
 #include <QWidget>
 
+#include "FSCore/FSThroughputEstimator.h"
+
 class QLabel;
 class QSlider;
 class QGroupBox;
@@ -10,7 +12,9 @@ class QGraphicsItem;
 
 namespace FS
 {
+	class Engine;
 	class Machine;
+	class TimeControl;
 
 	class MachineParameters : public QWidget
 	{
@@ -23,8 +27,36 @@ namespace FS
 		MachineParameters(QWidget *parent = nullptr);
 		~MachineParameters() = default;
 
+		// speed edits are forwarded to the engine as retroactive edits, the predicted line rate
+		// is solved analytically on each slider move
+		void setEngine(FS::Engine *engine);
+		// the estimator is only rebuilt while the time control does not step the engine on its thread
+		void setTimeControl(FS::TimeControl const *control) { mTimeControl = control; }
+
+	public slots:
+		// copies the engine topology and speeds again, after the machines or links changed,
+		// deferred while the engine steps on another thread
+		void rebuildEstimator();
+		// runs a deferred rebuild once the engine thread stopped
+		void refreshEstimator() { if (mStale) rebuildEstimator(); }
+
+	private slots:
+		void speedChanged(int speed);
+
 	private:
+		void updatePrediction();
+
+		FS::Engine *mEngine{ nullptr };
+		FS::TimeControl const *mTimeControl{ nullptr };
+		FS::ThroughputEstimator mEstimator;
+		// a rebuild was deferred
+		bool mStale{ false };
+		FS::Machine *mMachine{ nullptr };
+
 		QSlider *mSpeed;
+		QLabel *mLineRate;
+		QLabel *mBottleneck;
+		QLabel *mUtilisation;
 	};
 };
 
@@ -0,0 +1,188 @@
+#include "FSFactoryGenerator.h"
+
+#include <QtMath>
+
+#include "FSCore/FSEngine.h"
+#include "FSItems/FSImport.h"
+#include "FSItems/FSWorkspace.h"
+#include "FSItems/FSConveyor.h"
+#include "Provided/QPathBuilder.h"
+
+namespace
+{
+	// layout pitch between two stations
+	int const Pitch{ 60 };
+	int const StationsPerRow{ 100 };
+	qreal const ImportSpeed{ 60.0 };
+	qreal const ConveyorSpeed{ 50.0 };
+
+	// deterministic spread of station speeds (parts per minute)
+	qreal stationSpeed(quint32 id) { return 30.0 + (id * 7919u) % 60u; }
+}
+
+FS::FactoryGenerator::FactoryGenerator(FS::Engine & engine)
+	: mEngine(engine)
+{
+
+}
+
+QString FS::FactoryGenerator::shapeName(Shape shape)
+{
+	switch (shape)
+	{
+		case Shape::FanOut:
+			return QString("fanout");
+		case Shape::Mesh:
+			return QString("mesh");
+		case Shape::Loop:
+			return QString("loop");
+		default:
+			return QString("serial");
+	}
+}
+
+bool FS::FactoryGenerator::shapeFromName(QString const & name, Shape & shape)
+{
+	Shape const all[] = { Shape::Serial, Shape::FanOut, Shape::Mesh, Shape::Loop };
+	for (Shape s : all)
+	{
+		if (name.compare(shapeName(s), Qt::CaseInsensitive) == 0)
+		{
+			shape = s;
+			return true;
+		}
+	}
+	return false;
+}
+
+void FS::FactoryGenerator::generate(Shape shape, quint32 count)
+{
+	mItems.reserve(mItems.size() + count);
+	switch (shape)
+	{
+		case Shape::FanOut:
+			generateFanOut(count);
+			break;
+		case Shape::Mesh:
+			generateMesh(count);
+			break;
+		case Shape::Loop:
+			generateLoop(count);
+			break;
+		default:
+			generateSerial(count);
+			break;
+	}
+}
+
+quint32 FS::FactoryGenerator::addImport(int x, int y)
+{
+	FS::Import *machine = new FS::Import(x, y);
+	machine->setSpeed(ImportSpeed);
+	machine->setId(mEngine.addMachine(machine->kind(), machine->speed()));
+	mItems.emplace_back(machine);
+	return machine->id();
+}
+
+quint32 FS::FactoryGenerator::addWorkspace(int x, int y)
+{
+	FS::Workspace *machine = new FS::Workspace(x, y);
+	machine->setSpeed(stationSpeed(mEngine.machineCount()));
+	machine->setId(mEngine.addMachine(machine->kind(), machine->speed()));
+	mItems.emplace_back(machine);
+	return machine->id();
+}
+
+quint32 FS::FactoryGenerator::addConveyor(int x, int y, qreal length)
+{
+	QPathBuilder path;
+	path.addLinear(length);
+
+	FS::Conveyor *machine = new FS::Conveyor(x, y, path);
+	machine->setSpeed(ConveyorSpeed);
+	machine->setId(mEngine.addMachine(machine->kind(), machine->speed()));
+	mEngine.setConveyorLength(machine->id(), machine->length());
+	mItems.emplace_back(machine);
+	return machine->id();
+}
+
+void FS::FactoryGenerator::link(quint32 from, quint32 to)
+{
+	mEngine.connect(from, to);
+}
+
+void FS::FactoryGenerator::generateSerial(quint32 count)
+{
+	quint32 previous = addImport(0, 0);
+	for (quint32 k = 1; k + 1 < count; k += 2)
+	{
+		int const x = (k / 2 % StationsPerRow) * Pitch;
+		int const y = (k / 2 / StationsPerRow) * Pitch;
+		quint32 const conveyor = addConveyor(x + 25, y + 10, Pitch - 25);
+		quint32 const station = addWorkspace(x + Pitch, y);
+		link(previous, conveyor);
+		link(conveyor, station);
+		previous = station;
+	}
+}
+
+void FS::FactoryGenerator::generateFanOut(quint32 count)
+{
+	quint32 const source = addImport(0, 0);
+	quint32 const feeder = addConveyor(25, 10, Pitch - 25);
+	link(source, feeder);
+
+	for (quint32 k = 2; k < count; ++k)
+	{
+		int const x = Pitch + ((k - 2) % StationsPerRow) * Pitch;
+		int const y = ((k - 2) / StationsPerRow) * Pitch;
+		link(feeder, addWorkspace(x, y));
+	}
+}
+
+void FS::FactoryGenerator::generateMesh(quint32 count)
+{
+	quint32 const side = qMax<quint32>(2, static_cast<quint32>(qCeil(qSqrt(count))));
+	std::vector<quint32> above(side, FS::Engine::NoMachine);
+
+	quint32 n = 0;
+	for (quint32 r = 0; n < count; ++r)
+	{
+		quint32 left = FS::Engine::NoMachine;
+		for (quint32 c = 0; c < side && n < count; ++c, ++n)
+		{
+			int const x = c * Pitch;
+			int const y = r * Pitch;
+			quint32 const id = c == 0 ? addImport(x, y) : addWorkspace(x, y);
+			if (left != FS::Engine::NoMachine)
+				link(left, id);
+			if (c > 0 && above[c] != FS::Engine::NoMachine)
+				link(above[c], id);
+			left = id;
+			above[c] = id;
+		}
+	}
+}
+
+void FS::FactoryGenerator::generateLoop(quint32 count)
+{
+	quint32 const source = addImport(0, 0);
+	quint32 first = FS::Engine::NoMachine;
+	quint32 previous = source;
+	for (quint32 k = 1; k + 1 < count; k += 2)
+	{
+		int const x = (k / 2 % StationsPerRow) * Pitch;
+		int const y = Pitch + (k / 2 / StationsPerRow) * Pitch;
+		quint32 const station = addWorkspace(x, y);
+		quint32 const conveyor = addConveyor(x + 25, y + 10, Pitch - 25);
+		link(previous, station);
+		link(station, conveyor);
+		if (first == FS::Engine::NoMachine)
+			first = station;
+		previous = conveyor;
+	}
+
+	// close the ring
+	if (first != FS::Engine::NoMachine)
+		link(previous, first);
+}
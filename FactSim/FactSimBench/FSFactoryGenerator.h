@@ -0,0 +1,55 @@
+#ifndef FS_FACTORY_GENERATOR_H
+#define FS_FACTORY_GENERATOR_H
+
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+namespace FS
+{
+	class Engine;
+	class Machine;
+
+	// Procedural factories for the benchmarks.
+	// The generator builds the graphics items (imports, workspaces, conveyors on QPathBuilder paths)
+	// and registers them, with their links, in the given engine.
+	class FactoryGenerator
+	{
+	public:
+		enum class Shape
+		{
+			Serial,		// import, then conveyor and workspace pairs in a single line
+			FanOut,		// one import and one conveyor feeding every workspace
+			Mesh,		// grid of workspaces fed by a column of imports, each feeding right and down
+			Loop		// one import feeding a ring of conveyor and workspace pairs
+		};
+
+		FactoryGenerator(FS::Engine & engine);
+		~FactoryGenerator() = default;
+
+		static QString shapeName(Shape shape);
+		static bool shapeFromName(QString const & name, Shape & shape);
+
+		// generates about count machines, conveyors included
+		void generate(Shape shape, quint32 count);
+
+		std::vector<std::unique_ptr<FS::Machine>> & items() { return mItems; }
+
+	private:
+		void generateSerial(quint32 count);
+		void generateFanOut(quint32 count);
+		void generateMesh(quint32 count);
+		void generateLoop(quint32 count);
+
+		quint32 addImport(int x, int y);
+		quint32 addWorkspace(int x, int y);
+		quint32 addConveyor(int x, int y, qreal length);
+		void link(quint32 from, quint32 to);
+
+		FS::Engine & mEngine;
+		std::vector<std::unique_ptr<FS::Machine>> mItems;
+	};
+};
+
+#endif // FS_FACTORY_GENERATOR_H
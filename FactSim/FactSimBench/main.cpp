@@ -0,0 +1,458 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+#include <random>
+
+#include "FSFactoryGenerator.h"
+
+#include "FSCore/FSDispatcher.h"
+#include "FSCore/FSEngine.h"
+#include "FSCore/FSOutage.h"
+#include "FSCore/FSRandom.h"
+#include "FSCore/FSReservationTable.h"
+#include "FSCore/FSRouter.h"
+#include "FSInterface/FSHeatmap.h"
+#include "FSItems/FSMachine.h"
+
+// Factory Simulator benchmark
+// Generates factories of every requested shape and size, then measures
+// the load time, the resident memory growth, the tick throughput and the heatmap overlay frame
+// update, optionally again with breakdowns on every workspace to measure their cost.
+// Fleets of transport vehicles are measured apart, on a square grid of two way aisles.
+// With --check-replay the benchmarks are replaced by a check that the downstream replay of a
+// retroactive edit gives the same factory state as a full replay.
+// Results are written as JSON so successive runs can be compared.
+
+namespace
+{
+	quint64 residentBytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS pmc;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+			return pmc.WorkingSetSize;
+		return 0;
+#else
+		unsigned long size = 0, resident = 0;
+		FILE *f = std::fopen("/proc/self/statm", "r");
+		if (!f)
+			return 0;
+		if (std::fscanf(f, "%lu %lu", &size, &resident) != 2)
+			resident = 0;
+		std::fclose(f);
+		return static_cast<quint64>(resident) * sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	// the same factory where every workspace breaks down, mean tick in microseconds
+	qreal outageTick(FS::FactoryGenerator::Shape shape, quint32 count, quint64 steps, qreal timeStep, qreal mtbf)
+	{
+		FS::Engine engine(timeStep);
+		FS::FactoryGenerator generator(engine);
+		generator.generate(shape, count);
+		FS::OutageModel model;
+		model.mtbf = mtbf;
+		model.mttr = mtbf / 10.0;
+		for (quint32 id = 0; id < engine.machineCount(); ++id)
+		{
+			if (engine.kind(id) == FS::MachineKind::Workspace)
+				engine.setOutages(id, model);
+		}
+		engine.updateTopology();
+
+		QElapsedTimer timer;
+		timer.start();
+		for (quint64 i = 0; i < steps; ++i)
+			engine.step();
+		return qMax<qint64>(1, timer.nsecsElapsed()) * 1e-3 / qMax<quint64>(1, steps);
+	}
+
+	// mean heatmap frame update in milliseconds, a utilisation frame every 10 steps
+	qreal heatmapFrame(FS::Engine & engine, FS::FactoryGenerator & generator, quint64 steps)
+	{
+		std::vector<FS::Machine*> machines(engine.machineCount(), nullptr);
+		for (std::unique_ptr<FS::Machine> const & item : generator.items())
+			machines[item->id()] = item.get();
+		FS::Heatmap heatmap;
+		heatmap.setMachines(machines);
+		heatmap.setMetric(FS::HeatMetric::Utilisation);
+
+		quint64 const frames = qMax<quint64>(1, steps / 10);
+		qint64 updateNs = 0;
+		QElapsedTimer timer;
+		for (quint64 f = 0; f < frames; ++f)
+		{
+			for (int i = 0; i < 10; ++i)
+				engine.step();
+			engine.publish();
+			std::shared_ptr<const FS::Engine::Snapshot> const snap = engine.snapshot();
+			timer.start();
+			heatmap.update(*snap, engine);
+			updateNs += timer.nsecsElapsed();
+		}
+		return updateNs * 1e-6 / frames;
+	}
+
+	// the same retroactive edit of a workspace in the middle of the factory, replayed downstream
+	// in one engine and fully in the other, then both engines compared machine by machine
+	QJsonObject checkReplay(FS::FactoryGenerator::Shape shape, quint32 count, quint64 steps, qreal timeStep)
+	{
+		FS::Engine downstream(timeStep);
+		FS::Engine full(timeStep);
+		FS::FactoryGenerator downstreamGenerator(downstream);
+		FS::FactoryGenerator fullGenerator(full);
+		downstreamGenerator.generate(shape, count);
+		fullGenerator.generate(shape, count);
+		full.setDownstreamReplay(false);
+		quint64 const interval = qMax<quint64>(1, steps / 10);
+		for (FS::Engine *engine : { &downstream, &full })
+		{
+			engine->setCheckpointing(interval, 16);
+			engine->updateTopology();
+			for (quint64 i = 0; i < steps; ++i)
+				engine->step();
+		}
+
+		quint32 const n = downstream.machineCount();
+		quint32 id = n / 2;
+		while (id < n && downstream.kind(id) != FS::MachineKind::Workspace)
+			++id;
+		quint32 replayed = 0;
+		if (id < n)
+		{
+			// from the middle of the history, a few checkpoints back
+			qreal const since = downstream.simTime() - (interval * 2.5) * timeStep;
+			qreal const speed = downstream.speed(id) * 0.5;
+			for (FS::Engine *engine : { &downstream, &full })
+			{
+				engine->setSpeedSince(id, speed, since);
+				engine->step();
+			}
+			replayed = downstream.lastReplayCount();
+			for (FS::Engine *engine : { &downstream, &full })
+			{
+				for (quint64 i = 0; i < steps / 4; ++i)
+					engine->step();
+			}
+		}
+
+		quint32 differences = 0;
+		for (quint32 m = 0; m < n; ++m)
+		{
+			if (downstream.queue(m) != full.queue(m) || downstream.completed(m) != full.completed(m) || downstream.state(m) != full.state(m))
+				++differences;
+		}
+
+		QJsonObject result;
+		result["shape"] = FS::FactoryGenerator::shapeName(shape);
+		result["machines"] = static_cast<qint64>(n);
+		result["edited"] = id < n ? static_cast<qint64>(id) : -1;
+		result["replayed"] = static_cast<qint64>(replayed);
+		result["differences"] = static_cast<qint64>(differences);
+		return result;
+	}
+
+	QJsonObject runOne(FS::FactoryGenerator::Shape shape, quint32 count, quint64 steps, qreal timeStep, qreal mtbf)
+	{
+		quint64 const memoryBefore = residentBytes();
+		QElapsedTimer timer;
+
+		// load
+		timer.start();
+		FS::Engine engine(timeStep);
+		FS::FactoryGenerator generator(engine);
+		generator.generate(shape, count);
+		engine.updateTopology();
+		qint64 const loadNs = timer.nsecsElapsed();
+		quint64 const memoryAfter = residentBytes();
+
+		// ticks
+		timer.restart();
+		for (quint64 i = 0; i < steps; ++i)
+			engine.step();
+		qint64 const tickNs = qMax<qint64>(1, timer.nsecsElapsed());
+
+		qreal const seconds = tickNs * 1e-9;
+		QJsonObject result;
+		result["shape"] = FS::FactoryGenerator::shapeName(shape);
+		result["machines"] = static_cast<qint64>(engine.machineCount());
+		result["links"] = static_cast<qint64>(engine.linkCount());
+		result["load_ms"] = loadNs * 1e-6;
+		result["memory_bytes"] = static_cast<qint64>(memoryAfter > memoryBefore ? memoryAfter - memoryBefore : 0);
+		result["steps"] = static_cast<qint64>(steps);
+		result["tick_us"] = tickNs * 1e-3 / qMax<quint64>(1, steps);
+		result["steps_per_s"] = steps / seconds;
+		result["machine_steps_per_s"] = steps * static_cast<qreal>(engine.machineCount()) / seconds;
+		result["sim_s_per_wall_s"] = engine.simTime() / seconds;
+		result["heatmap_ms"] = heatmapFrame(engine, generator, steps);
+		if (mtbf > 0.0)
+		{
+			qreal const outageUs = outageTick(shape, count, steps, timeStep, mtbf);
+			result["tick_us_outages"] = outageUs;
+			result["outage_overhead"] = outageUs / result["tick_us"].toDouble() - 1.0;
+		}
+		return result;
+	}
+
+	QJsonObject runTransport(quint32 vehicles, quint64 steps)
+	{
+		// 30x30 junctions 10 m apart, vehicles at 2 m/s moved every 0.1 s
+		quint32 const side{ 30 };
+		qreal const spacing{ 10.0 };
+		qreal const tick{ 0.1 };
+
+		FS::Router router;
+		for (quint32 y = 0; y < side; ++y)
+		{
+			for (quint32 x = 0; x < side; ++x)
+				router.addNode(x * spacing, y * spacing);
+		}
+		for (quint32 y = 0; y < side; ++y)
+		{
+			for (quint32 x = 0; x < side; ++x)
+			{
+				quint32 const n = y * side + x;
+				if (x + 1 < side)
+				{
+					router.addEdge(n, n + 1, spacing);
+					router.addEdge(n + 1, n, spacing);
+				}
+				if (y + 1 < side)
+				{
+					router.addEdge(n, n + side, spacing);
+					router.addEdge(n + side, n, spacing);
+				}
+			}
+		}
+		router.precompute();
+
+		// the same fleet and requests for every run
+		std::mt19937 random(1);
+		std::uniform_int_distribution<quint32> node(0, side * side - 1);
+		FS::ReservationTable table;
+		FS::Dispatcher dispatcher(router);
+		for (quint32 v = 0; v < vehicles; ++v)
+			dispatcher.addVehicle(node(random), 2.0);
+		dispatcher.setReservations(&table);
+
+		// one request per vehicle and minute
+		qreal const interval = 60.0 / qMax<quint32>(1, vehicles);
+		qreal due = 0.0;
+		quint64 requested = 0;
+		qint64 advanceNs = 0;
+		QElapsedTimer timer;
+		for (quint64 i = 0; i < steps; ++i)
+		{
+			qreal const time = i * tick;
+			for (; due <= time; due += interval)
+			{
+				quint32 const pickup = node(random);
+				quint32 const dropoff = node(random);
+				if (pickup != dropoff && dispatcher.request(pickup, dropoff, time) != FS::Dispatcher::NoJob)
+					++requested;
+			}
+			dispatcher.dispatch(time);
+			timer.start();
+			dispatcher.advance(time, tick);
+			advanceNs += timer.nsecsElapsed();
+		}
+
+		QJsonObject result;
+		result["vehicles"] = static_cast<qint64>(vehicles);
+		result["steps"] = static_cast<qint64>(steps);
+		result["jobs"] = static_cast<qint64>(requested);
+		result["delivered"] = static_cast<qint64>(dispatcher.completedCount());
+		result["deadlocks"] = static_cast<qint64>(dispatcher.deadlockCount());
+		result["utilisation"] = dispatcher.utilisation();
+		result["advance_us"] = advanceNs * 1e-3 / qMax<quint64>(1, steps);
+		return result;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	QCoreApplication::setApplicationName("FactSimBench");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Factory Simulator benchmark suite");
+	parser.addHelpOption();
+	QCommandLineOption shapesOption("shapes", "Comma separated factory shapes (serial, fanout, mesh, loop).", "list", "serial,fanout,mesh,loop");
+	QCommandLineOption sizesOption("sizes", "Comma separated machine counts.", "list", "10,100,1000,10000,100000,1000000");
+	QCommandLineOption stepsOption("steps", "Engine steps timed per factory.", "count", "1000");
+	QCommandLineOption timeStepOption("time-step", "Engine time step in seconds.", "seconds", "0.01");
+	QCommandLineOption mtbfOption("mtbf", "Also time every factory with breakdowns of this mean time between failures on every workspace (0: none).", "seconds", "0");
+	QCommandLineOption vehiclesOption("vehicles", "Comma separated transport fleet sizes, each run for the given steps of 0.1 s.", "list", "300,2000");
+	QCommandLineOption checkReplayOption("check-replay", "Instead of the benchmarks, check on every factory that a retroactive edit replayed downstream ends in the same state as a full replay.");
+	QCommandLineOption outOption("out", "JSON result file.", "file", "factsim-bench.json");
+	parser.addOption(shapesOption);
+	parser.addOption(sizesOption);
+	parser.addOption(stepsOption);
+	parser.addOption(timeStepOption);
+	parser.addOption(mtbfOption);
+	parser.addOption(vehiclesOption);
+	parser.addOption(checkReplayOption);
+	parser.addOption(outOption);
+	parser.process(a);
+
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+
+	// results of different builds are only comparable if they draw the same operation times
+	if (!FS::Philox::check())
+	{
+		err << "the random generator fails its known answer check" << '\n';
+		return 1;
+	}
+
+	std::vector<FS::FactoryGenerator::Shape> shapes;
+	for (QString const & name : parser.value(shapesOption).split(','))
+	{
+		if (name.trimmed().isEmpty())
+			continue;
+		FS::FactoryGenerator::Shape shape;
+		if (!FS::FactoryGenerator::shapeFromName(name.trimmed(), shape))
+		{
+			err << "unknown shape: " << name << '\n';
+			return 1;
+		}
+		shapes.push_back(shape);
+	}
+
+	std::vector<quint32> sizes;
+	for (QString const & size : parser.value(sizesOption).split(','))
+	{
+		if (size.trimmed().isEmpty())
+			continue;
+		bool ok = false;
+		quint32 const n = size.trimmed().toUInt(&ok);
+		if (!ok || n == 0)
+		{
+			err << "invalid size: " << size << '\n';
+			return 1;
+		}
+		sizes.push_back(n);
+	}
+
+	std::vector<quint32> fleets;
+	for (QString const & size : parser.value(vehiclesOption).split(','))
+	{
+		if (size.trimmed().isEmpty())
+			continue;
+		bool ok = false;
+		quint32 const n = size.trimmed().toUInt(&ok);
+		if (!ok || n == 0)
+		{
+			err << "invalid fleet size: " << size << '\n';
+			return 1;
+		}
+		fleets.push_back(n);
+	}
+
+	bool ok = false;
+	quint64 const steps = parser.value(stepsOption).toULongLong(&ok);
+	if (!ok || steps == 0)
+	{
+		err << "invalid step count: " << parser.value(stepsOption) << '\n';
+		return 1;
+	}
+	qreal const timeStep = parser.value(timeStepOption).toDouble(&ok);
+	if (!ok || timeStep <= 0.0)
+	{
+		err << "invalid time step: " << parser.value(timeStepOption) << '\n';
+		return 1;
+	}
+	qreal const mtbf = parser.value(mtbfOption).toDouble(&ok);
+	if (!ok || mtbf < 0.0)
+	{
+		err << "invalid mtbf: " << parser.value(mtbfOption) << '\n';
+		return 1;
+	}
+
+	if (parser.isSet(checkReplayOption))
+	{
+		int failed = 0;
+		out << "shape\tmachines\tedited\treplayed\tdifferences" << '\n';
+		for (FS::FactoryGenerator::Shape shape : shapes)
+		{
+			for (quint32 size : sizes)
+			{
+				QJsonObject const r = checkReplay(shape, size, steps, timeStep);
+				out << r["shape"].toString() << '\t' << r["machines"].toInt() << '\t' << r["edited"].toInt() << '\t'
+					<< r["replayed"].toInt() << '\t' << r["differences"].toInt() << '\n';
+				out.flush();
+				if (r["differences"].toInt() > 0)
+					++failed;
+			}
+		}
+		if (failed > 0)
+		{
+			err << failed << " factories differ after a downstream replay" << '\n';
+			return 1;
+		}
+		return 0;
+	}
+
+	QJsonArray results;
+	out << "shape\tmachines\tload_ms\tmemory_MB\ttick_us\tmachine_steps/s\theatmap_ms" << (mtbf > 0.0 ? "\toutage_overhead_%" : "") << '\n';
+	for (FS::FactoryGenerator::Shape shape : shapes)
+	{
+		for (quint32 size : sizes)
+		{
+			QJsonObject const r = runOne(shape, size, steps, timeStep, mtbf);
+			results.append(r);
+			out << r["shape"].toString() << '\t' << r["machines"].toInt() << '\t'
+				<< r["load_ms"].toDouble() << '\t' << r["memory_bytes"].toDouble() / (1024.0 * 1024.0) << '\t'
+				<< r["tick_us"].toDouble() << '\t' << r["machine_steps_per_s"].toDouble() << '\t' << r["heatmap_ms"].toDouble();
+			if (mtbf > 0.0)
+				out << '\t' << r["outage_overhead"].toDouble() * 100.0;
+			out << '\n';
+			// one line per run as it ends
+			out.flush();
+		}
+	}
+
+	QJsonArray transport;
+	if (!fleets.empty())
+		out << "vehicles\tjobs\tdelivered\tdeadlocks\tadvance_us" << '\n';
+	for (quint32 vehicles : fleets)
+	{
+		QJsonObject const r = runTransport(vehicles, steps);
+		transport.append(r);
+		out << r["vehicles"].toInt() << '\t' << r["jobs"].toInt() << '\t' << r["delivered"].toInt() << '\t'
+			<< r["deadlocks"].toInt() << '\t' << r["advance_us"].toDouble() << '\n';
+		out.flush();
+	}
+
+	QJsonObject report;
+	report["benchmark"] = QString("FactSimBench");
+	report["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+	report["time_step"] = timeStep;
+	report["mtbf"] = mtbf;
+	report["results"] = results;
+	report["transport"] = transport;
+
+	QFile file(parser.value(outOption));
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		err << "cannot write " << file.fileName() << '\n';
+		return 1;
+	}
+	file.write(QJsonDocument(report).toJson());
+	return 0;
+}
@@ -0,0 +1,96 @@
+#include "FSJob.h"
+
+#include <QElapsedTimer>
+
+#include <memory>
+
+#include "FSCore/FSCompletionLog.h"
+#include "FSCore/FSEngine.h"
+#include "FSCore/FSLayout.h"
+
+FS::JobResult FS::runJob(FS::Job const & job, FS::Layout const & layout)
+{
+	FS::JobResult result;
+	if (layout.machines.empty())
+	{
+		result.error = QString("%1: empty layout").arg(job.layout);
+		return result;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	// declared first so the engine is gone before the log
+	std::unique_ptr<FS::CompletionLog> log;
+	if (!job.completionLog.isEmpty())
+	{
+		log.reset(new FS::CompletionLog(job.completionLog));
+		if (!log->isOpen())
+		{
+			result.error = QString("cannot open %1").arg(job.completionLog);
+			return result;
+		}
+	}
+
+	FS::Engine engine(job.timeStep);
+	engine.setSeed(job.seed);
+	layout.instantiate(engine);
+	engine.setCompletionLog(log.get());
+	engine.updateTopology();
+
+	// parts leave the factory through the machines without successor
+	std::vector<quint32> sinks;
+	for (quint32 id = 0; id < engine.machineCount(); ++id)
+	{
+		if (engine.outDegree(id) == 0)
+			sinks.push_back(id);
+	}
+
+	auto partsOut = [&engine, &sinks]() {
+		quint64 n = 0;
+		for (quint32 id : sinks)
+			n += engine.completed(id);
+		return n;
+	};
+
+	if (job.parts > 0)
+	{
+		while (engine.simTime() < job.duration && partsOut() < job.parts)
+			engine.step();
+	}
+	else
+	{
+		while (engine.simTime() < job.duration)
+			engine.step();
+	}
+
+	if (log && !log->close())
+	{
+		result.error = log->droppedCount() > 0
+			? QString("%1 records dropped, the disk fell behind or failed writing %2").arg(log->droppedCount()).arg(job.completionLog)
+			: QString("error while writing %1").arg(job.completionLog);
+		return result;
+	}
+
+	result.simTime = engine.simTime();
+	result.steps = engine.steps();
+	result.partsOut = partsOut();
+
+	quint32 const n = engine.machineCount();
+	result.name.reserve(n);
+	result.kind.reserve(n);
+	result.state.reserve(n);
+	result.queue.reserve(n);
+	result.completed.reserve(n);
+	for (quint32 id = 0; id < n; ++id)
+	{
+		result.name.push_back(layout.machines[id].name);
+		result.kind.push_back(engine.kind(id));
+		result.state.push_back(engine.state(id));
+		result.queue.push_back(engine.queue(id));
+		result.completed.push_back(engine.completed(id));
+	}
+
+	result.wallMs = timer.elapsed();
+	return result;
+}
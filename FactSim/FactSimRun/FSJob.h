@@ -0,0 +1,53 @@
+#ifndef FS_JOB_H
+#define FS_JOB_H
+
+#include <QString>
+
+#include <vector>
+
+#include "FSCore/FSMachineKind.h"
+
+namespace FS
+{
+	struct Layout;
+
+	// One headless simulation of a layout.
+	struct Job
+	{
+		QString layout;
+		// simulated seconds, upper bound when parts is set
+		qreal duration{ 3600.0 };
+		// stop once this many parts left the factory, 0 runs the whole duration
+		quint64 parts{ 0 };
+		qreal timeStep{ 0.01 };
+		// seed of the stochastic operation times, the same seed gives the same run
+		quint64 seed{ 0 };
+		// genealogy of the parts leaving the factory, none if empty (see FS::CompletionLog)
+		QString completionLog;
+	};
+
+	// Outcome of a job, per machine values stored one column per field.
+	struct JobResult
+	{
+		QString error;
+		qreal simTime{ 0.0 };
+		quint64 steps{ 0 };
+		quint64 partsOut{ 0 };
+		qint64 wallMs{ 0 };
+
+		// handles in FS::StringPool::instance()
+		std::vector<quint32> name;
+		std::vector<FS::MachineKind> kind;
+		std::vector<FS::MachineState> state;
+		std::vector<quint32> queue;
+		std::vector<quint64> completed;
+
+		bool isValid() const { return error.isEmpty(); }
+		quint32 machineCount() const { return static_cast<quint32>(kind.size()); }
+	};
+
+	// runs the job on the calling thread
+	FS::JobResult runJob(FS::Job const & job, FS::Layout const & layout);
+};
+
+#endif // FS_JOB_H
@@ -0,0 +1,134 @@
+#include "FSResultWriter.h"
+
+#include <QDataStream>
+#include <QIODevice>
+#include <QTextStream>
+
+#include "FSCore/FSStringPool.h"
+
+namespace
+{
+	enum ColumnType : quint8 { UInt64, Float64, String };
+
+	qreal throughputPerHour(FS::JobResult const & r, quint32 id)
+	{
+		return r.simTime > 0.0 ? r.completed[id] * 3600.0 / r.simTime : 0.0;
+	}
+
+	QString csvField(QString const & s)
+	{
+		if (!s.contains(',') && !s.contains('"') && !s.contains('\n'))
+			return s;
+		QString quoted = s;
+		quoted.replace(QLatin1String("\""), QLatin1String("\"\""));
+		return '"' + quoted + '"';
+	}
+
+	void writeHeader(QDataStream & out, ColumnType type, char const * name)
+	{
+		QByteArray const n(name);
+		out << static_cast<quint8>(type) << static_cast<quint32>(n.size());
+		out.writeRawData(n.constData(), n.size());
+	}
+
+	void writeColumn(QDataStream & out, char const * name, std::vector<quint64> const & values)
+	{
+		writeHeader(out, UInt64, name);
+		for (quint64 v : values)
+			out << v;
+	}
+
+	void writeColumn(QDataStream & out, char const * name, std::vector<double> const & values)
+	{
+		writeHeader(out, Float64, name);
+		for (double v : values)
+			out << v;
+	}
+
+	void writeColumn(QDataStream & out, char const * name, std::vector<QByteArray> const & values)
+	{
+		writeHeader(out, String, name);
+		quint64 offset = 0;
+		out << offset;
+		for (QByteArray const & v : values)
+			out << (offset += static_cast<quint64>(v.size()));
+		for (QByteArray const & v : values)
+			out.writeRawData(v.constData(), v.size());
+	}
+}
+
+bool FS::ResultWriter::writeCsv(std::vector<FS::Job> const & jobs, std::vector<FS::JobResult> const & results, QIODevice & device)
+{
+	QTextStream out(&device);
+	out.setCodec("UTF-8");
+	out << "job,layout,machine,name,kind,state,queue,completed,throughput_per_h\n";
+	for (std::size_t j = 0; j < results.size(); ++j)
+	{
+		FS::JobResult const & r = results[j];
+		if (!r.isValid())
+			continue;
+		QString const layout = csvField(jobs[j].layout);
+		for (quint32 id = 0; id < r.machineCount(); ++id)
+		{
+			out << j << ',' << layout << ',' << id << ',' << csvField(FS::StringPool::instance().string(r.name[id])) << ','
+				<< FS::machineKindName(r.kind[id]) << ',' << FS::machineStateName(r.state[id]) << ','
+				<< r.queue[id] << ',' << r.completed[id] << ',' << throughputPerHour(r, id) << '\n';
+		}
+	}
+	out.flush();
+	return out.status() == QTextStream::Ok;
+}
+
+bool FS::ResultWriter::writeColumns(std::vector<FS::Job> const & jobs, std::vector<FS::JobResult> const & results, QIODevice & device)
+{
+	std::size_t rows = 0;
+	for (FS::JobResult const & r : results)
+	{
+		if (r.isValid())
+			rows += r.machineCount();
+	}
+
+	std::vector<quint64> job, machine, queue, completed;
+	std::vector<double> throughput;
+	std::vector<QByteArray> layout, name, kind, state;
+	job.reserve(rows); machine.reserve(rows); queue.reserve(rows); completed.reserve(rows);
+	throughput.reserve(rows);
+	layout.reserve(rows); name.reserve(rows); kind.reserve(rows); state.reserve(rows);
+
+	for (std::size_t j = 0; j < results.size(); ++j)
+	{
+		FS::JobResult const & r = results[j];
+		if (!r.isValid())
+			continue;
+		QByteArray const layoutName = jobs[j].layout.toUtf8();
+		for (quint32 id = 0; id < r.machineCount(); ++id)
+		{
+			job.push_back(j);
+			layout.push_back(layoutName);
+			machine.push_back(id);
+			name.push_back(FS::StringPool::instance().string(r.name[id]).toUtf8());
+			kind.push_back(QByteArray(FS::machineKindName(r.kind[id])));
+			state.push_back(QByteArray(FS::machineStateName(r.state[id])));
+			queue.push_back(r.queue[id]);
+			completed.push_back(r.completed[id]);
+			throughput.push_back(throughputPerHour(r, id));
+		}
+	}
+
+	QDataStream out(&device);
+	out.setByteOrder(QDataStream::LittleEndian);
+	out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+	out.writeRawData("FSCOLS01", 8);
+	out << static_cast<quint64>(rows) << static_cast<quint32>(9);
+	writeColumn(out, "job", job);
+	writeColumn(out, "layout", layout);
+	writeColumn(out, "machine", machine);
+	writeColumn(out, "name", name);
+	writeColumn(out, "kind", kind);
+	writeColumn(out, "state", state);
+	writeColumn(out, "queue", queue);
+	writeColumn(out, "completed", completed);
+	writeColumn(out, "throughput_per_h", throughput);
+	return out.status() == QDataStream::Ok;
+}
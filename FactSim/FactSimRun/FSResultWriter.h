@@ -0,0 +1,30 @@
+#ifndef FS_RESULT_WRITER_H
+#define FS_RESULT_WRITER_H
+
+#include <vector>
+
+#include "FSJob.h"
+
+class QIODevice;
+
+namespace FS
+{
+	// Writes the per machine results of a batch, one row per machine and job.
+	// Columns: job, layout, machine, name, kind, state, queue, completed, throughput_per_h
+	// Failed jobs have no row.
+	namespace ResultWriter
+	{
+		bool writeCsv(std::vector<FS::Job> const & jobs, std::vector<FS::JobResult> const & results, QIODevice & device);
+
+		// Column oriented binary table, little endian:
+		//   magic "FSCOLS01", quint64 rows, quint32 columns
+		//   then for each column: quint8 type, quint32 name size, name (UTF-8) and the values
+		//     type 0: rows x quint64
+		//     type 1: rows x double
+		//     type 2: (rows + 1) x quint64 offsets into the UTF-8 bytes that follow
+		// Every column is contiguous, so a reader loads only the columns it needs.
+		bool writeColumns(std::vector<FS::Job> const & jobs, std::vector<FS::JobResult> const & results, QIODevice & device);
+	};
+};
+
+#endif // FS_RESULT_WRITER_H
@@ -0,0 +1,327 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+#include <QTextStream>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "FSJob.h"
+#include "FSResultWriter.h"
+
+#include "FSCore/FSLayout.h"
+#include "FSCore/FSRandom.h"
+#include "FSCore/FSScheduler.h"
+
+// Factory Simulator headless runner
+// Runs batches of simulation jobs without any window, so they can be scheduled on machines
+// without a display. Only the core library is linked.
+//
+// Jobs are given either as layout files on the command line, sharing the duration and part
+// count options, or as a JSON job file:
+//   [ { "layout": "line.json", "duration": 28800, "parts": 0, "time_step": 0.01, "seed": 1,
+//       "completion_log": "line.fscl" }, ... ]
+// Relative layout and log paths of a job file are relative to the job file.
+// Each layout is loaded once, the jobs then run in parallel on a work-stealing scheduler,
+// one engine per job.
+
+namespace
+{
+	// a number of a job file field, the default if the field is absent
+	bool readNumber(QJsonObject const & o, char const *field, double fallback, double & value)
+	{
+		QJsonValue const v = o[field];
+		if (v.isUndefined())
+		{
+			value = fallback;
+			return true;
+		}
+		value = v.toDouble();
+		return v.isDouble();
+	}
+
+	// a count, integer and not negative
+	bool isCount(double value)
+	{
+		return value >= 0.0 && value < 18446744073709551616.0 && value == static_cast<double>(static_cast<quint64>(value));
+	}
+
+	bool readJobFile(QString const & fileName, FS::Job const & defaults, std::vector<FS::Job> & jobs, QString & error)
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly))
+		{
+			error = QString("cannot open %1").arg(fileName);
+			return false;
+		}
+
+		QJsonParseError parseError;
+		QJsonDocument const doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+		if (!doc.isArray())
+		{
+			error = QString("%1: %2").arg(fileName, doc.isNull() ? parseError.errorString() : QString("expected an array of jobs"));
+			return false;
+		}
+
+		QDir const dir = QFileInfo(fileName).absoluteDir();
+		QJsonArray const array = doc.array();
+		// the jobs run in parallel, two logs on one file would overwrite each other
+		QSet<QString> logs;
+		for (int i = 0; i < array.size(); ++i)
+		{
+			QJsonObject const o = array[i].toObject();
+			FS::Job job = defaults;
+			if (!o["layout"].isString())
+			{
+				error = QString("%1: job %2 has no layout").arg(fileName).arg(i);
+				return false;
+			}
+			job.layout = QDir::cleanPath(dir.absoluteFilePath(o["layout"].toString()));
+
+			double duration, parts, timeStep, seed;
+			if (!readNumber(o, "duration", defaults.duration, duration) || duration < 0.0
+				|| !readNumber(o, "parts", static_cast<double>(defaults.parts), parts) || !isCount(parts)
+				|| !readNumber(o, "time_step", defaults.timeStep, timeStep) || timeStep <= 0.0
+				|| !readNumber(o, "seed", static_cast<double>(defaults.seed), seed) || !isCount(seed))
+			{
+				error = QString("%1: invalid duration, parts, time_step or seed in job %2").arg(fileName).arg(i);
+				return false;
+			}
+			job.duration = duration;
+			job.parts = static_cast<quint64>(parts);
+			job.timeStep = timeStep;
+			job.seed = static_cast<quint64>(seed);
+			if (o.contains("completion_log"))
+			{
+				if (!o["completion_log"].isString() || o["completion_log"].toString().isEmpty())
+				{
+					error = QString("%1: invalid completion_log in job %2").arg(fileName).arg(i);
+					return false;
+				}
+				job.completionLog = QDir::cleanPath(dir.absoluteFilePath(o["completion_log"].toString()));
+				if (logs.contains(job.completionLog))
+				{
+					error = QString("%1: job %2 writes the completion log %3 of another job").arg(fileName).arg(i).arg(job.completionLog);
+					return false;
+				}
+				logs.insert(job.completionLog);
+			}
+			jobs.push_back(job);
+		}
+		return true;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	QCoreApplication::setApplicationName("factsim-run");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Factory Simulator headless batch runner");
+	parser.addHelpOption();
+	parser.addPositionalArgument("layouts", "Layout files, one job each.", "[layouts...]");
+	QCommandLineOption jobsOption("jobs", "JSON job file.", "file");
+	QCommandLineOption durationOption("duration", "Simulated duration in seconds.", "seconds", "3600");
+	QCommandLineOption partsOption("parts", "Stop once this many parts left the factory (0: run the whole duration).", "count", "0");
+	QCommandLineOption timeStepOption("time-step", "Engine time step in seconds.", "seconds", "0.01");
+	QCommandLineOption seedOption("seed", "Seed of the stochastic operation times.", "seed", "0");
+	QCommandLineOption formatOption("format", "Output format: csv or columns.", "format", "csv");
+	QCommandLineOption outOption("out", "Output file, - for the standard output (csv only).", "file", "-");
+	QCommandLineOption threadsOption("threads", "Jobs run in parallel (0: one per core).", "count", "0");
+	parser.addOption(jobsOption);
+	parser.addOption(durationOption);
+	parser.addOption(partsOption);
+	parser.addOption(timeStepOption);
+	parser.addOption(seedOption);
+	parser.addOption(formatOption);
+	parser.addOption(outOption);
+	parser.addOption(threadsOption);
+	parser.process(a);
+
+	QTextStream err(stderr);
+
+	// the stochastic runs are only reproducible with the reference generator
+	if (!FS::Philox::check())
+	{
+		err << "the random generator fails its known answer check" << '\n';
+		return 1;
+	}
+
+	FS::Job defaults;
+	bool ok = false;
+	defaults.duration = parser.value(durationOption).toDouble(&ok);
+	if (!ok || defaults.duration < 0.0)
+	{
+		err << "invalid duration: " << parser.value(durationOption) << '\n';
+		return 1;
+	}
+	defaults.parts = parser.value(partsOption).toULongLong(&ok);
+	if (!ok)
+	{
+		err << "invalid part count: " << parser.value(partsOption) << '\n';
+		return 1;
+	}
+	defaults.timeStep = parser.value(timeStepOption).toDouble(&ok);
+	if (!ok || defaults.timeStep <= 0.0)
+	{
+		err << "invalid time step: " << parser.value(timeStepOption) << '\n';
+		return 1;
+	}
+	defaults.seed = parser.value(seedOption).toULongLong(&ok);
+	if (!ok)
+	{
+		err << "invalid seed: " << parser.value(seedOption) << '\n';
+		return 1;
+	}
+
+	std::vector<FS::Job> jobs;
+	for (QString const & layout : parser.positionalArguments())
+	{
+		FS::Job job = defaults;
+		job.layout = layout;
+		jobs.push_back(job);
+	}
+	if (parser.isSet(jobsOption))
+	{
+		QString error;
+		if (!readJobFile(parser.value(jobsOption), defaults, jobs, error))
+		{
+			err << error << '\n';
+			return 1;
+		}
+	}
+	if (jobs.empty())
+	{
+		err << "no job" << '\n';
+		// showHelp() exits without destroying the stream
+		err.flush();
+		parser.showHelp(1);
+	}
+
+	QString const format = parser.value(formatOption);
+	QString const outName = parser.value(outOption);
+	if (format != "csv" && format != "columns")
+	{
+		err << "unknown format: " << format << '\n';
+		return 1;
+	}
+	if (format == "columns" && outName == "-")
+	{
+		err << "the columns format needs an output file" << '\n';
+		return 1;
+	}
+	if (outName != "-")
+	{
+		QString const outPath = QDir::cleanPath(QFileInfo(outName).absoluteFilePath());
+		for (FS::Job const & job : jobs)
+		{
+			if (job.completionLog == outPath)
+			{
+				err << "the output file is also a completion log: " << outName << '\n';
+				return 1;
+			}
+		}
+	}
+
+	std::size_t nThreads = parser.value(threadsOption).toUInt(&ok);
+	if (!ok)
+	{
+		err << "invalid thread count: " << parser.value(threadsOption) << '\n';
+		return 1;
+	}
+	if (nThreads == 0)
+		nThreads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	nThreads = std::min(nThreads, jobs.size());
+	// the main thread runs tasks while it waits, it is one of the threads
+	FS::Scheduler scheduler(static_cast<quint32>(nThreads - 1));
+
+	// load every layout once, in parallel, shared read-only by the jobs
+	QStringList fileNames;
+	for (FS::Job const & job : jobs)
+	{
+		if (!fileNames.contains(job.layout))
+			fileNames.append(job.layout);
+	}
+	std::vector<FS::Layout> loaded(fileNames.size());
+	std::vector<QString> loadErrors(fileNames.size());
+	std::vector<char> loadedOk(fileNames.size(), 0);
+	scheduler.parallelFor(0, loaded.size(), 1, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i)
+			loadedOk[i] = loaded[i].load(fileNames[static_cast<int>(i)], &loadErrors[i]);
+	});
+	QMap<QString, FS::Layout> layouts;
+	QMap<QString, QString> layoutErrors;
+	for (std::size_t i = 0; i < loaded.size(); ++i)
+	{
+		if (loadedOk[i])
+			layouts.insert(fileNames[static_cast<int>(i)], loaded[i]);
+		else
+			layoutErrors.insert(fileNames[static_cast<int>(i)], loadErrors[i]);
+	}
+
+	// one task per job, idle threads steal the remaining ones
+	std::vector<FS::JobResult> results(jobs.size());
+	scheduler.parallelFor(0, jobs.size(), 1, [&jobs, &layouts, &layoutErrors, &results](std::size_t begin, std::size_t end) {
+		for (std::size_t j = begin; j < end; ++j)
+		{
+			auto const layout = layouts.constFind(jobs[j].layout);
+			if (layout == layouts.constEnd())
+				results[j].error = layoutErrors.value(jobs[j].layout);
+			else
+				results[j] = FS::runJob(jobs[j], layout.value());
+		}
+	});
+
+	// summary
+	int failed = 0;
+	err << "job\tlayout\tsim_s\tsteps\tparts_out\twall_ms" << '\n';
+	for (std::size_t j = 0; j < jobs.size(); ++j)
+	{
+		FS::JobResult const & r = results[j];
+		if (!r.isValid())
+		{
+			err << j << '\t' << r.error << '\n';
+			++failed;
+			continue;
+		}
+		err << j << '\t' << jobs[j].layout << '\t' << r.simTime << '\t' << r.steps << '\t'
+			<< r.partsOut << '\t' << r.wallMs << '\n';
+	}
+
+	QFile out;
+	bool opened;
+	if (outName == "-")
+	{
+		opened = out.open(stdout, QIODevice::WriteOnly);
+	}
+	else
+	{
+		out.setFileName(outName);
+		opened = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	}
+	if (!opened)
+	{
+		err << "cannot write " << outName << '\n';
+		return 1;
+	}
+
+	bool const written = format == "columns"
+		? FS::ResultWriter::writeColumns(jobs, results, out)
+		: FS::ResultWriter::writeCsv(jobs, results, out);
+	if (!written)
+	{
+		err << "error while writing " << outName << '\n';
+		return 1;
+	}
+	return failed > 0 ? 2 : 0;
+}